@@ -0,0 +1,15 @@
+CONFIG += c++17
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+# keep the generated files of each subproject apart, they share a build directory
+OBJECTS_DIR = $$OUT_PWD/obj/$${TARGET}
+MOC_DIR     = $$OUT_PWD/moc/$${TARGET}
+RCC_DIR     = $$OUT_PWD/rcc/$${TARGET}
+UI_DIR      = $$OUT_PWD/ui/$${TARGET}
+
+INCLUDEPATH += $$PWD/.
+INCLUDEPATH += $$OUT_PWD/gen # generated by the core library
+DEPENDPATH += $$PWD/.
@@ -0,0 +1,18 @@
+# links an application against the headless core library
+
+# opcodes register themselves from static initializers, which the linker
+# drops from a static library unless the whole archive is linked
+win32-msvc* {
+    LIBS += -L$$OUT_PWD/core -lrdrasm-core
+    QMAKE_LFLAGS += /WHOLEARCHIVE:rdrasm-core.lib
+    PRE_TARGETDEPS += $$OUT_PWD/core/rdrasm-core.lib
+} else: macx {
+    LIBS += -Wl,-force_load,$$OUT_PWD/core/librdrasm-core.a
+    PRE_TARGETDEPS += $$OUT_PWD/core/librdrasm-core.a
+} else {
+    LIBS += -Wl,--whole-archive -L$$OUT_PWD/core -lrdrasm-core -Wl,--no-whole-archive
+    PRE_TARGETDEPS += $$OUT_PWD/core/librdrasm-core.a
+}
+
+win32: LIBS += -L$$PWD/lib/ -lzlib
+unix: LIBS += -lz
@@ -0,0 +1,24 @@
+QT       += core concurrent
+QT       -= gui
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = rdrasm-cli
+
+include(common.pri)
+include(core.pri)
+
+SOURCES += \
+    src/cli/bench.cpp \
+    src/cli/main.cpp \
+    src/cli/selftest.cpp
+
+HEADERS += \
+    src/cli/bench.h \
+    src/cli/selftest.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,97 @@
+# Script decoding, compiling and utilities, without any widgets
+
+QT       += core concurrent
+QT       -= gui
+
+TEMPLATE = lib
+CONFIG += staticlib
+TARGET = rdrasm-core
+DESTDIR = $$OUT_PWD/core
+
+include(common.pri)
+
+SOURCES += \
+    src/rage/batch.cpp \
+    src/rage/compiler.cpp \
+    src/rage/controlflow.cpp \
+    src/rage/decompiler.cpp \
+    src/rage/disassembly.cpp \
+    src/rage/instructionformatter.cpp \
+    src/rage/instructionstream.cpp \
+    src/rage/iopcode.cpp \
+    src/rage/opcodefactory.cpp \
+    src/rage/opcodes/enter.cpp \
+    src/rage/opcodes/helper.cpp \
+    src/rage/opcodes/include.cpp \
+    src/rage/opcodes/methods.cpp \
+    src/rage/opcodes/misc.cpp \
+    src/rage/opcodes/string.cpp \
+    src/rage/script.cpp \
+    src/rage/stackverifier.cpp \
+    src/rage/xrefindex.cpp \
+    src/util/crypto/aes256.cpp \
+    src/util/crypto/aesni.cpp \
+    src/util/crypto/aestable.cpp \
+    src/util/crypto/lzx.c \
+    src/util/crypto/lzxcomp.cpp \
+    src/util/crypto/lzxref.c \
+    src/util/decompresspool.cpp \
+    src/util/keyring.cpp \
+    src/util/streamextractor.cpp \
+    src/util/textbuffer.cpp \
+    src/util/util.cpp
+
+HEADERS += \
+    src/rage/batch.h \
+    src/rage/compiler.h \
+    src/rage/controlflow.h \
+    src/rage/decompiler.h \
+    src/rage/disassembly.h \
+    src/rage/instructionformatter.h \
+    src/rage/instructionstream.h \
+    src/rage/iopcode.h \
+    src/rage/opcodedesc.h \
+    src/rage/opcodefactory.h \
+    src/rage/opcodes/enter.h \
+    src/rage/opcodes/float.h \
+    src/rage/opcodes/helper.h \
+    src/rage/opcodes/integer.h \
+    src/rage/opcodes/methods.h \
+    src/rage/opcodes/misc.h \
+    src/rage/opcodes/stack.h \
+    src/rage/opcodes/string.h \
+    src/rage/opcodes/vector.h \
+    src/rage/script.h \
+    src/rage/scriptview.h \
+    src/rage/stackverifier.h \
+    src/rage/xrefindex.h \
+    src/util/crypto/aes256.h \
+    src/util/crypto/aesni.h \
+    src/util/crypto/aestable.h \
+    src/util/crypto/lzx.h \
+    src/util/crypto/lzxcomp.h \
+    src/util/crypto/lzxref.h \
+    src/util/decompresspool.h \
+    src/util/keyring.h \
+    src/util/streamextractor.h \
+    src/util/textbuffer.h \
+    src/util/util.h \
+    src/util/crypto/zconf.h \
+    src/util/crypto/zlib.h
+
+# the opcode descriptor table is generated from opcodes.json, which needs python 3
+OPCODES_JSON = res/rage/opcodes.json
+
+win32: OPCODES_PYTHON = python
+else:  OPCODES_PYTHON = python3
+
+opcodes_gen.input = OPCODES_JSON
+opcodes_gen.output = $$OUT_PWD/gen/opcodes_gen.h
+opcodes_gen.commands = $$OPCODES_PYTHON $$shell_path($$PWD/tools/gen_opcodes.py) ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+opcodes_gen.depends = $$PWD/tools/gen_opcodes.py
+opcodes_gen.variable_out = HEADERS
+opcodes_gen.CONFIG += target_predeps no_link
+QMAKE_EXTRA_COMPILERS += opcodes_gen
+
+RESOURCES += \
+    res/rage.qrc
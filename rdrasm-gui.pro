@@ -0,0 +1,39 @@
+QT       += core concurrent gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TEMPLATE = app
+TARGET = RDRasm
+
+include(common.pri)
+include(core.pri)
+
+SOURCES += \
+    src/main.cpp \
+    src/widgets/disassembler.cpp \
+    src/widgets/editdialog.cpp \
+    src/widgets/launchscreen.cpp \
+    src/widgets/opcodetable.cpp
+
+HEADERS += \
+    src/widgets/disassembler.h \
+    src/widgets/editdialog.h \
+    src/widgets/launchscreen.h \
+    src/widgets/opcodetable.h
+
+FORMS += \
+    src/widgets/disassembler.ui \
+    src/widgets/editdialog.ui \
+    src/widgets/launchscreen.ui
+
+include(lib/QHexView/QHexView.pri)
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+RESOURCES += \
+    res/res.qrc
+
+RC_ICONS = res/icon.ico
@@ -0,0 +1,381 @@
+#include "bench.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+
+#include <random>
+
+#include "../rage/controlflow.h"
+#include "../rage/decompiler.h"
+#include "../rage/disassembly.h"
+#include "../rage/script.h"
+
+static QByteArray randomData(int size, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    QByteArray data(size, Qt::Uninitialized);
+
+    for (int i = 0; i < size; i++)
+    {
+        data[i] = (char)rng();
+    }
+
+    return data;
+}
+
+// short runs copied from a little earlier between random bytes, closer to script data than noise
+static QByteArray compressibleData(int size, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    QByteArray data(size, Qt::Uninitialized);
+
+    for (int i = 0; i < size; )
+    {
+        if (i < 4096 || rng() % 4 == 0)
+        {
+            data[i++] = (char)(rng() % 64);
+            continue;
+        }
+
+        int distance = 1 + (int)(rng() % 4096);
+        int run = qMin(4 + (int)(rng() % 32), size - i);
+
+        for (int j = 0; j < run; j++, i++)
+            data[i] = data[i - distance];
+    }
+
+    return data;
+}
+
+static double megabytesPerSecond(int size, qint64 ns)
+{
+    return (size / (1024.0 * 1024.0)) / (qMax<qint64>(ns, 1) / 1e9);
+}
+
+bool Bench::aes(QTextStream &out, int size)
+{
+    QByteArray key   = randomData(32, 1);
+    QByteArray input = randomData(size & -16, 2);
+
+    AesBackend previous = Util::getAesBackend();
+
+    QByteArray refDecrypted, refEncrypted;
+    double refDecrypt = 0, refEncrypt = 0;
+    bool identical = true;
+
+    out << QString("aes, %1 KB, 16 passes per block, up to %2 threads").arg(input.size() / 1024).arg(QThread::idealThreadCount()) << Qt::endl;
+
+    for (AesBackend backend : { AesBackend::AES_PORTABLE, AesBackend::AES_TTABLE, AesBackend::AES_NI })
+    {
+        if (!Util::setAesBackend(backend))
+        {
+            out << QString("  %1: not supported on this cpu").arg(Util::aesBackendToString(backend)) << Qt::endl;
+            continue;
+        }
+
+        QByteArray decrypted(input.size(), Qt::Uninitialized);
+        QByteArray encrypted(input.size(), Qt::Uninitialized);
+        QElapsedTimer timer;
+
+        timer.start();
+        Util::decrypt(input.constData(), decrypted.data(), input.size(), key);
+        double decrypt = megabytesPerSecond(input.size(), timer.nsecsElapsed());
+
+        timer.start();
+        Util::encrypt(input.constData(), encrypted.data(), input.size(), key);
+        double encrypt = megabytesPerSecond(input.size(), timer.nsecsElapsed());
+
+        QString match;
+
+        if (backend == AesBackend::AES_PORTABLE)
+        {
+            refDecrypted = decrypted;
+            refEncrypted = encrypted;
+            refDecrypt   = decrypt;
+            refEncrypt   = encrypt;
+        }
+        else if (decrypted != refDecrypted || encrypted != refEncrypted)
+        {
+            match = ", MISMATCH";
+            identical = false;
+        }
+
+        out << QString("  %1: decrypt %2 MB/s (%3x), encrypt %4 MB/s (%5x)%6")
+                   .arg(Util::aesBackendToString(backend), -8)
+                   .arg(decrypt, 0, 'f', 2).arg(decrypt / refDecrypt, 0, 'f', 1)
+                   .arg(encrypt, 0, 'f', 2).arg(encrypt / refEncrypt, 0, 'f', 1)
+                   .arg(match)
+            << Qt::endl;
+    }
+
+    Util::setAesBackend(previous);
+
+    return identical;
+}
+
+bool Bench::lzx(QTextStream &out, int size)
+{
+    QByteArray input = compressibleData(size, 3);
+    bool identical = true;
+
+    out << QString("lzx, %1 KB, window 17").arg(input.size() / 1024) << Qt::endl;
+
+    for (int level = LZX_LEVEL_STORE; level <= LZX_LEVEL_BEST; level++)
+    {
+        QElapsedTimer timer;
+
+        timer.start();
+        QByteArray compressed = Util::lzxCompress(input, level);
+        double compress = megabytesPerSecond(input.size(), timer.nsecsElapsed());
+
+        QByteArray decompressed(input.size(), Qt::Uninitialized);
+
+        timer.start();
+        int res = Util::lzxDecompress(compressed.constData() + 8, compressed.size() - 8, decompressed.data(), decompressed.size());
+        double decompress = megabytesPerSecond(input.size(), timer.nsecsElapsed());
+
+        QString match;
+
+        if (res != 0 || decompressed != input)
+        {
+            match = ", MISMATCH";
+            identical = false;
+        }
+
+        out << QString("  level %1: compress %2 MB/s, ratio %3%, decompress %4 MB/s%5")
+                   .arg(level)
+                   .arg(compress, 0, 'f', 2)
+                   .arg(100.0 * compressed.size() / qMax(input.size(), 1), 0, 'f', 1)
+                   .arg(decompress, 0, 'f', 2)
+                   .arg(match)
+            << Qt::endl;
+    }
+
+    return identical;
+}
+
+bool Bench::zlib(QTextStream &out, int size)
+{
+    QByteArray input = compressibleData(size, 4);
+    bool identical = true;
+
+    out << QString("zlib, %1 KB, up to %2 threads").arg(input.size() / 1024).arg(QThread::idealThreadCount()) << Qt::endl;
+
+    for (int level : { 0, 1, 6, 9 })
+    {
+        QElapsedTimer timer;
+
+        timer.start();
+        QByteArray compressed = Util::zlibCompress(input, level);
+        double compress = megabytesPerSecond(input.size(), timer.nsecsElapsed());
+
+        QByteArray decompressed(input.size(), Qt::Uninitialized);
+
+        timer.start();
+        int res = Util::zlibDecompress(compressed.constData(), compressed.size(), decompressed.data(), decompressed.size());
+        double decompress = megabytesPerSecond(input.size(), timer.nsecsElapsed());
+
+        QString match;
+
+        if (res != 0 || decompressed != input)
+        {
+            match = ", MISMATCH";
+            identical = false;
+        }
+
+        out << QString("  level %1: compress %2 MB/s, ratio %3%, decompress %4 MB/s%5")
+                   .arg(level)
+                   .arg(compress, 0, 'f', 2)
+                   .arg(100.0 * compressed.size() / qMax(input.size(), 1), 0, 'f', 1)
+                   .arg(decompress, 0, 'f', 2)
+                   .arg(match)
+            << Qt::endl;
+    }
+
+    return identical;
+}
+
+bool Bench::lzxScript(QTextStream &out, QString path)
+{
+    Script script(path);
+
+    if (!script.isValid())
+    {
+        out << Util::errorToString(script.getError()) << Qt::endl;
+        return false;
+    }
+
+    if (script.getScriptType() != ScriptType::TYPE_X360 || script.getResourceHeader().version != 2)
+    {
+        out << "Error: " << path << " is not an lzx compressed .xsc." << Qt::endl;
+        return false;
+    }
+
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        out << Util::errorToString(ErrorCode::ERR_OPEN_FAILED) << Qt::endl;
+        return false;
+    }
+
+    // the payload after the 16 byte rsc header, decrypted once up front
+    QByteArray payload = Util::decrypt(file.readAll().mid(16));
+    QByteArray expected = script.getData();
+    QByteArray decompressed(expected.size(), Qt::Uninitialized);
+    QByteArray reference(expected.size(), Qt::Uninitialized);
+
+    const int runs = 20;
+    qint64 best = 0, referenceBest = 0;
+    bool identical = true;
+
+    // the previous decoder on the same payload, both outputs must match the script data and each other
+    for (int i = 0; i < runs; i++)
+    {
+        QElapsedTimer timer;
+
+        timer.start();
+        int res = Util::lzxDecompress(payload.constData() + 8, payload.size() - 8, decompressed.data(), decompressed.size());
+        qint64 elapsed = timer.nsecsElapsed();
+
+        timer.restart();
+        int referenceRes = Util::lzxDecompressReference(payload.constData() + 8, payload.size() - 8, reference.data(), reference.size());
+        qint64 referenceElapsed = timer.nsecsElapsed();
+
+        identical &= (res == 0 && referenceRes == 0 && decompressed == expected && reference == decompressed);
+        best = (i == 0) ? elapsed : qMin(best, elapsed);
+        referenceBest = (i == 0) ? referenceElapsed : qMin(referenceBest, referenceElapsed);
+    }
+
+    out << QString("lzx, %1: %2 KB to %3 KB, decompress %4 MB/s, previous decoder %5 MB/s, %6x (best of %7)%8")
+               .arg(path)
+               .arg(payload.size() / 1024)
+               .arg(expected.size() / 1024)
+               .arg(megabytesPerSecond(expected.size(), best), 0, 'f', 2)
+               .arg(megabytesPerSecond(expected.size(), referenceBest), 0, 'f', 2)
+               .arg((double)referenceBest / qMax(best, (qint64)1), 0, 'f', 2)
+               .arg(runs)
+               .arg(identical ? ", outputs identical" : ", MISMATCH")
+        << Qt::endl;
+
+    return identical;
+}
+
+bool Bench::decodeScript(QTextStream &out, QString path, QString cachePath, bool useCache)
+{
+    Script script(path);
+
+    if (!script.isValid())
+    {
+        out << Util::errorToString(script.getError()) << Qt::endl;
+        return false;
+    }
+
+    const InstructionStream &instructions = script.getInstructions();
+
+    QElapsedTimer timer;
+
+    timer.start();
+    const QVector<std::shared_ptr<IOpcode>> &opcodes = script.getOpcodes();
+    qint64 build = timer.nsecsElapsed();
+
+    // opcode object, shared_ptr control block and slot in the vector, plus the operand copy
+    qint64 objectMemory = 0;
+
+    for (auto op : opcodes)
+    {
+        objectMemory += sizeof(Op_HSpacer) + 16 + sizeof(std::shared_ptr<IOpcode>);
+
+        if (!op->getData().isEmpty())
+            objectMemory += 24 + ((op->getData().size() + 8) & ~7);
+    }
+
+    qint64 streamMemory = instructions.memoryUsage();
+
+    out << QString("decode, %1: %2 instructions")
+               .arg(path)
+               .arg(instructions.size())
+        << Qt::endl;
+
+    out << QString("  instruction stream: %1 ms, %2 KB")
+               .arg(script.getLoadStats().decodeTime / 1e6, 0, 'f', 2)
+               .arg(streamMemory / 1024)
+        << Qt::endl;
+
+    out << QString("  opcode objects: %1 ms more, about %2 KB (%3x)")
+               .arg(build / 1e6, 0, 'f', 2)
+               .arg(objectMemory / 1024)
+               .arg((double)objectMemory / qMax(streamMemory, (qint64)1), 0, 'f', 1)
+        << Qt::endl;
+
+    for (int threads : { 1, 0 })
+    {
+        timer.start();
+        std::vector<ControlFlowGraph> graphs = ControlFlowGraph::buildAll(script.getView(), threads);
+        qint64 elapsed = timer.nsecsElapsed();
+
+        int blocks = 0, edges = 0, loops = 0;
+
+        for (const ControlFlowGraph &graph : graphs)
+        {
+            blocks += (int)graph.getBlocks().size();
+            edges  += graph.getEdgeCount();
+            loops  += (int)graph.getLoops().size();
+        }
+
+        out << QString("  control flow, %1: %2 ms, %3 functions, %4 blocks, %5 edges, %6 loops")
+                   .arg(threads == 1 ? "1 thread" : QString("%1 threads").arg(QThread::idealThreadCount()))
+                   .arg(elapsed / 1e6, 0, 'f', 2)
+                   .arg(graphs.size())
+                   .arg(blocks)
+                   .arg(edges)
+                   .arg(loops)
+            << Qt::endl;
+    }
+
+    ErrorCode nativeError = ErrorCode::ERR_NONE;
+    QMap<unsigned int, QString> nativeMap = Util::getNatives(&nativeError);
+
+    {
+        Disassembly disassembly(script.getView(), nativeMap);
+
+        QBuffer listing;
+        listing.open(QIODevice::WriteOnly);
+
+        QTextStream stream(&listing);
+
+        timer.start();
+        disassembly.write(stream);
+        stream.flush();
+        qint64 elapsed = timer.nsecsElapsed();
+
+        out << QString("  listing: %1 ms, %2 KB, %3 MB/s")
+                   .arg(elapsed / 1e6, 0, 'f', 2)
+                   .arg(listing.size() / 1024)
+                   .arg(listing.size() / 1048576.0 / qMax(elapsed / 1e9, 1e-9), 0, 'f', 0)
+            << Qt::endl;
+    }
+
+    // the memory cache lasts for the process, so the second run only looks functions up
+    for (int pass = 0; pass < 2; pass++)
+    {
+        Decompiler decompiler(script.getView(), nativeMap);
+        decompiler.setCachePath(cachePath);
+        decompiler.setUseCache(useCache);
+
+        timer.start();
+        decompiler.run();
+        qint64 elapsed = timer.nsecsElapsed();
+
+        out << QString("  decompile, %1 run: %2 ms, %3 functions, %4 cached")
+                   .arg(pass == 0 ? "first" : "second")
+                   .arg(elapsed / 1e6, 0, 'f', 2)
+                   .arg(decompiler.getFunctionCount())
+                   .arg(decompiler.getCacheHits())
+            << Qt::endl;
+    }
+
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <QTextStream>
+
+#include "../util/util.h"
+
+// Throughput benchmarks, run with "rdrasm-cli bench"
+class Bench
+{
+public:
+    // times every supported aes backend against the portable one, false if any result differs
+    static bool aes(QTextStream &out, int size);
+
+    // times lzx compression at each level and decompression of the result, false if a round trip fails
+    static bool lzx(QTextStream &out, int size);
+
+    // times zlib compression at a few levels and inflating the result, false if a round trip fails
+    static bool zlib(QTextStream &out, int size);
+
+    // times lzx decompression of a real .xsc payload, false if it doesn't load or decompress
+    static bool lzxScript(QTextStream &out, QString path);
+
+    // compares decoding a script's code pages with building opcode objects for them, and times building
+    // the control flow graphs on one and all cores, writing the listing and decompiling twice, the second
+    // time from the cache, false if it doesn't load. The disk cache is only used when a path is given.
+    static bool decodeScript(QTextStream &out, QString path, QString cachePath = QString(), bool useCache = true);
+};
+
+#endif // BENCH_H
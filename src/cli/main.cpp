@@ -0,0 +1,438 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+#include <cstdio>
+
+#include "bench.h"
+#include "selftest.h"
+
+#include "../rage/batch.h"
+#include "../rage/compiler.h"
+#include "../rage/decompiler.h"
+#include "../rage/disassembly.h"
+#include "../rage/script.h"
+#include "../util/decompresspool.h"
+#include "../util/keyring.h"
+#include "../util/util.h"
+
+static QTextStream err(stderr);
+
+static ErrorCode fail(ErrorCode error)
+{
+    err << Util::errorToString(error) << Qt::endl;
+    return error;
+}
+
+static ErrorCode writeFile(QString path, QByteArray data)
+{
+    QFile out(path);
+
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return ErrorCode::ERR_WRITE_FAILED;
+    }
+
+    out.write(data);
+    out.close();
+
+    return ErrorCode::ERR_NONE;
+}
+
+static ErrorCode disassemble(Script &script, QString outPath, QString format)
+{
+    ListingFormat listingFormat;
+
+    if (format == "text")
+        listingFormat = ListingFormat::LISTING_TEXT;
+    else if (format == "jsonl")
+        listingFormat = ListingFormat::LISTING_JSONL;
+    else if (format == "csv")
+        listingFormat = ListingFormat::LISTING_CSV;
+    else
+        return ErrorCode::ERR_INVALID_ARGUMENTS;
+
+    ErrorCode nativeError = ErrorCode::ERR_NONE;
+
+    Disassembly disassembly(script.getView(), Util::getNatives(&nativeError));
+
+    if (nativeError != ErrorCode::ERR_NONE)
+    {
+        err << Util::errorToString(nativeError) << Qt::endl;
+    }
+
+    if (disassembly.getInvalidCalls() > 0)
+    {
+        err << QString("Warning: %1 invalid calls found.").arg(disassembly.getInvalidCalls()) << Qt::endl;
+    }
+
+    // written in pieces as it is formatted, so the listing is never held whole
+    QFile file(outPath);
+
+    bool opened = outPath.isEmpty() ? file.open(fileno(stdout), QIODevice::WriteOnly | QIODevice::Unbuffered)
+                                    : file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered);
+
+    if (!opened || !disassembly.write(&file, listingFormat))
+    {
+        return ErrorCode::ERR_WRITE_FAILED;
+    }
+
+    return ErrorCode::ERR_NONE;
+}
+
+static ErrorCode writeXrefs(Script &script, QString outPath)
+{
+    ErrorCode nativeError = ErrorCode::ERR_NONE;
+
+    Disassembly disassembly(script.getView(), Util::getNatives(&nativeError));
+
+    if (nativeError != ErrorCode::ERR_NONE)
+    {
+        err << Util::errorToString(nativeError) << Qt::endl;
+    }
+
+    if (outPath.isEmpty())
+    {
+        QTextStream out(stdout);
+        disassembly.writeXrefs(out);
+
+        return ErrorCode::ERR_NONE;
+    }
+
+    QFile file(outPath);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return ErrorCode::ERR_WRITE_FAILED;
+    }
+
+    QTextStream out(&file);
+    disassembly.writeXrefs(out);
+
+    return ErrorCode::ERR_NONE;
+}
+
+// an empty cache path keeps the default one
+static ErrorCode decompile(Script &script, QString outPath, int threadCount, QString cachePath, bool useCache)
+{
+    ErrorCode nativeError = ErrorCode::ERR_NONE;
+
+    Decompiler decompiler(script.getView(), Util::getNatives(&nativeError));
+
+    if (nativeError != ErrorCode::ERR_NONE)
+    {
+        err << Util::errorToString(nativeError) << Qt::endl;
+    }
+
+    decompiler.setThreadCount(threadCount);
+    decompiler.setUseCache(useCache);
+
+    if (!cachePath.isEmpty())
+        decompiler.setCachePath(cachePath);
+
+    decompiler.run();
+
+    if (outPath.isEmpty())
+    {
+        QTextStream out(stdout);
+        decompiler.write(out);
+
+        return ErrorCode::ERR_NONE;
+    }
+
+    QFile file(outPath);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return ErrorCode::ERR_WRITE_FAILED;
+    }
+
+    QTextStream out(&file);
+    decompiler.write(out);
+
+    return ErrorCode::ERR_NONE;
+}
+
+static ErrorCode convert(Script &script, QString to, QString outPath, int level, bool stackCheck)
+{
+    ScriptType type;
+
+    if (to == "csc")
+        type = ScriptType::TYPE_PS3;
+    else if (to == "xsc")
+        type = ScriptType::TYPE_X360;
+    else
+        return ErrorCode::ERR_INVALID_ARGUMENTS;
+
+    Compiler compiler(script);
+    compiler.setCompressionLevel(level);
+    compiler.setStackCheck(stackCheck);
+
+    ErrorCode error;
+    QByteArray result = compiler.compileResource(type, &error);
+
+    for (QString issue : compiler.getStackIssues())
+    {
+        err << issue << Qt::endl;
+    }
+
+    if (error != ErrorCode::ERR_NONE)
+    {
+        return error;
+    }
+
+    return writeFile(outPath, result);
+}
+
+static ErrorCode batch(QString path, QString outDir, LoadMode mode, int jobs)
+{
+    QStringList files = Batch::findScripts(path);
+
+    if (files.isEmpty())
+    {
+        err << "Error: No scripts found in " << path << "." << Qt::endl;
+        return ErrorCode::ERR_OPEN_FAILED;
+    }
+
+    Batch batch(files, outDir, mode);
+
+    if (jobs > 0)
+    {
+        batch.setThreadCount(jobs);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    DecompressStats before = DecompressPool::getStats();
+
+    ErrorCode firstError = ErrorCode::ERR_NONE;
+    int failed = 0;
+
+    for (const BatchResult &result : batch.run())
+    {
+        if (result.error != ErrorCode::ERR_NONE)
+        {
+            err << "FAIL " << result.path << ": " << Util::errorToString(result.error) << Qt::endl;
+
+            if (firstError == ErrorCode::ERR_NONE)
+                firstError = result.error;
+
+            failed++;
+            continue;
+        }
+
+        err << "OK   " << result.path << " (" << result.elapsed << " ms";
+
+        if (result.invalidCalls > 0)
+            err << ", " << result.invalidCalls << " invalid calls";
+
+        err << ")" << Qt::endl;
+    }
+
+    err << QString("%1 of %2 scripts disassembled in %3 ms.").arg(files.size() - failed).arg(files.size()).arg(timer.elapsed()) << Qt::endl;
+
+    DecompressStats after = DecompressPool::getStats();
+
+    err << QString("Decompression contexts: %1 allocated, %2 reused.")
+               .arg(after.lzxAllocated + after.inflateAllocated - before.lzxAllocated - before.inflateAllocated)
+               .arg(after.lzxReused + after.inflateReused - before.lzxReused - before.inflateReused)
+        << Qt::endl;
+
+    return firstError;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("rdrasm-cli");
+
+    Q_INIT_RESOURCE(rage);
+
+    QCommandLineParser parser;
+
+    parser.setApplicationDescription("Disassembler for Red Dead Redemption scripts.\n\n"
+                                     "Commands:\n"
+                                     "  disasm   write the disassembly of a script as text, jsonl or csv (stdout without -o)\n"
+                                     "  xrefs    write the callers of each function and the users of each native, static and global\n"
+                                     "  decompile write C-like pseudo code of every function (stdout without -o)\n"
+                                     "  export   write the raw decompressed script data\n"
+                                     "  convert  recompile a script to .csc or .xsc\n"
+                                     "  batch    disassemble every script in a directory or glob into -o\n"
+                                     "  bench    measure crypto and compression throughput, or decoding of a given .xsc\n"
+                                     "  selftest check every backend against known answers, needs no script");
+    parser.addHelpOption();
+
+    parser.addPositionalArgument("command", "disasm, xrefs, decompile, export, convert, batch, bench or selftest.");
+    parser.addPositionalArgument("script", "Script to open (.xsc or .csc), or a directory or glob for batch.", "[script]");
+
+    QCommandLineOption outOption({ "o", "output" }, "Output file.", "file");
+    QCommandLineOption toOption("to", "Target format of convert, csc or xsc.", "format");
+    QCommandLineOption mappedOption("mapped", "Map the script instead of reading it into memory.");
+    QCommandLineOption debugOption("debug", "Dump the decrypted script data to the debug folder.");
+    QCommandLineOption jobsOption({ "j", "jobs" }, "Scripts to process at once in batch mode, or functions when decompiling, defaults to the core count.", "count");
+    QCommandLineOption sizeOption("size", "Buffer size in KB for bench.", "kb", "1024");
+    QCommandLineOption keyOption("key", "AES key file, defaults to rdr_key.bin in the working directory.", "file");
+    QCommandLineOption levelOption("level", "Compression level of convert, 1 (fastest) to 9 (smallest), 0 stores uncompressed.", "level", QString::number(LZX_LEVEL_DEFAULT));
+    QCommandLineOption noStackCheckOption("no-stack-check", "Let convert write scripts whose stack doesn't balance.");
+    QCommandLineOption cacheOption("cache", "Decompiler cache directory, for decompile and bench.", "dir");
+    QCommandLineOption noCacheOption("no-cache", "Decompile every function again, without reading or writing the cache.");
+    QCommandLineOption formatOption("format", "Listing format of disasm: text, jsonl or csv.", "format", "text");
+    QCommandLineOption aesOption("aes", "AES backend: portable, ttable or aes-ni. Defaults to the fastest supported.", "backend");
+
+    parser.addOption(outOption);
+    parser.addOption(toOption);
+    parser.addOption(mappedOption);
+    parser.addOption(debugOption);
+    parser.addOption(jobsOption);
+    parser.addOption(sizeOption);
+    parser.addOption(keyOption);
+    parser.addOption(levelOption);
+    parser.addOption(noStackCheckOption);
+    parser.addOption(cacheOption);
+    parser.addOption(noCacheOption);
+    parser.addOption(formatOption);
+    parser.addOption(aesOption);
+
+    parser.process(a);
+
+    QStringList args = parser.positionalArguments();
+
+    if (parser.isSet(keyOption))
+    {
+        KeyRing::setKeyPath(parser.value(keyOption));
+    }
+
+    if (parser.isSet(aesOption))
+    {
+        bool found = false;
+
+        for (AesBackend backend : { AesBackend::AES_PORTABLE, AesBackend::AES_TTABLE, AesBackend::AES_NI })
+        {
+            if (Util::aesBackendToString(backend) == parser.value(aesOption))
+            {
+                found = Util::setAesBackend(backend);
+            }
+        }
+
+        if (!found)
+        {
+            err << "Error: AES backend " << parser.value(aesOption) << " is unknown or not supported on this cpu." << Qt::endl;
+            return ErrorCode::ERR_INVALID_ARGUMENTS;
+        }
+    }
+
+    if (args.size() == 1 && args[0] == "bench")
+    {
+        QTextStream out(stdout);
+
+        int size = parser.value(sizeOption).toInt() * 1024;
+
+        bool identical = Bench::aes(out, size);
+        identical &= Bench::lzx(out, size);
+        identical &= Bench::zlib(out, size);
+
+        return identical ? ErrorCode::ERR_NONE : ErrorCode::ERR_SELFTEST_FAILED;
+    }
+
+    if (args.size() == 2 && args[0] == "bench")
+    {
+        QTextStream out(stdout);
+
+        bool passed = Bench::decodeScript(out, args[1], parser.value(cacheOption), !parser.isSet(noCacheOption));
+        passed &= Bench::lzxScript(out, args[1]);
+
+        return passed ? ErrorCode::ERR_NONE : ErrorCode::ERR_SELFTEST_FAILED;
+    }
+
+    if (args.size() == 1 && args[0] == "selftest")
+    {
+        QTextStream out(stdout);
+
+        bool passed = SelfTest::aes(out);
+        passed &= SelfTest::lzx(out);
+        passed &= SelfTest::zlib(out);
+        passed &= SelfTest::opcodes(out);
+        passed &= SelfTest::formatting(out);
+        passed &= SelfTest::controlFlow(out);
+        passed &= SelfTest::stackVerifier(out);
+        passed &= SelfTest::decompiler(out);
+        passed &= SelfTest::decoding(out);
+        passed &= SelfTest::addresses(out);
+        passed &= SelfTest::xrefs(out);
+
+        return passed ? ErrorCode::ERR_NONE : ErrorCode::ERR_SELFTEST_FAILED;
+    }
+
+    if (args.size() != 2)
+    {
+        parser.showHelp(ErrorCode::ERR_INVALID_ARGUMENTS);
+    }
+
+    QString command = args[0];
+    QString outPath = parser.value(outOption);
+
+    if (command != "disasm" && command != "xrefs" && command != "decompile" && outPath.isEmpty())
+    {
+        err << "Error: " << command << " requires an output file (-o)." << Qt::endl;
+        return ErrorCode::ERR_INVALID_ARGUMENTS;
+    }
+
+    LoadMode mode = parser.isSet(mappedOption) ? LoadMode::LOAD_MAPPED : LoadMode::LOAD_READALL;
+
+    if (command == "batch")
+    {
+        return batch(args[1], outPath, mode, parser.value(jobsOption).toInt());
+    }
+
+    Script script(args[1], parser.isSet(debugOption), mode);
+
+    if (!script.isValid())
+    {
+        return fail(script.getError());
+    }
+
+    ErrorCode error;
+
+    if (command == "disasm")
+    {
+        error = disassemble(script, outPath, parser.value(formatOption));
+    }
+    else if (command == "xrefs")
+    {
+        error = writeXrefs(script, outPath);
+    }
+    else if (command == "decompile")
+    {
+        error = decompile(script, outPath, parser.value(jobsOption).toInt(), parser.value(cacheOption), !parser.isSet(noCacheOption));
+    }
+    else if (command == "export")
+    {
+        error = writeFile(outPath, script.getData());
+    }
+    else if (command == "convert")
+    {
+        int level = parser.value(levelOption).toInt();
+
+        if (level < LZX_LEVEL_STORE || level > LZX_LEVEL_BEST)
+        {
+            err << "Error: Compression level must be between " << LZX_LEVEL_STORE << " and " << LZX_LEVEL_BEST << "." << Qt::endl;
+            return ErrorCode::ERR_INVALID_ARGUMENTS;
+        }
+
+        error = convert(script, parser.value(toOption), outPath, level, !parser.isSet(noStackCheckOption));
+    }
+    else
+    {
+        error = ErrorCode::ERR_INVALID_ARGUMENTS;
+    }
+
+    if (error != ErrorCode::ERR_NONE)
+    {
+        return fail(error);
+    }
+
+    return ErrorCode::ERR_NONE;
+}
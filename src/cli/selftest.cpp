@@ -0,0 +1,1206 @@
+#include "selftest.h"
+
+#include <QBuffer>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+
+#include "../rage/controlflow.h"
+#include "../rage/decompiler.h"
+#include "../rage/disassembly.h"
+#include "../rage/instructionformatter.h"
+#include "../rage/opcodedesc.h"
+#include "../rage/opcodefactory.h"
+#include "../rage/script.h"
+#include "../rage/stackverifier.h"
+#include "../util/util.h"
+#include "../util/crypto/aes256.h"
+#include "../util/crypto/aesni.h"
+#include "../util/crypto/aestable.h"
+
+struct AesVector
+{
+    const char *key;
+    const char *plain;
+    const char *cipher;
+};
+
+// FIPS-197 appendix C.3 and SP 800-38A F.1.5
+static const AesVector s_aesVectors[] =
+{
+    { "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+      "00112233445566778899aabbccddeeff",
+      "8ea2b7ca516745bfeafc49904b496089" },
+    { "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4",
+      "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51",
+      "f3eed1bdb5d2a03c064b5a7e3db181f8591ccb10d410ed26dc5ba74a31362870" }
+};
+
+struct FormatVector
+{
+    int op;
+    const char *operand; // hex
+    const char *bytes;
+    const char *data;
+};
+
+// the text of the QString formatters the listing used before, floats as QString::arg rounds them
+static const FormatVector s_formatVectors[] =
+{
+    { EOpcodes::OP_ICMPEQ, "",         "8",             ""         },
+    { EOpcodes::OP_PUSH1B, "0a",       "370A",          "0A"       },
+    { EOpcodes::OP_PUSH2B, "01ab",     "3801AB",        "01 ab "   },
+    { EOpcodes::OP_IPUSH,  "ffffffff", "40FFFFFFFF",    "-1"       },
+    { EOpcodes::OP_IPUSH2, "1234",     "651234",        "4660"     },
+    { EOpcodes::OP_IPUSH3, "010000",   "109010000",     "65536"    },
+    { EOpcodes::OP_SADDI,  "ff",       "117FF",         "255"      },
+    { EOpcodes::OP_FPUSH,  "3f800000", "413F800000",    "1.0f"     },
+    { EOpcodes::OP_FPUSH,  "c0500000", "41C0500000",    "-3.25f"   },
+    { EOpcodes::OP_FPUSH,  "423c9000", "41423C9000",    "47.1406f" },
+    { EOpcodes::OP_FPUSH,  "423ca000", "41423CA000",    "47.1563f" },
+    { EOpcodes::OP_FPUSH,  "4b189680", "414B189680",    "1e+07.0f" },
+    { EOpcodes::OP_FPUSH,  "80000000", "4180000000",    "0.0f"     },
+    { EOpcodes::OP_ENTER,  "02000504", "02000504",      "02000504" },
+    { EOpcodes::OP_SPUSH,  "05",       "1115",          "05"       },
+    { EOpcodes::OP_SPUSH,  "85",       "111FFFFFFFFFFFFFF85", "85" }
+};
+
+struct EscapeVector
+{
+    const char *text;
+    const char *json;
+    const char *csv;
+};
+
+// fields of the jsonl and csv listings
+static const EscapeVector s_escapeVectors[] =
+{
+    { "plain",          "\"plain\"",               "plain"                },
+    { "say \"hi\"",     "\"say \\\"hi\\\"\"",      "\"say \"\"hi\"\"\""   },
+    { "a\\b",           "\"a\\\\b\"",              "a\\b"                 },
+    { "a,b",            "\"a,b\"",                 "\"a,b\""              },
+    { "a\nb",           "\"a\\nb\"",               "\"a\nb\""             },
+    { "a\rb",           "\"a\\u000db\"",           "\"a\rb\""             },
+    { "\t\x01\x1f",     "\"\\t\\u0001\\u001f\"",   "\t\x01\x1f"           }
+};
+
+struct FlowVector
+{
+    const char *name;
+    const char *idom;  // of each block
+    const char *ipdom; // of each block
+    const char *loops; // header (blocks), nested ones with the header of their parent
+    const char *unreachable;
+};
+
+// the functions SelfTest::controlFlow assembles, in order
+static const FlowVector s_flowVectors[] =
+{
+    { "diamond",      "-1 0 0 0",            "3 3 3 -1",             "",                           ""  },
+    { "nested loops", "-1 0 1 2 3 3 -1 1",   "1 7 3 5 3 1 -1 -1",    "1 (1 2 3 4 5), 3 in 1 (3 4)", "6" },
+    { "switch",       "-1 0 0 0 0",          "4 4 4 4 -1",           "",                           ""  }
+};
+
+struct StackVector
+{
+    const char *name;
+    const char *issues; // instruction within the function: kind, depth before it, depth expected
+};
+
+// the functions SelfTest::stackVerifier assembles, in order
+static const StackVector s_stackVectors[] =
+{
+    { "balanced",          ""                  },
+    { "underflow",         "2: underflow 1 2"  },
+    { "mismatch at join",  "4: mismatch 1 0"   },
+    { "return",            "3: return 2 1"     },
+    { "falls off the end", "2: falls off 1 -1" }
+};
+
+static const char *s_stackIssueNames[] = { "underflow", "mismatch", "return", "bad target", "falls off", "unknown" };
+
+struct AddressVector
+{
+    int pageGap;         // bytes between the code pages in the data
+    unsigned int location;
+    int address;         // -1 outside the code pages
+    int instruction;     // index of the instruction starting there, -1 if none
+};
+
+// the functions of addPagedFunctions, pages at 0x40, 0x4040 and 0x8040 or 0x40, 0x4140 and 0x8240
+static const AddressVector s_addressVectors[] =
+{
+    { 0,     0x40,   0x0000, 0     }, // entrypoint
+    { 0,     0x45,   0x0005, 1     },
+    { 0,     0x46,   0x0006, -1    }, // within an instruction
+    { 0,     0x4040, 0x4000, 16374 }, // first instruction of the second page
+    { 0,     0x8045, 0x8005, 32742 },
+    { 0,     0x804F, 0x800F, -1    }, // past the code, within the last page
+    { 0,     0x3F,   -1,     -1    }, // before the code
+    { 0,     0xC040, -1,     -1    }, // past the last page
+    { 0x100, 0x40,   0x0000, 0     },
+    { 0x100, 0x4040, -1,     -1    }, // between the first and second page
+    { 0x100, 0x413F, -1,     -1    },
+    { 0x100, 0x4140, 0x4000, 16374 },
+    { 0x100, 0x8245, 0x8005, 32742 },
+    { 0x100, 0x824F, 0x800F, -1    },
+    { 0x100, 0x3F,   -1,     -1    },
+    { 0x100, 0xC240, -1,     -1    }
+};
+
+struct XrefVector
+{
+    EXref kind;
+    int target;          // instruction, native slot, static or global
+    const char *sources; // instructions referencing it, in order
+};
+
+// the script SelfTest::xrefs assembles, every reference of each kind
+static const XrefVector s_xrefVectors[] =
+{
+    { EXref::XREF_CALL,   6,       "1 12" },
+    { EXref::XREF_JUMP,   7,       "11"   },
+    { EXref::XREF_JUMP,   12,      "9"    },
+    { EXref::XREF_NATIVE, 0x105,   "2 10" },
+    { EXref::XREF_STATIC, 3,       "4 7"  },
+    { EXref::XREF_GLOBAL, 5,       "8"    },
+    { EXref::XREF_GLOBAL, 0x11170, "3"    }
+};
+
+static const char *s_xrefKindNames[] = { "call", "jump", "native", "static", "global" };
+
+struct DecompileVector
+{
+    const char *name;
+    const char *text;
+};
+
+// the functions SelfTest::decompiler assembles, in order, starting with those of SelfTest::controlFlow
+static const DecompileVector s_decompileVectors[] =
+{
+    { "if/else",
+      "var __entrypoint(var param_0)\n"
+      "{\n"
+      "    if (param_0) {\n"
+      "        local_2 = 1;\n"
+      "    } else {\n"
+      "        local_2 = 2;\n"
+      "    }\n"
+      "    return local_2;\n"
+      "}\n" },
+    { "nested loops",
+      "void func_00001()\n"
+      "{\n"
+      "    local_2 = 0;\n"
+      "    while (local_2 < 10) {\n"
+      "        local_3 = 0;\n"
+      "        while (local_3 < 5) {\n"
+      "            local_3 = local_3 + 1;\n"
+      "        }\n"
+      "        local_2 = local_2 + 1;\n"
+      "    }\n"
+      "    return;\n"
+      "}\n" },
+    { "switch",
+      "void func_00002(var param_0)\n"
+      "{\n"
+      "    switch (param_0) {\n"
+      "        case 1:\n"
+      "            local_2 = 1;\n"
+      "            break;\n"
+      "        case 2:\n"
+      "            local_2 = 2;\n"
+      "            break;\n"
+      "        default:\n"
+      "            local_2 = 0;\n"
+      "            break;\n"
+      "    }\n"
+      "    return;\n"
+      "}\n" },
+    { "goto",
+      "void func_00003(var param_0)\n"
+      "{\n"
+      "    local_2 = 0;\n"
+      "    if (param_0) {\n"
+      "lbl_1:\n"
+      "        local_2 = local_2 + 1;\n"
+      "    }\n"
+      "    if (local_2 < 10) {\n"
+      "        goto lbl_1;\n"
+      "    }\n"
+      "    return;\n"
+      "}\n" },
+    { "stack slots",
+      "void func_00004(var param_0)\n"
+      "{\n"
+      "    var s_0, s_1;\n"
+      "\n"
+      "    s_0 = 5;\n"
+      "    if (param_0) {\n"
+      "        s_1 = 1;\n"
+      "    } else {\n"
+      "        s_1 = 2;\n"
+      "    }\n"
+      "    local_2 = s_0 + s_1;\n"
+      "    return;\n"
+      "}\n" },
+    { "two results",
+      "var func_00005()\n"
+      "{\n"
+      "    return { 1, 2 };\n"
+      "}\n" },
+    { "call with two results",
+      "void func_00006()\n"
+      "{\n"
+      "    var t_0 = func_00005();\n"
+      "    local_2 = t_0.f_1;\n"
+      "    local_3 = t_0.f_0;\n"
+      "    return;\n"
+      "}\n" }
+};
+
+// Hand assembles the code of a script built in memory. Jumps and switch
+// cases name a label, which is resolved once the code is done.
+class CodeBuilder
+{
+public:
+    void op(int op, std::initializer_list<int> operand = {})
+    {
+        m_code.append((char)op);
+        bytes(operand);
+    }
+
+    void enter(int params, int frameSize) { op(EOpcodes::OP_ENTER, { params, frameSize >> 8, frameSize & 0xFF, 0 }); }
+
+    void jump(int jumpOp, int label)
+    {
+        op(jumpOp);
+        addTarget(label);
+    }
+
+    // the op takes the top bits of the address, so both are written once the code is done
+    void call(int label)
+    {
+        m_calls.push_back(std::make_pair(m_code.size(), label));
+        m_code.append(3, 0);
+    }
+
+    void switchTo(std::initializer_list<std::pair<int, int>> cases) // value, label
+    {
+        op(EOpcodes::OP_SWITCHR2, { (int)cases.size() });
+
+        for (auto c : cases)
+        {
+            bytes({ c.first >> 24, c.first >> 16, c.first >> 8, c.first });
+            addTarget(c.second);
+        }
+    }
+
+    void label(int label) { m_labels[label] = m_code.size(); }
+
+    // nops to the end of the page, instructions never straddle one
+    void newPage()
+    {
+        while (m_code.size() % 0x4000 != 0)
+            op(EOpcodes::OP_NOP);
+    }
+
+    // a header, the page table and the code, as Script takes it once extracted. Pages
+    // are pageGap bytes apart, so their locations aren't contiguous unless it is 0.
+    QByteArray build(int pageGap = 0) const
+    {
+        const int pageTable = 0x30;
+        const int pages = (m_code.size() + 0x3FFF) / 0x4000;
+        const int codeStart = (pageTable + pages * 4 + 0xF) & ~0xF;
+
+        QByteArray data(codeStart, 0);
+
+        auto put = [&](int pos, unsigned int value)
+        {
+            for (int i = 0; i < 4; i++)
+                data[pos + i] = (char)(value >> (24 - i * 8));
+        };
+
+        put(0x00, 0xA8D74300); // magic
+        put(0x08, pageTable);
+        put(0x0C, m_code.size());
+
+        for (int page = 0; page < pages; page++)
+            put(pageTable + page * 4, codeStart + page * (0x4000 + pageGap));
+
+        QByteArray code = m_code;
+
+        // offsets count from the end of the 16 bit offset itself
+        for (auto target : m_targets)
+        {
+            int offset = m_labels.at(target.second) - (target.first + 2);
+
+            code[target.first]     = (char)(offset >> 8);
+            code[target.first + 1] = (char)offset;
+        }
+
+        for (auto target : m_calls)
+        {
+            int address = m_labels.at(target.second);
+
+            code[target.first]     = (char)(EOpcodes::OP_CALL2 + (address >> 16));
+            code[target.first + 1] = (char)(address >> 8);
+            code[target.first + 2] = (char)address;
+        }
+
+        for (int page = 0; page < pages; page++)
+        {
+            data += code.mid(page * 0x4000, 0x4000);
+
+            if (page < pages - 1)
+                data.append(pageGap, 0);
+        }
+
+        return data;
+    }
+
+private:
+    void bytes(std::initializer_list<int> values)
+    {
+        for (int value : values)
+            m_code.append((char)value);
+    }
+
+    void addTarget(int label)
+    {
+        m_targets.push_back(std::make_pair(m_code.size(), label));
+        m_code.append(2, 0);
+    }
+
+    QByteArray m_code;
+    std::map<int, int> m_labels;
+    std::vector<std::pair<int, int>> m_targets; // offset in the code, label
+    std::vector<std::pair<int, int>> m_calls;   // offset in the code, label
+};
+
+// if/else, nested loops and a switch, whose graphs SelfTest::controlFlow checks
+// and whose text SelfTest::decompiler checks, using labels 1 to 9
+static void addFlowFunctions(CodeBuilder &code)
+{
+    // if (param_0) local_2 = 1; else local_2 = 2; return local_2;
+    code.enter(1, 3);
+    code.op(EOpcodes::OP_GETF, { 0 });
+    code.jump(EOpcodes::OP_JMPF, 1);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.jump(EOpcodes::OP_JMP, 2);
+    code.label(1);
+    code.op(EOpcodes::OP_PUSH2);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.label(2);
+    code.op(EOpcodes::OP_GETF, { 2 });
+    code.op(EOpcodes::OP_RET1R1);
+
+    // for (local_2 = 0; local_2 < 10; local_2++) for (local_3 = 0; local_3 < 5; local_3++) {}
+    // with a block after the outer latch that nothing jumps to
+    code.enter(0, 5);
+    code.op(EOpcodes::OP_PUSH0);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.label(3);
+    code.op(EOpcodes::OP_GETF, { 2 });
+    code.op(EOpcodes::OP_PUSH1B, { 10 });
+    code.jump(EOpcodes::OP_JMPGE, 6);
+    code.op(EOpcodes::OP_PUSH0);
+    code.op(EOpcodes::OP_SETF, { 3 });
+    code.label(4);
+    code.op(EOpcodes::OP_GETF, { 3 });
+    code.op(EOpcodes::OP_PUSH1B, { 5 });
+    code.jump(EOpcodes::OP_JMPGE, 5);
+    code.op(EOpcodes::OP_GETF, { 3 });
+    code.op(EOpcodes::OP_IADDIMM1, { 1 });
+    code.op(EOpcodes::OP_SETF, { 3 });
+    code.jump(EOpcodes::OP_JMP, 4);
+    code.label(5);
+    code.op(EOpcodes::OP_GETF, { 2 });
+    code.op(EOpcodes::OP_IADDIMM1, { 1 });
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.jump(EOpcodes::OP_JMP, 3);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_SETF, { 4 });
+    code.label(6);
+    code.op(EOpcodes::OP_RET0R0);
+
+    // switch (param_0) { case 1: local_2 = 1; break; case 2: local_2 = 2; break; default: local_2 = 0; }
+    code.enter(1, 3);
+    code.op(EOpcodes::OP_GETF, { 0 });
+    code.switchTo({ { 1, 7 }, { 2, 8 } });
+    code.op(EOpcodes::OP_PUSH0);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.jump(EOpcodes::OP_JMP, 9);
+    code.label(7);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.jump(EOpcodes::OP_JMP, 9);
+    code.label(8);
+    code.op(EOpcodes::OP_PUSH2);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.label(9);
+    code.op(EOpcodes::OP_RET1R0);
+}
+
+// functions over three code pages, the last one partly filled, with jumps on
+// every page and calls between them, using labels 20 to 25
+static void addPagedFunctions(CodeBuilder &code)
+{
+    // if (param_0) local_2 = func_00002();
+    code.label(20);
+    code.enter(1, 3);
+    code.op(EOpcodes::OP_GETF, { 0 });
+    code.jump(EOpcodes::OP_JMPF, 21);
+    code.call(24);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.label(21);
+    code.op(EOpcodes::OP_RET1R0);
+    code.newPage();
+
+    // while (local_2 < 10) local_2 = local_2 + 1;
+    code.enter(0, 3);
+    code.label(22);
+    code.op(EOpcodes::OP_GETF, { 2 });
+    code.op(EOpcodes::OP_PUSH1B, { 10 });
+    code.jump(EOpcodes::OP_JMPGE, 23);
+    code.op(EOpcodes::OP_GETF, { 2 });
+    code.op(EOpcodes::OP_IADDIMM1, { 1 });
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.jump(EOpcodes::OP_JMP, 22);
+    code.label(23);
+    code.op(EOpcodes::OP_RET0R0);
+
+    // return 1;
+    code.label(24);
+    code.enter(0, 2);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_RET0R1);
+    code.newPage();
+
+    // if (param_0) __entrypoint(1);
+    code.enter(1, 2);
+    code.op(EOpcodes::OP_GETF, { 0 });
+    code.jump(EOpcodes::OP_JMPF, 25);
+    code.op(EOpcodes::OP_PUSH1);
+    code.call(20);
+    code.label(25);
+    code.op(EOpcodes::OP_RET1R0);
+}
+
+// one pass of the cipher straight through a backend, bypassing the rdr 16 pass construction
+static void runBackend(AesBackend backend, bool decrypt, const QByteArray &key, QByteArray &data)
+{
+    uint8_t *buf = (uint8_t*)data.data();
+    size_t blocks = data.size() / 16;
+
+    if (backend == AesBackend::AES_NI)
+    {
+        aesni_context ctx;
+        aesni_init(&ctx, (const uint8_t*)key.constData());
+
+        if (decrypt)
+            aesni_decrypt_ecb(&ctx, buf, blocks, 1);
+        else
+            aesni_encrypt_ecb(&ctx, buf, blocks, 1);
+    }
+    else if (backend == AesBackend::AES_TTABLE)
+    {
+        aestable_context ctx;
+        aestable_init(&ctx, (const uint8_t*)key.constData());
+
+        if (decrypt)
+            aestable_decrypt_ecb(&ctx, buf, blocks, 1);
+        else
+            aestable_encrypt_ecb(&ctx, buf, blocks, 1);
+    }
+    else
+    {
+        QByteArray keyCopy = key;
+
+        aes256_context ctx;
+        aes256_init(&ctx, (uint8_t*)keyCopy.data());
+
+        for (size_t i = 0; i < blocks; i++)
+        {
+            if (decrypt)
+                aes256_decrypt_ecb(&ctx, buf + i * 16);
+            else
+                aes256_encrypt_ecb(&ctx, buf + i * 16);
+        }
+
+        aes256_done(&ctx);
+    }
+}
+
+static bool check(QTextStream &out, QString name, bool passed)
+{
+    out << (passed ? "  pass " : "  FAIL ") << name << Qt::endl;
+    return passed;
+}
+
+// null unless the code loads as a script of funcs functions
+static std::unique_ptr<Script> buildScript(QTextStream &out, const CodeBuilder &code, int funcs, int pageGap = 0)
+{
+    std::unique_ptr<Script> script(new Script(code.build(pageGap), ScriptType::TYPE_X360));
+
+    int built = script->isValid() ? (int)ControlFlowGraph::getFunctionRanges(script->getView()).size() : 0;
+
+    if (!check(out, QString("%1 functions built in memory").arg(funcs), built == funcs))
+        return nullptr;
+
+    return script;
+}
+
+bool SelfTest::aes(QTextStream &out)
+{
+    AesBackend previous = Util::getAesBackend();
+    bool passed = true;
+
+    // random buffer with a partial block at the end, which must be left alone
+    std::mt19937 rng(7);
+    QByteArray key(32, 0), input(0x40000 + 16 * 5 + 7, 0);
+
+    for (char &c : key)   c = (char)rng();
+    for (char &c : input) c = (char)rng();
+
+    QByteArray refDecrypted(input.size(), 0), refEncrypted(input.size(), 0);
+
+    Util::setAesBackend(AesBackend::AES_PORTABLE);
+    Util::decrypt(input.constData(), refDecrypted.data(), input.size(), key);
+    Util::encrypt(input.constData(), refEncrypted.data(), input.size(), key);
+
+    out << "aes" << Qt::endl;
+
+    for (AesBackend backend : { AesBackend::AES_PORTABLE, AesBackend::AES_TTABLE, AesBackend::AES_NI })
+    {
+        QString name = Util::aesBackendToString(backend);
+
+        if (!Util::setAesBackend(backend))
+        {
+            out << "  skip " << name << " (not supported on this cpu)" << Qt::endl;
+            continue;
+        }
+
+        for (const AesVector &vector : s_aesVectors)
+        {
+            QByteArray vectorKey = QByteArray::fromHex(vector.key);
+            QByteArray plain     = QByteArray::fromHex(vector.plain);
+            QByteArray cipher    = QByteArray::fromHex(vector.cipher);
+
+            QByteArray data = plain;
+            runBackend(backend, false, vectorKey, data);
+            passed &= check(out, QString("%1 encrypt %2").arg(name).arg(vector.plain), data == cipher);
+
+            data = cipher;
+            runBackend(backend, true, vectorKey, data);
+            passed &= check(out, QString("%1 decrypt %2").arg(name).arg(vector.cipher), data == plain);
+        }
+
+        QByteArray decrypted(input.size(), 0), encrypted(input.size(), 0);
+
+        Util::decrypt(input.constData(), decrypted.data(), input.size(), key);
+        Util::encrypt(input.constData(), encrypted.data(), input.size(), key);
+
+        passed &= check(out, QString("%1 rdr decrypt matches portable").arg(name), decrypted == refDecrypted);
+        passed &= check(out, QString("%1 rdr encrypt matches portable").arg(name), encrypted == refEncrypted);
+
+        Util::decrypt(encrypted.constData(), encrypted.data(), encrypted.size(), key);
+
+        passed &= check(out, QString("%1 rdr round trip").arg(name), encrypted == input);
+    }
+
+    Util::setAesBackend(previous);
+
+    return passed;
+}
+
+bool SelfTest::lzx(QTextStream &out)
+{
+    std::mt19937 rng(9);
+    bool passed = true;
+
+    out << "lzx" << Qt::endl;
+
+    // full frames, a short last frame, and data that only compresses with long matches
+    for (int size : { 1, 0x8000, 0x8000 * 3 + 123 })
+    {
+        QByteArray random(size, 0), zeros(size, 0), repeated(size, 0);
+
+        for (int i = 0; i < size; i++)
+        {
+            random[i]   = (char)rng();
+            repeated[i] = (i < 300) ? (char)rng() : repeated[i - 300 + (int)(rng() % 3)];
+        }
+
+        const std::pair<const char *, QByteArray> inputs[] = { { "random", random }, { "zeros", zeros }, { "repeated", repeated } };
+
+        for (const auto &input : inputs)
+        {
+            for (int level : { LZX_LEVEL_STORE, LZX_LEVEL_FASTEST, LZX_LEVEL_DEFAULT, LZX_LEVEL_BEST })
+            {
+                QByteArray compressed = Util::lzxCompress(input.second, level);
+                QByteArray decompressed(size, 0);
+
+                bool ok = compressed.size() >= 8 &&
+                          Util::lzxDecompress(compressed.constData() + 8, compressed.size() - 8, decompressed.data(), size) == 0 &&
+                          decompressed == input.second;
+
+                passed &= check(out, QString("%1 bytes %2 level %3 round trip").arg(size).arg(input.first).arg(level), ok);
+            }
+        }
+    }
+
+    // a run of one byte up to the last byte, so a match is cut short only by the end of the input
+    for (int size : { 0x8000, 0x8000 + 4000, 0x8000 * 2 + 7 })
+    {
+        QByteArray run(size, 'a');
+
+        for (int i = 0; i < 64; i++)
+            run[i] = (char)rng();
+
+        for (int level : { LZX_LEVEL_FASTEST, LZX_LEVEL_DEFAULT, LZX_LEVEL_BEST })
+        {
+            QByteArray compressed = Util::lzxCompress(run, level);
+            QByteArray decompressed(size, 0);
+
+            bool ok = compressed.size() >= 8 &&
+                      Util::lzxDecompress(compressed.constData() + 8, compressed.size() - 8, decompressed.data(), size) == 0 &&
+                      decompressed == run;
+
+            passed &= check(out, QString("%1 bytes run to end level %2 round trip").arg(size).arg(level), ok);
+        }
+    }
+
+    return passed;
+}
+
+bool SelfTest::zlib(QTextStream &out)
+{
+    std::mt19937 rng(11);
+    bool passed = true;
+
+    out << "zlib" << Qt::endl;
+
+    // empty, inside one chunk, and spanning several chunks with a partial last one
+    for (int size : { 0, 1000, 0x20000 * 3 + 77 })
+    {
+        QByteArray input(size, 0);
+
+        for (int i = 0; i < size; i++)
+            input[i] = (i < 100 || rng() % 4 == 0) ? (char)(rng() % 50) : input[i - 1 - (int)(rng() % 90)];
+
+        for (int level : { 0, 1, 6, 9 })
+        {
+            QByteArray compressed = Util::zlibCompress(input, level);
+            QByteArray padded = compressed + QByteArray(16, 0); // aes padding after the stream
+            QByteArray decompressed(size, 0);
+
+            int reported = 0;
+            bool ordered = true;
+
+            int res = Util::zlibDecompress(padded.constData(), padded.size(), decompressed.data(), size, [&](int done, int total)
+            {
+                ordered &= (done >= reported && total == size);
+                reported = done;
+            });
+
+            bool ok = !compressed.isEmpty() && res == 0 && decompressed == input && ordered && reported == size;
+
+            passed &= check(out, QString("%1 bytes level %2 round trip").arg(size).arg(level), ok);
+        }
+    }
+
+    return passed;
+}
+
+bool SelfTest::opcodes(QTextStream &out)
+{
+    bool passed = true;
+
+    out << "opcodes" << Qt::endl;
+
+    // the descriptor table comes from opcodes.json, the classes have their own name and size
+    for (int i = 0; i < OPCODE_COUNT; i++)
+    {
+        const OpcodeDesc &desc = opcodeDesc(i);
+        auto op = OpcodeFactory::Create((EOpcodes)i);
+
+        bool ok = op && op->getOp() == i && op->getName() == desc.name && (desc.size == 0 || op->getSize() == desc.size);
+
+        if (!ok)
+            passed &= check(out, QString("%1 (%2) matches its class").arg(desc.name).arg(i), false);
+    }
+
+    if (passed)
+        check(out, QString("%1 descriptors match their classes").arg(OPCODE_COUNT), true);
+
+    return passed;
+}
+
+bool SelfTest::formatting(QTextStream &out)
+{
+    bool passed = true;
+
+    out << "formatting" << Qt::endl;
+
+    TextBuffer buffer;
+
+    auto text = [&]()
+    {
+        QString result = buffer.toString();
+        buffer.clear();
+        return result;
+    };
+
+    for (const FormatVector &v : s_formatVectors)
+    {
+        QByteArray operand = QByteArray::fromHex(v.operand);
+        auto bytes = (const unsigned char*)operand.constData();
+
+        InstructionFormatter::writeBytes(buffer, v.op, bytes, operand.size());
+        QString written = text();
+
+        InstructionFormatter::writeData(buffer, v.op, bytes, operand.size());
+        QString data = text();
+
+        bool ok = written == v.bytes && data == v.data;
+
+        passed &= check(out, QString("%1 %2 as %3 %4").arg(opcodeDesc(v.op).name).arg(v.operand).arg(v.bytes).arg(v.data), ok);
+    }
+
+    InstructionFormatter::writeLocation(buffer, 0x1f, 0xabcde);
+    passed &= check(out, "location 0001F:00ABCDE", text() == "0001F:00ABCDE");
+
+    QByteArray enter = QByteArray::fromHex("020005056d61696e00");
+    InstructionFormatter::writeFuncName(buffer, (const unsigned char*)enter.constData(), enter.size());
+    passed &= check(out, "enter name up to the terminator", text() == "main");
+
+    QByteArray string = QByteArray::fromHex("06610a6200ff");
+    InstructionFormatter::writeString(buffer, (const unsigned char*)string.constData(), string.size());
+    passed &= check(out, "spush quoted with line breaks escaped", text() == "\"a\\nb\"");
+
+    for (const EscapeVector &v : s_escapeVectors)
+    {
+        buffer.appendJsonString(v.text, (int)strlen(v.text));
+        QString json = text();
+
+        buffer.appendCsvField(v.text, (int)strlen(v.text));
+        QString csv = text();
+
+        passed &= check(out, QString("json and csv of %1").arg(v.json), json == v.json && csv == v.csv);
+    }
+
+    buffer.appendDecimal(INT_MIN);
+    passed &= check(out, "decimal of INT_MIN", text() == "-2147483648");
+
+    // widths count characters, not utf-8 bytes
+    buffer.append("\xc3\xa9");
+    buffer.leftJustify(0, 3);
+    passed &= check(out, "justified by characters", text() == QString::fromUtf8("\xc3\xa9  "));
+
+    // rows of the listings, for a string with a quote in it, 5 bytes into the code at 0x40
+    CodeBuilder code;
+
+    code.enter(0, 2);
+    code.op(EOpcodes::OP_SPUSH, { 4, 'a', '"', 'b', 0 });
+    code.op(EOpcodes::OP_DROP);
+    code.op(EOpcodes::OP_RET0R0);
+
+    Script script(code.build(), ScriptType::TYPE_X360);
+
+    if (!check(out, "script built in memory", script.isValid()))
+        return false;
+
+    Disassembly disassembly(script.getView(), QMap<unsigned int, QString>());
+
+    auto row = [&](ListingFormat format, int line)
+    {
+        QBuffer device;
+        device.open(QIODevice::WriteOnly);
+        disassembly.write(&device, format);
+
+        return QString::fromUtf8(device.data().split('\n').value(line));
+    };
+
+    QString jsonRow = "{\"location\":\"00000:0000045\",\"bytes\":\"1114\",\"op\":\"spush\",\"data\":\"\\\"a\\\"b\\\"\","
+                      "\"function\":\"__entrypoint\",\"label\":null}";
+    QString csvRow  = "00000:0000045,1114,spush,\"\"\"a\"\"b\"\"\",__entrypoint,";
+
+    passed &= check(out, "jsonl row " + jsonRow, row(ListingFormat::LISTING_JSONL, 1) == jsonRow);
+    passed &= check(out, "csv row " + csvRow, row(ListingFormat::LISTING_CSV, 2) == csvRow);
+
+    return passed;
+}
+
+bool SelfTest::controlFlow(QTextStream &out)
+{
+    out << "control flow" << Qt::endl;
+
+    CodeBuilder code;
+    addFlowFunctions(code);
+
+    int funcs = sizeof(s_flowVectors) / sizeof(s_flowVectors[0]);
+
+    std::unique_ptr<Script> script = buildScript(out, code, funcs);
+
+    if (!script)
+        return false;
+
+    std::vector<ControlFlowGraph> graphs = ControlFlowGraph::buildAll(script->getView(), 1);
+
+    bool passed = true;
+
+    for (int func = 0; func < funcs; func++)
+    {
+        const FlowVector &v = s_flowVectors[func];
+        const ControlFlowGraph &cfg = graphs[func];
+
+        QStringList idom, ipdom, loops, unreachable;
+
+        for (int block = 0; block < (int)cfg.getBlocks().size(); block++)
+        {
+            idom  << QString::number(cfg.getBlocks()[block].idom);
+            ipdom << QString::number(cfg.getBlocks()[block].ipdom);
+
+            if (!cfg.isReachable(block))
+                unreachable << QString::number(block);
+        }
+
+        for (const Loop &loop : cfg.getLoops())
+        {
+            QStringList blocks;
+
+            for (int block : loop.blocks)
+                blocks << QString::number(block);
+
+            QString parent = (loop.parent == -1) ? "" : QString(" in %1").arg(cfg.getLoops()[loop.parent].header);
+
+            loops << QString("%1%2 (%3)").arg(loop.header).arg(parent).arg(blocks.join(" "));
+        }
+
+        passed &= check(out, QString("%1 idom %2").arg(v.name).arg(v.idom), idom.join(" ") == v.idom);
+        passed &= check(out, QString("%1 ipdom %2").arg(v.name).arg(v.ipdom), ipdom.join(" ") == v.ipdom);
+        passed &= check(out, QString("%1 loops %2").arg(v.name).arg(v.loops), loops.join(", ") == v.loops);
+        passed &= check(out, QString("%1 unreachable blocks %2").arg(v.name).arg(v.unreachable), unreachable.join(" ") == v.unreachable);
+    }
+
+    return passed;
+}
+
+bool SelfTest::stackVerifier(QTextStream &out)
+{
+    out << "stack verifier" << Qt::endl;
+
+    CodeBuilder code;
+
+    // if (param_0) local_2 = 1;
+    code.enter(1, 3);
+    code.op(EOpcodes::OP_GETF, { 0 });
+    code.jump(EOpcodes::OP_JMPF, 1);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.label(1);
+    code.op(EOpcodes::OP_RET1R0);
+
+    // iadd with one value pushed
+    code.enter(0, 2);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_IADD);
+    code.op(EOpcodes::OP_DROP);
+    code.op(EOpcodes::OP_RET0R0);
+
+    // one path pushes before the join, the other doesn't
+    code.enter(1, 3);
+    code.op(EOpcodes::OP_GETF, { 0 });
+    code.jump(EOpcodes::OP_JMPF, 2);
+    code.op(EOpcodes::OP_PUSH1);
+    code.label(2);
+    code.op(EOpcodes::OP_RET1R0);
+
+    // two values left for one result
+    code.enter(0, 2);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_PUSH2);
+    code.op(EOpcodes::OP_RET0R1);
+
+    // no return before the next function
+    code.enter(0, 2);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_DROP);
+
+    int funcs = sizeof(s_stackVectors) / sizeof(s_stackVectors[0]);
+
+    std::unique_ptr<Script> script = buildScript(out, code, funcs);
+
+    if (!script)
+        return false;
+
+    std::vector<std::pair<int, int>> ranges = ControlFlowGraph::getFunctionRanges(script->getView());
+
+    StackVerifier verifier(script->getInstructions(), script->getPageLocations());
+
+    bool balanced = verifier.verify(1);
+
+    bool passed = check(out, "unbalanced script fails", !balanced);
+
+    for (int func = 0; func < funcs; func++)
+    {
+        const StackVector &v = s_stackVectors[func];
+
+        QStringList issues;
+
+        for (const StackIssue &issue : verifier.getIssues())
+        {
+            if (issue.index < ranges[func].first || issue.index >= ranges[func].second)
+                continue;
+
+            issues << QString("%1: %2 %3 %4").arg(issue.index - ranges[func].first).arg(s_stackIssueNames[issue.kind]).arg(issue.depth).arg(issue.expected);
+        }
+
+        passed &= check(out, QString("%1 reports \"%2\"").arg(v.name).arg(v.issues), issues.join(", ") == v.issues);
+    }
+
+    return passed;
+}
+
+bool SelfTest::decompiler(QTextStream &out)
+{
+    out << "decompiler" << Qt::endl;
+
+    CodeBuilder code;
+    addFlowFunctions(code);
+
+    // a loop entered both at its top and at its test, which only a goto can express
+    code.enter(1, 3);
+    code.op(EOpcodes::OP_PUSH0);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.op(EOpcodes::OP_GETF, { 0 });
+    code.jump(EOpcodes::OP_JMPF, 11);
+    code.label(10);
+    code.op(EOpcodes::OP_GETF, { 2 });
+    code.op(EOpcodes::OP_IADDIMM1, { 1 });
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.label(11);
+    code.op(EOpcodes::OP_GETF, { 2 });
+    code.op(EOpcodes::OP_PUSH1B, { 10 });
+    code.jump(EOpcodes::OP_JMPLT, 10);
+    code.op(EOpcodes::OP_RET1R0);
+
+    // local_2 = 5 + (param_0 ? 1 : 2), the 5 and either branch's value stay on the stack over the join
+    code.enter(1, 3);
+    code.op(EOpcodes::OP_PUSH1B, { 5 });
+    code.op(EOpcodes::OP_GETF, { 0 });
+    code.jump(EOpcodes::OP_JMPF, 12);
+    code.op(EOpcodes::OP_PUSH1);
+    code.jump(EOpcodes::OP_JMP, 13);
+    code.label(12);
+    code.op(EOpcodes::OP_PUSH2);
+    code.label(13);
+    code.op(EOpcodes::OP_IADD);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.op(EOpcodes::OP_RET1R0);
+
+    // returns two values, which the next function stores in two locals
+    code.label(14);
+    code.enter(0, 2);
+    code.op(EOpcodes::OP_PUSH1);
+    code.op(EOpcodes::OP_PUSH2);
+    code.op(EOpcodes::OP_RET0R2);
+
+    code.enter(0, 4);
+    code.call(14);
+    code.op(EOpcodes::OP_SETF, { 2 });
+    code.op(EOpcodes::OP_SETF, { 3 });
+    code.op(EOpcodes::OP_RET0R0);
+
+    int funcs = sizeof(s_decompileVectors) / sizeof(s_decompileVectors[0]);
+
+    std::unique_ptr<Script> script = buildScript(out, code, funcs);
+
+    if (!script)
+        return false;
+
+    Decompiler decompiler(script->getView(), QMap<unsigned int, QString>());
+
+    // what is checked is the decompiler, not a cached copy of its text
+    decompiler.setUseCache(false);
+    decompiler.run();
+
+    if (!check(out, QString("%1 functions decompiled").arg(funcs), decompiler.getFunctionCount() == funcs))
+        return false;
+
+    bool passed = true;
+
+    for (int func = 0; func < funcs; func++)
+    {
+        const DecompileVector &v = s_decompileVectors[func];
+
+        bool matches = decompiler.getFunction(func) == v.text;
+
+        passed &= check(out, QString("%1 decompiles to the expected text").arg(v.name), matches);
+
+        if (!matches)
+            out << decompiler.getFunction(func);
+    }
+
+    return passed;
+}
+
+bool SelfTest::decoding(QTextStream &out)
+{
+    out << "decoding" << Qt::endl;
+
+    CodeBuilder code;
+    addPagedFunctions(code);
+
+    int threads = Script::getDecodeThreadCount();
+
+    // pages apart in the data, so the page table is what places them
+    Script::setDecodeThreadCount(1);
+    std::unique_ptr<Script> serial = buildScript(out, code, 4, 0x100);
+
+    Script::setDecodeThreadCount(4);
+    std::unique_ptr<Script> parallel(new Script(code.build(0x100), ScriptType::TYPE_X360));
+
+    Script::setDecodeThreadCount(threads);
+
+    if (!serial)
+        return false;
+
+    const InstructionStream &expected = serial->getInstructions();
+    const InstructionStream &decoded = parallel->getInstructions();
+
+    QStringList names;
+
+    for (auto func : expected.getFuncs())
+        names << func.second;
+
+    bool passed = check(out, QString("functions %1").arg(names.join(" ")), names.join(" ") == "__entrypoint func_00001 func_00002 func_00003");
+    passed &= check(out, QString("%1 labels on 1 thread").arg(expected.getLabelIndex().size()), expected.getLabelIndex().size() == 4);
+
+    auto sameLabel = [](const Label &a, const Label &b) { return a.index == b.index && a.number == b.number; };
+
+    passed &= check(out, "4 threads decode the same instructions", decoded.size() == expected.size());
+    passed &= check(out, "4 threads name the same functions", decoded.getFuncs() == expected.getFuncs());
+    passed &= check(out, "4 threads number the same labels", decoded.getLabels() == expected.getLabels());
+    passed &= check(out, "4 threads index the same labels", decoded.getLabelIndex().size() == expected.getLabelIndex().size()
+                                                            && std::equal(decoded.getLabelIndex().begin(), decoded.getLabelIndex().end(), expected.getLabelIndex().begin(), sameLabel));
+
+    return passed;
+}
+
+bool SelfTest::addresses(QTextStream &out)
+{
+    out << "addresses" << Qt::endl;
+
+    CodeBuilder code;
+    addPagedFunctions(code);
+
+    auto hex = [](int value) { return (value == -1) ? QString("-1") : QString::number(value, 16); };
+
+    bool passed = true;
+
+    // contiguous pages are found by a shift, the others by a search
+    for (int pageGap : { 0, 0x100 })
+    {
+        std::unique_ptr<Script> script = buildScript(out, code, 4, pageGap);
+
+        if (!script)
+            return false;
+
+        for (const AddressVector &v : s_addressVectors)
+        {
+            if (v.pageGap != pageGap)
+                continue;
+
+            int address = script->getAddressByLocation(v.location);
+            int instruction = script->getInstructionByLocation(v.location);
+
+            passed &= check(out, QString("gap %1 location %2 is address %3").arg(hex(pageGap)).arg(hex(v.location)).arg(hex(v.address)), address == v.address);
+            passed &= check(out, QString("gap %1 location %2 is instruction %3").arg(hex(pageGap)).arg(hex(v.location)).arg(v.instruction), instruction == v.instruction);
+
+            if (v.address != -1)
+                passed &= check(out, QString("gap %1 address %2 is location %3").arg(hex(pageGap)).arg(hex(v.address)).arg(hex(v.location)), script->getLocationByAddress(v.address) == (int)v.location);
+        }
+
+        passed &= check(out, QString("gap %1 address c000 is past the last page").arg(hex(pageGap)), script->getLocationByAddress(0xC000) == -1);
+    }
+
+    return passed;
+}
+
+bool SelfTest::xrefs(QTextStream &out)
+{
+    out << "xrefs" << Qt::endl;
+
+    CodeBuilder code;
+
+    // func_00001(); native 0x105; static_3 = global_11170;
+    code.enter(0, 2);
+    code.call(30);
+    code.op(EOpcodes::OP_NATIVE, { 0x40, 0x05 });
+    code.op(EOpcodes::OP_GLOBALGET3, { 0x01, 0x11, 0x70 });
+    code.op(EOpcodes::OP_STATICSET2, { 0, 3 });
+    code.op(EOpcodes::OP_RET0R0);
+
+    // while (static_3 < global_5) native 0x105; func_00001();
+    code.label(30);
+    code.enter(0, 2);
+    code.label(31);
+    code.op(EOpcodes::OP_STATICGET2, { 0, 3 });
+    code.op(EOpcodes::OP_GLOBALGET2, { 0, 5 });
+    code.jump(EOpcodes::OP_JMPGE, 32);
+    code.op(EOpcodes::OP_NATIVE, { 0x40, 0x05 });
+    code.jump(EOpcodes::OP_JMP, 31);
+    code.label(32);
+    code.call(30);
+    code.op(EOpcodes::OP_RET0R0);
+
+    std::unique_ptr<Script> script = buildScript(out, code, 2);
+
+    if (!script)
+        return false;
+
+    const XrefIndex &xrefs = script->getXrefs();
+
+    int counts[XREF_COUNT] = {};
+    bool passed = true;
+
+    for (const XrefVector &v : s_xrefVectors)
+    {
+        QStringList sources;
+        bool targeted = true;
+
+        for (int source : xrefs.getRefsTo(v.kind, v.target))
+        {
+            sources << QString::number(source);
+            targeted &= (xrefs.getTarget(v.kind, source) == v.target);
+        }
+
+        counts[v.kind] += sources.size();
+
+        // native slots and globals read as in the listing, instructions by index
+        int base = (v.kind == EXref::XREF_NATIVE || v.kind == EXref::XREF_GLOBAL) ? 16 : 10;
+
+        QString name = QString("%1 %2").arg(s_xrefKindNames[v.kind]).arg(v.target, 0, base);
+
+        passed &= check(out, QString("%1 referenced by \"%2\"").arg(name).arg(v.sources), sources.join(" ") == v.sources);
+        passed &= check(out, QString("%1 is the target of its references").arg(name), targeted);
+    }
+
+    // nothing beyond the rows above
+    for (int kind = 0; kind < XREF_COUNT; kind++)
+    {
+        passed &= check(out, QString("%1 %2 references").arg(counts[kind]).arg(s_xrefKindNames[kind]), xrefs.count((EXref)kind) == counts[kind]);
+    }
+
+    passed &= check(out, "ret has no call target", xrefs.getTarget(EXref::XREF_CALL, 5) == -1);
+    passed &= check(out, "call has no jump target", xrefs.getTarget(EXref::XREF_JUMP, 1) == -1);
+
+    return passed;
+}
@@ -0,0 +1,23 @@
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#include <QTextStream>
+
+// Known-answer and cross-backend checks, run with "rdrasm-cli selftest"
+class SelfTest
+{
+public:
+    static bool aes(QTextStream &out);
+    static bool lzx(QTextStream &out);
+    static bool zlib(QTextStream &out);
+    static bool opcodes(QTextStream &out);
+    static bool formatting(QTextStream &out);
+    static bool controlFlow(QTextStream &out);
+    static bool stackVerifier(QTextStream &out);
+    static bool decompiler(QTextStream &out);
+    static bool decoding(QTextStream &out);
+    static bool addresses(QTextStream &out);
+    static bool xrefs(QTextStream &out);
+};
+
+#endif // SELFTEST_H
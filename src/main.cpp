@@ -11,6 +11,8 @@ int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
+    Q_INIT_RESOURCE(rage); // lives in the core library
+
     QFile stylesheet(":/res/light.qss");
 
     if (!stylesheet.open(QIODevice::ReadOnly))
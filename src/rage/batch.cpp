@@ -0,0 +1,124 @@
+#include "batch.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "disassembly.h"
+
+Batch::Batch(QStringList files, QString outDir, LoadMode mode)
+    : m_files(files)
+    , m_outDir(outDir)
+    , m_mode(mode)
+    , m_threadCount(QThread::idealThreadCount())
+{
+    m_nativeMap = Util::getNatives();
+}
+
+QStringList Batch::findScripts(QString path)
+{
+    QFileInfo info(path);
+    QDir dir;
+    QStringList filters;
+
+    if (info.isDir())
+    {
+        dir = QDir(path);
+        filters = QStringList({ "*.xsc", "*.csc" });
+    }
+    else
+    {
+        dir = info.dir();
+        filters = QStringList({ info.fileName() });
+    }
+
+    QStringList files;
+
+    for (QString file : dir.entryList(filters, QDir::Files, QDir::Name))
+    {
+        files.append(dir.filePath(file));
+    }
+
+    return files;
+}
+
+QVector<BatchResult> Batch::run()
+{
+    QDir().mkpath(m_outDir);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, m_threadCount));
+
+    int aesThreads = Util::getAesThreadCount();
+    int decodeThreads = Script::getDecodeThreadCount();
+
+    // the pool already keeps every core busy, splitting each decrypt or decode further only adds threads
+    if (pool.maxThreadCount() > 1)
+    {
+        Util::setAesThreadCount(1);
+        Script::setDecodeThreadCount(1);
+    }
+
+    QVector<QFuture<BatchResult>> futures;
+
+    for (QString file : m_files)
+    {
+        futures.append(QtConcurrent::run(&pool, [this, file]{ return process(file); }));
+    }
+
+    QVector<BatchResult> results;
+
+    for (auto &future : futures)
+    {
+        results.append(future.result());
+    }
+
+    Util::setAesThreadCount(aesThreads);
+    Script::setDecodeThreadCount(decodeThreads);
+
+    return results;
+}
+
+BatchResult Batch::process(QString path)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    BatchResult result;
+
+    result.path    = path;
+    result.outPath = QDir(m_outDir).filePath(QFileInfo(path).fileName() + ".txt");
+
+    Script script(path, false, m_mode);
+
+    if (!script.isValid())
+    {
+        result.error   = script.getError();
+        result.elapsed = timer.elapsed();
+
+        return result;
+    }
+
+    Disassembly disassembly(script.getView(), m_nativeMap);
+
+    result.invalidCalls = disassembly.getInvalidCalls();
+
+    QFile file(result.outPath);
+
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        QTextStream out(&file);
+        disassembly.write(out);
+    }
+    else
+    {
+        result.error = ErrorCode::ERR_WRITE_FAILED;
+    }
+
+    result.elapsed = timer.elapsed();
+
+    return result;
+}
@@ -0,0 +1,46 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <QMap>
+#include <QStringList>
+#include <QVector>
+
+#include "script.h"
+#include "../util/util.h"
+
+struct BatchResult
+{
+    QString path;
+    QString outPath;
+    ErrorCode error  = ErrorCode::ERR_NONE;
+    int invalidCalls = 0;
+    qint64 elapsed   = 0; // ms
+};
+
+// Disassembles a set of scripts on a thread pool, one output file per script.
+// Scripts share nothing but the native map, which is only read.
+class Batch
+{
+public:
+    Batch(QStringList files, QString outDir, LoadMode mode = LoadMode::LOAD_READALL);
+
+    // directory, or a glob like "scripts/*.xsc"
+    static QStringList findScripts(QString path);
+
+    void setThreadCount(int count) { m_threadCount = count; } // defaults to the core count
+
+    // results are in the same order as the files, failures don't stop the batch
+    QVector<BatchResult> run();
+
+private:
+    BatchResult process(QString path);
+
+    QStringList m_files;
+    QString m_outDir;
+    LoadMode m_mode;
+    int m_threadCount;
+
+    QMap<unsigned int, QString> m_nativeMap;
+};
+
+#endif // BATCH_H
@@ -1,12 +1,69 @@
 #include "compiler.h"
 
-#include <QMessageBox>
+#include <QDataStream>
 
 #include "../util/util.h"
 
 Compiler::Compiler(Script &script)
 {
     m_origScript = &script;
+    m_level = LZX_LEVEL_DEFAULT;
+    m_stackCheck = true;
+}
+
+void Compiler::setCompressionLevel(int level)
+{
+    m_level = level;
+}
+
+QByteArray Compiler::compileResource(ScriptType type, ErrorCode *error)
+{
+    ErrorCode compileError;
+    QByteArray code = compile(&compileError);
+
+    if (compileError != ErrorCode::ERR_NONE)
+    {
+        if (error != nullptr)
+            *error = compileError;
+
+        return QByteArray();
+    }
+
+    // the ps3 loads plain zlib streams, the 360 lzx with its own framing
+    QByteArray compressed = (type == ScriptType::TYPE_PS3) ? Util::zlibCompress(code, m_level) : Util::lzxCompress(code, m_level);
+
+    if (compressed.isEmpty())
+    {
+        if (error != nullptr)
+            *error = ErrorCode::ERR_COMPRESS_FAILED;
+
+        return QByteArray();
+    }
+
+    QByteArray script = Util::encrypt(compressed);
+
+    if (script.isEmpty())
+    {
+        if (error != nullptr)
+            *error = ErrorCode::ERR_NO_KEY;
+
+        return QByteArray();
+    }
+
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+
+    stream << (type == ScriptType::TYPE_PS3 ? 0x86435352 : 0x85435352); // csc / xsc header
+    stream << m_origScript->getResourceHeader().version;
+    stream << m_origScript->getResourceHeader().flags1;
+    stream << m_origScript->getResourceHeader().flags2;
+
+    script.prepend(header);
+
+    if (error != nullptr)
+        *error = ErrorCode::ERR_NONE;
+
+    return script;
 }
 
 int Compiler::roundUp(int value, int round)
@@ -20,7 +77,7 @@ int Compiler::roundDown(int value, int round)
     return (int)(value / round) * round;
 }
 
-QByteArray Compiler::compile()
+QByteArray Compiler::compile(ErrorCode *error)
 {
     copy();
     clean();
@@ -152,9 +209,43 @@ QByteArray Compiler::compile()
 
     writeHeader();
 
+    // an unbalanced stack only crashes the game much later, so don't hand out the script
+    if (m_stackCheck && !verifyStack())
+    {
+        if (error != nullptr)
+            *error = ErrorCode::ERR_STACK_UNBALANCED;
+
+        return QByteArray();
+    }
+
+    if (error != nullptr)
+        *error = ErrorCode::ERR_NONE;
+
     return m_result;
 }
 
+bool Compiler::verifyStack()
+{
+    std::vector<unsigned int> pageLocations(m_codePageOffsets.begin(), m_codePageOffsets.end());
+
+    m_instructions.setData(m_result);
+    m_instructions.buildAddressIndex(pageLocations);
+
+    StackVerifier verifier(m_instructions, pageLocations);
+
+    bool balanced = verifier.verify();
+
+    m_stackIssues.clear();
+
+    for (const StackIssue &issue : verifier.getIssues())
+    {
+        if (issue.kind != STACK_UNKNOWN)
+            m_stackIssues.append(verifier.issueToString(issue));
+    }
+
+    return balanced;
+}
+
 // copy known data from original script
 void Compiler::copy()
 {
@@ -173,21 +264,37 @@ void Compiler::clean()
 {
     int codeSize = 0;
 
-    for (auto op : m_origScript->getOpcodes())
+    const QVector<std::shared_ptr<IOpcode>> &opcodes = m_origScript->getOpcodes();
+    const std::map<unsigned int, std::shared_ptr<Op_HSub>> &jumps = m_origScript->getJumps();
+
+    const InstructionStream &instructions = m_origScript->getInstructions();
+    const std::vector<Label> &labels = instructions.getLabelIndex();
+
+    auto label = labels.begin();
+
+    for (int i = 0; i < opcodes.size(); i++)
     {
-        if (op->getOp() == EOpcodes::_SPACER || op->getDeleted())
+        auto op = opcodes[i];
+
+        // a label moves to wherever the next kept instruction ends up
+        if (label != labels.end() && label->index == i)
         {
-            continue;
-        }
+            auto sub = jumps.at(instructions.at(i).location);
 
-        op->setLocation(codeSize);
+            sub->setLocation(codeSize);
+            m_subs.append(sub);
+
+            ++label;
+        }
 
-        if (op->getOp() == EOpcodes::_SUB)
+        if (op->getDeleted())
         {
-            m_subs.append(std::dynamic_pointer_cast<Op_HSub>(op));
             continue;
         }
-        else if (op->getOp() == EOpcodes::OP_ENTER)
+
+        op->setLocation(codeSize);
+
+        if (op->getOp() == EOpcodes::OP_ENTER)
         {
             m_funcs.append(std::dynamic_pointer_cast<Op_Enter>(op));
         }
@@ -317,6 +424,7 @@ int Compiler::writeCode()
             }
 
             memcpy(m_result.data() + bytesWritten, op->getFullData().data(), opSize);
+            m_instructions.append(bytesWritten, op->getOp(), opSize - 1, page);
 
             bytesWritten += opSize;
             curOp++;
@@ -1,10 +1,12 @@
 #ifndef COMPILER_H
 #define COMPILER_H
 
+#include <QStringList>
 #include <QVector>
 
 #include "script.h"
 #include "iopcode.h"
+#include "stackverifier.h"
 #include "opcodes/enter.h"
 #include "opcodes/helper.h"
 
@@ -21,7 +23,17 @@ class Compiler
 public:
     Compiler(Script &script);
 
-    QByteArray compile();
+    // empty with ERR_STACK_UNBALANCED if the stack check finds errors in the compiled code
+    QByteArray compile(ErrorCode *error = nullptr);
+
+    // compiles and wraps the script in an encrypted, compressed RSC container
+    QByteArray compileResource(ScriptType type, ErrorCode *error = nullptr);
+
+    void setCompressionLevel(int level); // 1 to 9, zlib for ps3 and lzx for 360, 0 only stores
+    void setStackCheck(bool check) { m_stackCheck = check; } // on by default
+
+    // what the stack check found in the last compile, one line each
+    QStringList getStackIssues() const { return m_stackIssues; }
 
 private:
     int roundUp(int value, int round);
@@ -41,6 +53,8 @@ private:
     int writeNatives();
     int writeStatics();
 
+    bool verifyStack();
+
     QVector<std::shared_ptr<IOpcode>> m_code;
     QVector<int> m_codePageOffsets;
 
@@ -52,6 +66,12 @@ private:
 
     int m_pageCount;
 
+    int m_level;
+
+    bool m_stackCheck;
+    InstructionStream m_instructions; // the code as written, for the stack check
+    QStringList m_stackIssues;
+
     Script *m_origScript;
     ScriptHeader m_header;
 
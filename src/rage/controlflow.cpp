@@ -0,0 +1,549 @@
+#include "controlflow.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "../util/util.h"
+
+ControlFlowGraph::ControlFlowGraph(const ScriptView &script, int first, int last)
+    : m_first(first)
+    , m_last(last)
+{
+    findBlocks(script);
+    findDominators();
+    findPostDominators();
+    findLoops();
+}
+
+std::vector<std::pair<int, int>> ControlFlowGraph::getFunctionRanges(const ScriptView &script)
+{
+    std::vector<int> enters;
+
+    for (auto func : script.getFuncs())
+    {
+        enters.push_back(script.getInstructionByLocation(func.first));
+    }
+
+    std::sort(enters.begin(), enters.end());
+
+    // a function runs up to the next enter
+    std::vector<std::pair<int, int>> ranges;
+
+    for (size_t func = 0; func < enters.size(); func++)
+    {
+        ranges.push_back(std::make_pair(enters[func], (func + 1 < enters.size()) ? enters[func + 1] : script.getInstructions().size()));
+    }
+
+    return ranges;
+}
+
+std::vector<ControlFlowGraph> ControlFlowGraph::buildAll(const ScriptView &script, int threadCount)
+{
+    std::vector<std::pair<int, int>> ranges = getFunctionRanges(script);
+
+    int funcs = (int)ranges.size();
+
+    std::vector<std::unique_ptr<ControlFlowGraph>> built(funcs);
+
+    Util::parallelFor(funcs, threadCount, [&](int func)
+    {
+        built[func].reset(new ControlFlowGraph(script, ranges[func].first, ranges[func].second));
+    });
+
+    std::vector<ControlFlowGraph> graphs;
+    graphs.reserve(funcs);
+
+    for (auto &graph : built)
+    {
+        graphs.push_back(std::move(*graph));
+    }
+
+    return graphs;
+}
+
+IndexRange ControlFlowGraph::getSuccessors(int block) const
+{
+    return { m_succs.data() + m_succOffsets[block], m_succs.data() + m_succOffsets[block + 1] };
+}
+
+IndexRange ControlFlowGraph::getPredecessors(int block) const
+{
+    return { m_preds.data() + m_predOffsets[block], m_preds.data() + m_predOffsets[block + 1] };
+}
+
+int ControlFlowGraph::getBlockByInstruction(int index) const
+{
+    return (index >= m_first && index < m_last) ? m_blockOf[index - m_first] : -1;
+}
+
+bool ControlFlowGraph::dominates(int a, int b) const
+{
+    if (m_preorder[a] == -1 || m_preorder[b] == -1)
+        return false;
+
+    return m_preorder[a] <= m_preorder[b] && m_postorder[b] <= m_postorder[a];
+}
+
+void ControlFlowGraph::findBlocks(const ScriptView &script)
+{
+    const InstructionStream &instructions = script.getInstructions();
+
+    int count = m_last - m_first;
+
+    // instruction a location lands on, relative to the function, -1 if outside it
+    auto target = [&](unsigned int location)
+    {
+        int index = script.getInstructionByLocation(location);
+
+        return (index >= m_first && index < m_last) ? index - m_first : -1;
+    };
+
+    // a block starts at the entry, at every branch target and after every branch
+    std::vector<char> leader(count, 0);
+    std::vector<std::pair<int, int>> branches; // instruction, target, in instruction order
+
+    if (count > 0)
+        leader[0] = 1;
+
+    for (int i = 0; i < count; i++)
+    {
+        Instruction ins = instructions.at(m_first + i);
+        const OpcodeDesc &desc = ins.desc();
+
+        if (desc.operand == OPERAND_JUMP)
+        {
+            branches.push_back(std::make_pair(i, target(ins.jumpTarget())));
+        }
+        else if (desc.operand == OPERAND_SWITCH)
+        {
+            for (int c = 0; c < ins.switchCount(); c++)
+            {
+                branches.push_back(std::make_pair(i, target(ins.switchTarget(c))));
+            }
+        }
+
+        if ((desc.flags & (OPF_BRANCH | OPF_TERMINATOR)) && i + 1 < count)
+            leader[i + 1] = 1;
+    }
+
+    for (auto branch : branches)
+    {
+        if (branch.second != -1)
+            leader[branch.second] = 1;
+    }
+
+    m_blockOf.resize(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (leader[i])
+            m_blocks.push_back({ m_first + i, m_first + i, -1, -1, -1 });
+
+        m_blocks.back().last = m_first + i + 1;
+        m_blockOf[i] = (int)m_blocks.size() - 1;
+    }
+
+    // branches always end their block, so the targets come up block by block
+    auto branch = branches.begin();
+
+    m_succOffsets.push_back(0);
+
+    for (int block = 0; block < (int)m_blocks.size(); block++)
+    {
+        int end = m_blocks[block].last - m_first;
+
+        auto addEdge = [&](int to)
+        {
+            if (std::find(m_succs.begin() + m_succOffsets[block], m_succs.end(), to) == m_succs.end())
+                m_succs.push_back(to);
+        };
+
+        for (; branch != branches.end() && branch->first < end; ++branch)
+        {
+            if (branch->second != -1)
+                addEdge(m_blockOf[branch->second]);
+        }
+
+        if (!(instructions.at(m_first + end - 1).desc().flags & OPF_TERMINATOR) && block + 1 < (int)m_blocks.size())
+            addEdge(block + 1);
+
+        m_succOffsets.push_back((int)m_succs.size());
+    }
+
+    // predecessors come out ascending when filled block by block
+    m_predOffsets.assign(m_blocks.size() + 1, 0);
+
+    for (int to : m_succs)
+    {
+        m_predOffsets[to + 1]++;
+    }
+
+    for (size_t block = 1; block < m_predOffsets.size(); block++)
+    {
+        m_predOffsets[block] += m_predOffsets[block - 1];
+    }
+
+    std::vector<int> fill(m_predOffsets.begin(), m_predOffsets.end() - 1);
+
+    m_preds.resize(m_succs.size());
+
+    for (int block = 0; block < (int)m_blocks.size(); block++)
+    {
+        for (int to : getSuccessors(block))
+        {
+            m_preds[fill[to]++] = block;
+        }
+    }
+}
+
+// Lengauer-Tarjan with path compression, everything below works on depth
+// first numbers rather than block indices
+void ControlFlowGraph::findDominators()
+{
+    int blocks = (int)m_blocks.size();
+
+    m_preorder.assign(blocks, -1);
+    m_postorder.assign(blocks, -1);
+
+    if (blocks == 0)
+        return;
+
+    std::vector<int> number(blocks, -1);
+    std::vector<int> vertex;
+    std::vector<int> parent;
+    std::vector<std::pair<int, int>> stack; // block, next successor
+
+    number[0] = 0;
+    vertex.push_back(0);
+    parent.push_back(-1);
+    stack.push_back(std::make_pair(0, m_succOffsets[0]));
+
+    while (!stack.empty())
+    {
+        int block = stack.back().first;
+        int succ  = stack.back().second;
+
+        if (succ == m_succOffsets[block + 1])
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        stack.back().second++;
+
+        int to = m_succs[succ];
+
+        if (number[to] == -1)
+        {
+            number[to] = (int)vertex.size();
+            vertex.push_back(to);
+            parent.push_back(number[block]);
+            stack.push_back(std::make_pair(to, m_succOffsets[to]));
+        }
+    }
+
+    int count = (int)vertex.size();
+
+    std::vector<int> semi(count), idom(count, 0), label(count), ancestor(count, -1);
+    std::vector<int> bucketHead(count, -1), bucketNext(count, -1);
+    std::vector<int> path;
+
+    for (int v = 0; v < count; v++)
+    {
+        semi[v]  = v;
+        label[v] = v;
+    }
+
+    auto eval = [&](int v)
+    {
+        if (ancestor[v] == -1)
+            return v;
+
+        // compress the path to the forest root, nearest the root first
+        for (int x = v; ancestor[ancestor[x]] != -1; x = ancestor[x])
+        {
+            path.push_back(x);
+        }
+
+        while (!path.empty())
+        {
+            int x = path.back();
+            int a = ancestor[x];
+
+            path.pop_back();
+
+            if (semi[label[a]] < semi[label[x]])
+                label[x] = label[a];
+
+            ancestor[x] = ancestor[a];
+        }
+
+        return label[v];
+    };
+
+    for (int w = count - 1; w > 0; w--)
+    {
+        for (int pred : getPredecessors(vertex[w]))
+        {
+            if (number[pred] == -1)
+                continue;
+
+            int u = eval(number[pred]);
+
+            if (semi[u] < semi[w])
+                semi[w] = semi[u];
+        }
+
+        bucketNext[w] = bucketHead[semi[w]];
+        bucketHead[semi[w]] = w;
+
+        ancestor[w] = parent[w];
+
+        for (int v = bucketHead[parent[w]]; v != -1; v = bucketNext[v])
+        {
+            int u = eval(v);
+
+            idom[v] = (semi[u] < semi[v]) ? u : parent[w];
+        }
+
+        bucketHead[parent[w]] = -1;
+    }
+
+    for (int w = 1; w < count; w++)
+    {
+        if (idom[w] != semi[w])
+            idom[w] = idom[idom[w]];
+
+        m_blocks[vertex[w]].idom = vertex[idom[w]];
+    }
+
+    // number the dominator tree so dominance is an interval check
+    std::vector<int> childOffsets(blocks + 1, 0), children(count > 0 ? count - 1 : 0);
+
+    for (int w = 1; w < count; w++)
+    {
+        childOffsets[m_blocks[vertex[w]].idom + 1]++;
+    }
+
+    for (int block = 1; block <= blocks; block++)
+    {
+        childOffsets[block] += childOffsets[block - 1];
+    }
+
+    std::vector<int> fill(childOffsets.begin(), childOffsets.end() - 1);
+
+    for (int w = 1; w < count; w++)
+    {
+        children[fill[m_blocks[vertex[w]].idom]++] = vertex[w];
+    }
+
+    int pre = 0, post = 0;
+
+    stack.clear();
+    stack.push_back(std::make_pair(0, childOffsets[0]));
+    m_preorder[0] = pre++;
+
+    while (!stack.empty())
+    {
+        int block = stack.back().first;
+        int child = stack.back().second;
+
+        if (child == childOffsets[block + 1])
+        {
+            m_postorder[block] = post++;
+            stack.pop_back();
+            continue;
+        }
+
+        stack.back().second++;
+
+        int to = children[child];
+
+        m_preorder[to] = pre++;
+        stack.push_back(std::make_pair(to, childOffsets[to]));
+    }
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm on the reversed graph, with
+// a virtual exit block after every block that leaves the function
+void ControlFlowGraph::findPostDominators()
+{
+    int blocks = (int)m_blocks.size();
+    int exit = blocks;
+
+    std::vector<int> sinks;
+
+    for (int block = 0; block < blocks; block++)
+    {
+        if (isReachable(block) && getSuccessors(block).empty())
+            sinks.push_back(block);
+    }
+
+    auto preds = [&](int block) -> IndexRange
+    {
+        return (block == exit) ? IndexRange { sinks.data(), sinks.data() + sinks.size() } : getPredecessors(block);
+    };
+
+    // post order of the reversed graph from the exit
+    std::vector<int> number(blocks + 1, -1);
+    std::vector<int> order;
+    std::vector<char> seen(blocks + 1, 0);
+    std::vector<std::pair<int, int>> stack; // block, next predecessor
+
+    seen[exit] = 1;
+    stack.push_back(std::make_pair(exit, 0));
+
+    while (!stack.empty())
+    {
+        int block = stack.back().first;
+        IndexRange next = preds(block);
+
+        if (stack.back().second == next.size())
+        {
+            number[block] = (int)order.size();
+            order.push_back(block);
+            stack.pop_back();
+            continue;
+        }
+
+        int to = next.first[stack.back().second++];
+
+        if (!seen[to] && isReachable(to))
+        {
+            seen[to] = 1;
+            stack.push_back(std::make_pair(to, 0));
+        }
+    }
+
+    std::vector<int> ipdom(blocks + 1, -1);
+
+    auto intersect = [&](int a, int b)
+    {
+        while (a != b)
+        {
+            while (number[a] < number[b]) a = ipdom[a];
+            while (number[b] < number[a]) b = ipdom[b];
+        }
+
+        return a;
+    };
+
+    ipdom[exit] = exit;
+
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+
+        for (int i = (int)order.size() - 2; i >= 0; i--)
+        {
+            int block = order[i];
+            int next = -1;
+
+            IndexRange succs = getSuccessors(block);
+
+            if (succs.empty())
+                next = exit;
+
+            for (int succ : succs)
+            {
+                if (number[succ] == -1 || ipdom[succ] == -1)
+                    continue;
+
+                next = (next == -1) ? succ : intersect(succ, next);
+            }
+
+            if (next != ipdom[block])
+            {
+                ipdom[block] = next;
+                changed = true;
+            }
+        }
+    }
+
+    for (int block = 0; block < blocks; block++)
+    {
+        m_blocks[block].ipdom = (ipdom[block] == exit) ? -1 : ipdom[block];
+    }
+}
+
+void ControlFlowGraph::findLoops()
+{
+    int blocks = (int)m_blocks.size();
+
+    // an edge to a block that dominates its source closes a loop
+    std::vector<std::pair<int, int>> backEdges; // header, latch
+
+    for (int block = 0; block < blocks; block++)
+    {
+        for (int to : getSuccessors(block))
+        {
+            if (dominates(to, block))
+                backEdges.push_back(std::make_pair(to, block));
+        }
+    }
+
+    std::sort(backEdges.begin(), backEdges.end());
+
+    // walk back from the latches to the header, every back edge to a header makes one loop
+    std::vector<int> seen(blocks, -1);
+    std::vector<int> work;
+
+    for (size_t edge = 0; edge < backEdges.size();)
+    {
+        Loop loop;
+
+        loop.header = backEdges[edge].first;
+        loop.parent = -1;
+        loop.blocks.push_back(loop.header);
+
+        int id = (int)m_loops.size();
+
+        seen[loop.header] = id;
+
+        for (; edge < backEdges.size() && backEdges[edge].first == loop.header; edge++)
+        {
+            work.push_back(backEdges[edge].second);
+        }
+
+        while (!work.empty())
+        {
+            int block = work.back();
+            work.pop_back();
+
+            if (seen[block] == id || !isReachable(block))
+                continue;
+
+            seen[block] = id;
+            loop.blocks.push_back(block);
+
+            for (int pred : getPredecessors(block))
+            {
+                work.push_back(pred);
+            }
+        }
+
+        std::sort(loop.blocks.begin(), loop.blocks.end());
+
+        m_loops.push_back(std::move(loop));
+    }
+
+    // outer loops are bigger, so going from the biggest down leaves each block in its innermost loop
+    std::vector<int> order(m_loops.size());
+
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = (int)i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return m_loops[a].blocks.size() > m_loops[b].blocks.size(); });
+
+    for (int id : order)
+    {
+        m_loops[id].parent = m_blocks[m_loops[id].header].loop;
+
+        for (int block : m_loops[id].blocks)
+        {
+            m_blocks[block].loop = id;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef CONTROLFLOW_H
+#define CONTROLFLOW_H
+
+#include <vector>
+
+#include "scriptview.h"
+
+struct BasicBlock
+{
+    int first; // index of the first instruction
+    int last;  // one past the last instruction
+    int idom;  // immediate dominator, -1 for the entry block and unreachable blocks
+    int ipdom; // immediate post dominator, -1 when only leaving the function follows on every path, or no path leaves it
+    int loop;  // innermost loop the block belongs to, -1 if none
+};
+
+// A natural loop, the blocks that reach a back edge to the header without passing it
+struct Loop
+{
+    int header;
+    int parent;              // enclosing loop, -1 if outermost
+    std::vector<int> blocks; // ascending, header included
+};
+
+// Basic blocks of one function with their edges, dominator trees and loops.
+// Jumps and switch cases that land outside the function or between
+// instructions end their block but get no edge.
+class ControlFlowGraph
+{
+public:
+    // instructions [first, last) of the script, first being the function's enter
+    ControlFlowGraph(const ScriptView &script, int first, int last);
+
+    // one graph per function, in function order, built on threadCount threads (0 uses the core count)
+    static std::vector<ControlFlowGraph> buildAll(const ScriptView &script, int threadCount = 0);
+
+    // first and one past the last instruction of each function, in function order
+    static std::vector<std::pair<int, int>> getFunctionRanges(const ScriptView &script);
+
+    int getFirst() const { return m_first; }
+    int getLast() const  { return m_last;  }
+
+    const std::vector<BasicBlock> &getBlocks() const { return m_blocks; }
+    const std::vector<Loop>       &getLoops()  const { return m_loops;  }
+
+    IndexRange getSuccessors(int block) const;   // jump and case targets, then the fall through
+    IndexRange getPredecessors(int block) const; // ascending
+
+    int getBlockByInstruction(int index) const; // -1 outside the function
+
+    bool isReachable(int block) const { return m_preorder[block] != -1; }
+    bool dominates(int a, int b) const; // every path from the entry to b passes a, false if either is unreachable
+
+    int getEdgeCount() const { return (int)m_succs.size(); }
+
+private:
+    void findBlocks(const ScriptView &script);
+    void findDominators();
+    void findPostDominators();
+    void findLoops();
+
+    int m_first;
+    int m_last;
+
+    std::vector<BasicBlock> m_blocks;
+    std::vector<int> m_blockOf; // block of each instruction, relative to m_first
+
+    // edges as compressed rows, one more offset than blocks
+    std::vector<int> m_succOffsets;
+    std::vector<int> m_succs;
+    std::vector<int> m_predOffsets;
+    std::vector<int> m_preds;
+
+    // dominator tree numbering, -1 for unreachable blocks
+    std::vector<int> m_preorder;
+    std::vector<int> m_postorder;
+
+    std::vector<Loop> m_loops;
+};
+
+#endif // CONTROLFLOW_H
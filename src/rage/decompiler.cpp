@@ -0,0 +1,1396 @@
+#include "decompiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "instructionformatter.h"
+#include "iopcode.h"
+#include "../util/util.h"
+
+// bump whenever the output changes, so older cache entries are left alone
+static const char *CACHE_VERSION = "rdrasm-decompiler-1";
+
+// decompiled text by key, shared by every script opened in the process. Costs
+// are in characters, the least recently used text goes once they pass the cap.
+static const int CACHE_MAX_CHARS = 16 << 20; // 32 MB of text
+
+static QCache<QByteArray, QString> s_cache(CACHE_MAX_CHARS);
+
+// one file per function, so the directory is pruned to this, oldest files first
+static const qint64 CACHE_MAX_DISK_BYTES = 64 << 20;
+static std::mutex s_cacheMutex;
+
+static QString formatFloat(float value)
+{
+    QString text = QString::number(value, 'g', 9);
+
+    if (!text.contains(".") && !text.contains("e") && !text.contains("inf") && !text.contains("nan"))
+        text += ".0";
+
+    return text + "f";
+}
+
+// quoted with line breaks escaped, as in the listing
+static QString formatString(const Instruction &ins)
+{
+    TextBuffer &buffer = TextBuffer::scratch();
+    InstructionFormatter::writeString(buffer, ins.operand, ins.operandSize);
+    return buffer.toString();
+}
+
+namespace
+{
+
+// An expression on the lifted stack
+struct Value
+{
+    QString text;
+    bool atom;   // needs no parentheses as an operand
+    bool stable; // a literal or a name only assigned at block boundaries, so it can be moved past statements
+    bool call;   // has side effects, has to be evaluated exactly once
+};
+
+enum ETerm
+{
+    TERM_FALL,   // into next
+    TERM_JUMP,   // to taken
+    TERM_COND,   // to next when cond holds, otherwise to taken
+    TERM_SWITCH, // to the case blocks, next being the default
+    TERM_RETURN  // returns or throws
+};
+
+struct LiftedBlock
+{
+    QStringList stmts;
+    ETerm term;
+    QString cond;
+    QString negCond;
+    QString value; // switched on
+    int next;
+    int taken;
+    std::vector<std::pair<int, int>> cases; // value, block
+};
+
+}
+
+class Decompiler::FunctionWriter
+{
+public:
+    FunctionWriter(const Decompiler &decompiler, int func);
+
+    QString write();
+
+private:
+    struct Context
+    {
+        int follow;      // block the enclosing code goes on with, reaching it needs no statement
+        int loop;        // innermost loop being written, -1 if none
+        int loopHeader;  // reached by continue
+        int loopFollow;  // left to by break, unless a switch is in between
+        int breakFollow; // block break goes to in the innermost loop or switch
+    };
+
+    QString getSignature() const;
+
+    // lifting
+    bool liftBlock(int block);
+    bool liftInstruction(const Instruction &ins, LiftedBlock &lifted);
+    bool fail(const Instruction &ins, QString reason);
+
+    Value pop();
+    void push(QString text, bool atom = true, bool stable = false, bool call = false);
+    void pushLiteral(QString text) { push(text, true, true); }
+    void binary(const char *op);
+    void statement(QString text);
+    Value spill(const Value &value); // into a temporary
+    Value hoist(const Value &value); // into a temporary, after what is below it on the stack
+    void spillStack();
+
+    int getBlock(unsigned int location) const;
+    QString getFrameName(int slot) const;
+    QString deref(const Value &pointer) const;
+    QString member(const Value &pointer, int field) const;
+    QString element(const Value &pointer, const Value &index) const;
+    static QString operand(const Value &value) { return value.atom ? value.text : "(" + value.text + ")"; }
+
+    // structuring
+    bool isInLoop(int block, int loop) const;
+    bool isLoopHeader(int block) const;
+
+    void writeSequence(int block, const Context &ctx, int depth, bool enteringLoop = false);
+    int writeIf(int block, const Context &ctx, int depth);
+    int writeSwitch(int block, const Context &ctx, int depth);
+    int writeLoop(int block, const Context &ctx, int depth);
+    int getJoin(int block, const Context &ctx) const;
+    QString getJump(int block, const Context &ctx, bool mark); // statement leaving for the block, empty if it has to be written out
+    void line(int depth, QString text) { m_lines.push_back(QString(depth * 4, ' ') + text); }
+
+    const Decompiler &m_decompiler;
+    const ScriptView &m_script;
+    const Function &m_func;
+
+    ControlFlowGraph m_cfg;
+
+    std::vector<LiftedBlock> m_lifted;
+    std::vector<int> m_entryDepths;
+    std::vector<Value> m_stack;
+    QStringList *m_stmts;
+    int m_temps;
+    int m_slots; // s_ names used for values crossing blocks
+    QString m_error;
+
+    QStringList m_lines;
+    std::vector<int> m_blockLines;
+    std::vector<char> m_written;
+    std::vector<char> m_labelled;
+};
+
+Decompiler::FunctionWriter::FunctionWriter(const Decompiler &decompiler, int func)
+    : m_decompiler(decompiler)
+    , m_script(decompiler.m_script)
+    , m_func(decompiler.m_funcs[func])
+    , m_cfg(decompiler.m_script, m_func.first, m_func.last)
+    , m_stmts(nullptr)
+    , m_temps(0)
+    , m_slots(0)
+{
+}
+
+QString Decompiler::FunctionWriter::getSignature() const
+{
+    QStringList params;
+
+    for (int i = 0; i < m_func.params; i++)
+    {
+        params << QString("var param_%1").arg(i);
+    }
+
+    return QString("%1 %2(%3)").arg(m_func.results > 0 ? "var" : "void").arg(m_func.name).arg(params.join(", "));
+}
+
+QString Decompiler::FunctionWriter::write()
+{
+    const std::vector<BasicBlock> &blocks = m_cfg.getBlocks();
+
+    int count = (int)blocks.size();
+
+    m_lifted.resize(count);
+    m_entryDepths.assign(count, -1);
+
+    // reverse post order, so a block's stack is known from a predecessor before it is lifted
+    std::vector<int> order;
+    std::vector<char> seen(count, 0);
+    std::vector<std::pair<int, int>> stack; // block, next successor
+
+    if (count > 0)
+    {
+        seen[0] = 1;
+        stack.push_back(std::make_pair(0, 0));
+        m_entryDepths[0] = 0;
+    }
+
+    while (!stack.empty())
+    {
+        int block = stack.back().first;
+        IndexRange succs = m_cfg.getSuccessors(block);
+
+        if (stack.back().second == succs.size())
+        {
+            order.push_back(block);
+            stack.pop_back();
+            continue;
+        }
+
+        int to = succs.first[stack.back().second++];
+
+        if (!seen[to])
+        {
+            seen[to] = 1;
+            stack.push_back(std::make_pair(to, 0));
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+
+    bool lifted = true;
+
+    for (int block : order)
+    {
+        if (!liftBlock(block))
+        {
+            lifted = false;
+            break;
+        }
+    }
+
+    QString text = getSignature() + "\n{\n";
+
+    if (!lifted)
+        return text + "    // not decompiled, " + m_error + "\n}\n";
+
+    m_blockLines.assign(count, -1);
+    m_written.assign(count, 0);
+    m_labelled.assign(count, 0);
+
+    if (count > 0)
+        writeSequence(0, { -1, -1, -1, -1, -1 }, 1);
+
+    // labels go in front of the first line of their block, last first so the lines stay put
+    std::vector<std::pair<int, int>> labels;
+
+    for (int block = 0; block < count; block++)
+    {
+        if (m_labelled[block] && m_blockLines[block] != -1)
+            labels.push_back(std::make_pair(m_blockLines[block], block));
+    }
+
+    std::sort(labels.rbegin(), labels.rend());
+
+    for (auto label : labels)
+    {
+        m_lines.insert(label.first, QString("lbl_%1:").arg(label.second));
+    }
+
+    if (m_slots > 0)
+    {
+        QStringList names;
+
+        for (int i = 0; i < m_slots; i++)
+        {
+            names << QString("s_%1").arg(i);
+        }
+
+        text += "    var " + names.join(", ") + ";\n\n";
+    }
+
+    for (const QString &l : m_lines)
+    {
+        text += l + "\n";
+    }
+
+    return text + "}\n";
+}
+
+bool Decompiler::FunctionWriter::fail(const Instruction &ins, QString reason)
+{
+    m_error = reason + " at " + IOpcode::formatLocation(ins.page, ins.location);
+
+    return false;
+}
+
+Value Decompiler::FunctionWriter::pop()
+{
+    if (m_stack.empty())
+        return { QString(), true, true, false };
+
+    Value value = m_stack.back();
+    m_stack.pop_back();
+
+    return value;
+}
+
+void Decompiler::FunctionWriter::push(QString text, bool atom, bool stable, bool call)
+{
+    m_stack.push_back({ text, atom, stable, call });
+}
+
+void Decompiler::FunctionWriter::binary(const char *op)
+{
+    Value b = pop();
+    Value a = pop();
+
+    push(operand(a) + " " + op + " " + operand(b), false, a.stable && b.stable, a.call || b.call);
+}
+
+void Decompiler::FunctionWriter::statement(QString text)
+{
+    // whatever is left on the stack was evaluated before the statement
+    spillStack();
+
+    m_stmts->append(text);
+}
+
+Value Decompiler::FunctionWriter::spill(const Value &value)
+{
+    QString name = QString("t_%1").arg(m_temps++);
+
+    m_stmts->append(QString("var %1 = %2;").arg(name).arg(value.text));
+
+    return { name, true, true, false };
+}
+
+Value Decompiler::FunctionWriter::hoist(const Value &value)
+{
+    spillStack();
+
+    return spill(value);
+}
+
+void Decompiler::FunctionWriter::spillStack()
+{
+    for (Value &value : m_stack)
+    {
+        if (!value.stable)
+            value = spill(value);
+    }
+}
+
+int Decompiler::FunctionWriter::getBlock(unsigned int location) const
+{
+    return m_cfg.getBlockByInstruction(m_script.getInstructionByLocation(location));
+}
+
+QString Decompiler::FunctionWriter::getFrameName(int slot) const
+{
+    return (slot < m_func.params) ? QString("param_%1").arg(slot) : QString("local_%1").arg(slot);
+}
+
+QString Decompiler::FunctionWriter::deref(const Value &pointer) const
+{
+    if (pointer.text.startsWith("&"))
+        return pointer.text.mid(1);
+
+    return "*" + operand(pointer);
+}
+
+QString Decompiler::FunctionWriter::member(const Value &pointer, int field) const
+{
+    if (pointer.text.startsWith("&"))
+        return QString("%1.f_%2").arg(pointer.text.mid(1)).arg(field);
+
+    return QString("%1->f_%2").arg(operand(pointer)).arg(field);
+}
+
+QString Decompiler::FunctionWriter::element(const Value &pointer, const Value &index) const
+{
+    QString array = pointer.text.startsWith("&") ? pointer.text.mid(1) : "(*" + operand(pointer) + ")";
+
+    return array + "[" + index.text + "]";
+}
+
+bool Decompiler::FunctionWriter::liftBlock(int block)
+{
+    const BasicBlock &bb = m_cfg.getBlocks()[block];
+    LiftedBlock &lifted = m_lifted[block];
+
+    m_stack.clear();
+    m_stmts = &lifted.stmts;
+
+    for (int i = 0; i < m_entryDepths[block]; i++)
+    {
+        pushLiteral(QString("s_%1").arg(i));
+    }
+
+    lifted.term  = TERM_FALL;
+    lifted.next  = -1;
+    lifted.taken = -1;
+
+    for (int i = bb.first; i < bb.last; i++)
+    {
+        if (!liftInstruction(m_script.getInstructions().at(i), lifted))
+            return false;
+    }
+
+    Instruction last = m_script.getInstructions().at(bb.last - 1);
+
+    if (lifted.term == TERM_RETURN)
+        return true;
+
+    if (!(last.desc().flags & OPF_TERMINATOR))
+    {
+        if (block + 1 >= (int)m_cfg.getBlocks().size())
+            return fail(last, "runs off the end of the function");
+
+        lifted.next = block + 1;
+    }
+
+    // values left for the next block go to its s_ names, the condition is taken first so it can't see them change
+    bool assigns = false;
+
+    for (int i = 0; i < (int)m_stack.size(); i++)
+    {
+        assigns |= m_stack[i].text != QString("s_%1").arg(i);
+    }
+
+    if (assigns)
+    {
+        if (lifted.term == TERM_COND && lifted.cond.contains("s_"))
+        {
+            Value cond = hoist({ lifted.cond, false, false, false });
+
+            lifted.cond    = cond.text;
+            lifted.negCond = "!" + cond.text;
+        }
+        else if (lifted.term == TERM_SWITCH && lifted.value.contains("s_"))
+        {
+            lifted.value = hoist({ lifted.value, false, false, false }).text;
+        }
+
+        for (int i = 0; i < (int)m_stack.size(); i++)
+        {
+            if (m_stack[i].text.contains("s_") && m_stack[i].text != QString("s_%1").arg(i))
+                m_stack[i] = spill(m_stack[i]);
+        }
+
+        for (int i = 0; i < (int)m_stack.size(); i++)
+        {
+            if (m_stack[i].text != QString("s_%1").arg(i))
+                m_stmts->append(QString("s_%1 = %2;").arg(i).arg(m_stack[i].text));
+        }
+
+        m_slots = std::max(m_slots, (int)m_stack.size());
+    }
+
+    for (int to : m_cfg.getSuccessors(block))
+    {
+        if (m_entryDepths[to] == -1)
+            m_entryDepths[to] = (int)m_stack.size();
+        else if (m_entryDepths[to] != (int)m_stack.size())
+            return fail(last, "paths leave different stack depths");
+    }
+
+    return true;
+}
+
+bool Decompiler::FunctionWriter::liftInstruction(const Instruction &ins, LiftedBlock &lifted)
+{
+    if (ins.op >= OPCODE_COUNT)
+        return fail(ins, "unknown opcode");
+
+    const OpcodeDesc &desc = ins.desc();
+
+    if (desc.pops >= 0 && desc.pops > (int)m_stack.size())
+        return fail(ins, "stack underflow");
+
+    switch (ins.op)
+    {
+    case EOpcodes::OP_NOP:
+    case EOpcodes::OP_ENTER:
+        break;
+
+    case EOpcodes::OP_IADD: case EOpcodes::OP_FADD: binary("+");  break;
+    case EOpcodes::OP_ISUB: case EOpcodes::OP_FSUB: binary("-");  break;
+    case EOpcodes::OP_IMUL: case EOpcodes::OP_FMUL: binary("*");  break;
+    case EOpcodes::OP_IDIV: case EOpcodes::OP_FDIV: binary("/");  break;
+    case EOpcodes::OP_IMOD: case EOpcodes::OP_FMOD: binary("%");  break;
+
+    case EOpcodes::OP_ICMPEQ: case EOpcodes::OP_FCMPEQ: binary("=="); break;
+    case EOpcodes::OP_ICMPNE: case EOpcodes::OP_FCMPNE: binary("!="); break;
+    case EOpcodes::OP_ICMPGT: case EOpcodes::OP_FCMPGT: binary(">");  break;
+    case EOpcodes::OP_ICMPGE: case EOpcodes::OP_FCMPGE: binary(">="); break;
+    case EOpcodes::OP_ICMPLT: case EOpcodes::OP_FCMPLT: binary("<");  break;
+    case EOpcodes::OP_ICMPLE: case EOpcodes::OP_FCMPLE: binary("<="); break;
+
+    case EOpcodes::OP_IBITWISE_AND: binary("&"); break;
+    case EOpcodes::OP_IBITWISE_OR:  binary("|"); break;
+    case EOpcodes::OP_IBITWISE_XOR: binary("^"); break;
+
+    case EOpcodes::OP_INOT:
+    case EOpcodes::OP_INEG:
+    case EOpcodes::OP_FNEG:
+    case EOpcodes::OP_ITOF:
+    case EOpcodes::OP_FTOI:
+    {
+        const char *prefix = (ins.op == EOpcodes::OP_INOT) ? "!"
+                           : (ins.op == EOpcodes::OP_ITOF) ? "(float)"
+                           : (ins.op == EOpcodes::OP_FTOI) ? "(int)" : "-";
+        Value a = pop();
+
+        push(prefix + operand(a), true, a.stable, a.call);
+        break;
+    }
+
+    case EOpcodes::OP_VADD:
+    case EOpcodes::OP_VSUB:
+    case EOpcodes::OP_VMUL:
+    case EOpcodes::OP_VDIV:
+    {
+        // component by component, x deepest
+        static const char *ops[] = { "+", "-", "*", "/" };
+        Value b[3], a[3];
+
+        for (int i = 2; i >= 0; i--) b[i] = pop();
+        for (int i = 2; i >= 0; i--) a[i] = pop();
+
+        for (int i = 0; i < 3; i++)
+        {
+            m_stack.push_back(a[i]);
+            m_stack.push_back(b[i]);
+            binary(ops[ins.op - EOpcodes::OP_VADD]);
+        }
+        break;
+    }
+
+    case EOpcodes::OP_VNEG:
+    {
+        Value a[3];
+
+        for (int i = 2; i >= 0; i--) a[i] = pop();
+
+        for (int i = 0; i < 3; i++)
+        {
+            push("-" + operand(a[i]), true, a[i].stable, a[i].call);
+        }
+        break;
+    }
+
+    case EOpcodes::OP_DUP:
+    case EOpcodes::OP_DUP2:
+    {
+        Value a = pop();
+
+        if (!a.stable)
+            a = hoist(a);
+
+        for (int i = 0; i < desc.pushes; i++)
+        {
+            m_stack.push_back(a);
+        }
+        break;
+    }
+
+    case EOpcodes::OP_DROP:
+    {
+        Value a = pop();
+
+        if (a.call)
+            statement(a.text + ";");
+        break;
+    }
+
+    case EOpcodes::OP_PUSH1B: pushLiteral(QString::number(ins.u8(0)));                                                  break;
+    case EOpcodes::OP_PUSH2B: pushLiteral(QString::number(ins.u8(0))); pushLiteral(QString::number(ins.u8(1)));         break;
+    case EOpcodes::OP_PUSH3B:
+        for (int i = 0; i < 3; i++)
+        {
+            pushLiteral(QString::number(ins.u8(i)));
+        }
+        break;
+    case EOpcodes::OP_IPUSH:  pushLiteral(QString::number(ins.u32(0)));                                                 break;
+    case EOpcodes::OP_IPUSH2: pushLiteral(QString::number(ins.u16(0)));                                                 break;
+    case EOpcodes::OP_IPUSH3: pushLiteral(QString::number((ins.u16(0) << 8) | ins.u8(2)));                              break;
+    case EOpcodes::OP_FPUSH:
+    {
+        unsigned int bits = (unsigned int)ins.u32(0);
+        float value;
+
+        memcpy(&value, &bits, sizeof(value));
+        pushLiteral(formatFloat(value));
+        break;
+    }
+
+    case EOpcodes::OP_SPUSH:  pushLiteral(formatString(ins)); break;
+    case EOpcodes::OP_SPUSH0: pushLiteral("\"\"");            break;
+
+    case EOpcodes::OP_NATIVE:
+    {
+        int argCount = (ins.u8(0) & 0x3e) >> 1;
+
+        if (argCount > (int)m_stack.size())
+            return fail(ins, "stack underflow");
+
+        QStringList args;
+
+        for (int i = 0; i < argCount; i++)
+        {
+            args.prepend(pop().text);
+        }
+
+        QString call = m_decompiler.getNativeName(ins) + "(" + args.join(", ") + ")";
+
+        if (ins.u8(0) & 1)
+            push(call, true, false, true);
+        else
+            statement(call + ";");
+        break;
+    }
+
+    case EOpcodes::OP_PGET:
+    {
+        Value p = pop();
+
+        push(deref(p), true, false, p.call);
+        break;
+    }
+
+    case EOpcodes::OP_PSET:
+    {
+        Value p = pop();
+        Value v = pop();
+
+        statement(deref(p) + " = " + v.text + ";");
+        break;
+    }
+
+    case EOpcodes::OP_PPEEKSET:
+    {
+        Value v = pop();
+        Value p = pop();
+
+        if (!p.stable)
+            p = hoist(p);
+
+        statement(deref(p) + " = " + v.text + ";");
+        m_stack.push_back(p);
+        break;
+    }
+
+    case EOpcodes::OP_TOSTACK:
+    case EOpcodes::OP_FROMSTACK:
+    {
+        // pointer on top, the slot count below it
+        if (m_stack.size() < 2)
+            return fail(ins, "stack underflow");
+
+        Value p = pop();
+        bool literal;
+        int count = pop().text.toInt(&literal);
+
+        if (!literal || count < 0)
+            return fail(ins, "slot count isn't a constant");
+
+        if (ins.op == EOpcodes::OP_TOSTACK)
+        {
+            if (!p.stable)
+                p = hoist(p);
+
+            for (int i = 0; i < count; i++)
+            {
+                push(count == 1 ? deref(p) : member(p, i));
+            }
+            break;
+        }
+
+        if (count > (int)m_stack.size())
+            return fail(ins, "stack underflow");
+
+        std::vector<Value> values(count);
+
+        for (int i = count - 1; i >= 0; i--)
+        {
+            values[i] = pop();
+        }
+
+        if (!p.stable && count > 1)
+            p = hoist(p);
+
+        for (int i = 0; i < count; i++)
+        {
+            statement((count == 1 ? deref(p) : member(p, i)) + " = " + values[i].text + ";");
+        }
+        break;
+    }
+
+    case EOpcodes::OP_PARRAY:
+    case EOpcodes::OP_ARRAYGETP2:
+    case EOpcodes::OP_AGET:
+    case EOpcodes::OP_ARRAYGET2:
+    {
+        // array pointer on top, the index below it
+        Value p = pop();
+        Value i = pop();
+        bool address = ins.op == EOpcodes::OP_PARRAY || ins.op == EOpcodes::OP_ARRAYGETP2;
+
+        push((address ? "&" : "") + element(p, i), true, false, p.call || i.call);
+        break;
+    }
+
+    case EOpcodes::OP_ASET:
+    case EOpcodes::OP_ARRAYSET2:
+    {
+        Value p = pop();
+        Value i = pop();
+        Value v = pop();
+
+        statement(element(p, i) + " = " + v.text + ";");
+        break;
+    }
+
+    case EOpcodes::OP_PFRAME1:   push("&" + getFrameName(ins.u8(0)),  true, true); break;
+    case EOpcodes::OP_PFRAME2:   push("&" + getFrameName(ins.u16(0)), true, true); break;
+    case EOpcodes::OP_GETF:      push(getFrameName(ins.u8(0)));                    break;
+    case EOpcodes::OP_FRAMEGET2: push(getFrameName(ins.u16(0)));                   break;
+    case EOpcodes::OP_SETF:      statement(getFrameName(ins.u8(0))  + " = " + pop().text + ";"); break;
+    case EOpcodes::OP_FRAMESET2: statement(getFrameName(ins.u16(0)) + " = " + pop().text + ";"); break;
+
+    case EOpcodes::OP_PSTATIC2:   push(QString("&static_%1").arg(ins.u16(0)), true, true); break;
+    case EOpcodes::OP_STATICGET2: push(QString("static_%1").arg(ins.u16(0)));              break;
+    case EOpcodes::OP_STATICSET2: statement(QString("static_%1 = %2;").arg(ins.u16(0)).arg(pop().text)); break;
+
+    case EOpcodes::OP_PGLOBAL2:   push(QString("&global_%1").arg(ins.u16(0)), true, true); break;
+    case EOpcodes::OP_GLOBALGET2: push(QString("global_%1").arg(ins.u16(0)));              break;
+    case EOpcodes::OP_GLOBALSET2: statement(QString("global_%1 = %2;").arg(ins.u16(0)).arg(pop().text)); break;
+
+    case EOpcodes::OP_PGLOBAL3:   push(QString("&global_%1").arg((ins.u16(0) << 8) | ins.u8(2)), true, true); break;
+    case EOpcodes::OP_GLOBALGET3: push(QString("global_%1").arg((ins.u16(0) << 8) | ins.u8(2)));              break;
+    case EOpcodes::OP_GLOBALSET3: statement(QString("global_%1 = %2;").arg((ins.u16(0) << 8) | ins.u8(2)).arg(pop().text)); break;
+
+    case EOpcodes::OP_IADDIMM1: { Value a = pop(); push(operand(a) + " + " + QString::number(ins.u8(0)),  false, a.stable, a.call); break; }
+    case EOpcodes::OP_IADDIMM2: { Value a = pop(); push(operand(a) + " + " + QString::number(ins.u16(0)), false, a.stable, a.call); break; }
+    case EOpcodes::OP_IMULIMM1: { Value a = pop(); push(operand(a) + " * " + QString::number(ins.u8(0)),  false, a.stable, a.call); break; }
+    case EOpcodes::OP_IMULIMM2: { Value a = pop(); push(operand(a) + " * " + QString::number(ins.u16(0)), false, a.stable, a.call); break; }
+
+    case EOpcodes::OP_PGETIMM1: { Value p = pop(); push(member(p, ins.u8(0)),  true, false, p.call); break; }
+    case EOpcodes::OP_PGETIMM2: { Value p = pop(); push(member(p, ins.u16(0)), true, false, p.call); break; }
+    case EOpcodes::OP_PSETIMM1:
+    case EOpcodes::OP_PSETIMM2:
+    {
+        Value p = pop();
+        Value v = pop();
+
+        statement(member(p, ins.op == EOpcodes::OP_PSETIMM1 ? ins.u8(0) : ins.u16(0)) + " = " + v.text + ";");
+        break;
+    }
+
+    case EOpcodes::OP_JMP:
+        lifted.term  = TERM_JUMP;
+        lifted.taken = getBlock(ins.jumpTarget());
+        break;
+
+    case EOpcodes::OP_JMPF:
+    {
+        Value c = pop();
+
+        lifted.term    = TERM_COND;
+        lifted.taken   = getBlock(ins.jumpTarget());
+        lifted.cond    = c.text;
+        lifted.negCond = "!" + operand(c);
+        break;
+    }
+
+    case EOpcodes::OP_JMPNE:
+    case EOpcodes::OP_JMPEQ:
+    case EOpcodes::OP_JMPLE:
+    case EOpcodes::OP_JMPLT:
+    case EOpcodes::OP_JMPGE:
+    case EOpcodes::OP_JMPGT:
+    {
+        // jumps when the comparison holds, falls through on its inverse
+        static const char *taken[]   = { "!=", "==", "<=", "<",  ">=", ">"  };
+        static const char *falling[] = { "==", "!=", ">",  ">=", "<",  "<=" };
+
+        Value b = pop();
+        Value a = pop();
+        int op = ins.op - EOpcodes::OP_JMPNE;
+
+        lifted.term    = TERM_COND;
+        lifted.taken   = getBlock(ins.jumpTarget());
+        lifted.cond    = operand(a) + " " + falling[op] + " " + operand(b);
+        lifted.negCond = operand(a) + " " + taken[op] + " " + operand(b);
+        break;
+    }
+
+    case EOpcodes::OP_SWITCHR2:
+        lifted.term  = TERM_SWITCH;
+        lifted.value = pop().text;
+
+        for (int c = 0; c < ins.switchCount(); c++)
+        {
+            int target = getBlock(ins.switchTarget(c));
+
+            if (target == -1)
+                return fail(ins, "case outside the function");
+
+            lifted.cases.push_back(std::make_pair(ins.switchValue(c), target));
+        }
+        break;
+
+    case EOpcodes::OP_THROW:
+        statement("throw " + pop().text + ";");
+        lifted.term = TERM_RETURN;
+        break;
+
+    case EOpcodes::OP_CATCH:
+        push("catch()", true, false, true);
+        break;
+
+    case EOpcodes::OP_CALL2:  case EOpcodes::OP_CALL2H1: case EOpcodes::OP_CALL2H2: case EOpcodes::OP_CALL2H3:
+    case EOpcodes::OP_CALL2H4: case EOpcodes::OP_CALL2H5: case EOpcodes::OP_CALL2H6: case EOpcodes::OP_CALL2H7:
+    case EOpcodes::OP_CALL2H8: case EOpcodes::OP_CALL2H9: case EOpcodes::OP_CALL2HA: case EOpcodes::OP_CALL2HB:
+    case EOpcodes::OP_CALL2HC: case EOpcodes::OP_CALL2HD: case EOpcodes::OP_CALL2HE: case EOpcodes::OP_CALL2HF:
+    {
+        int target = m_script.getCallTarget(ins);
+        int callee = (target == -1) ? -1 : m_decompiler.getFunctionByInstruction(m_script.getInstructionByLocation(target));
+
+        if (callee == -1)
+            return fail(ins, "call to an invalid target");
+
+        const Function &func = m_decompiler.m_funcs[callee];
+
+        if (func.params > (int)m_stack.size())
+            return fail(ins, "stack underflow");
+
+        QStringList args;
+
+        for (int i = 0; i < func.params; i++)
+        {
+            args.prepend(pop().text);
+        }
+
+        QString call = func.name + "(" + args.join(", ") + ")";
+
+        if (func.results == 0)
+        {
+            statement(call + ";");
+        }
+        else if (func.results == 1)
+        {
+            push(call, true, false, true);
+        }
+        else
+        {
+            Value result = hoist({ call, true, false, true });
+
+            for (int i = 0; i < func.results; i++)
+            {
+                pushLiteral(QString("%1.f_%2").arg(result.text).arg(i));
+            }
+        }
+        break;
+    }
+
+    default:
+    {
+        if (desc.flags & OPF_RETURN)
+        {
+            int results = (desc.operand == OPERAND_RET) ? ins.u8(1) : desc.pops;
+
+            if (results > (int)m_stack.size())
+                return fail(ins, "stack underflow");
+
+            QStringList values;
+
+            for (int i = 0; i < results; i++)
+            {
+                values.prepend(pop().text);
+            }
+
+            if (results == 0)
+                statement("return;");
+            else if (results == 1)
+                statement("return " + values[0] + ";");
+            else
+                statement("return { " + values.join(", ") + " };");
+
+            lifted.term = TERM_RETURN;
+            break;
+        }
+
+        if (ins.op >= EOpcodes::OP_PUSHNEG1 && ins.op <= EOpcodes::OP_PUSH7)
+        {
+            pushLiteral(QString::number(ins.op - EOpcodes::OP_PUSH0));
+            break;
+        }
+
+        if (ins.op >= EOpcodes::OP_FPUSHN1 && ins.op <= EOpcodes::OP_FPUSH7)
+        {
+            pushLiteral(formatFloat(ins.op - EOpcodes::OP_FPUSH0));
+            break;
+        }
+
+        // anything else is written as a call named after the opcode, immediates first
+        if (desc.pops == -1 || desc.pushes > 1)
+            return fail(ins, QString("%1 can't be lifted").arg(desc.name));
+
+        QStringList args;
+
+        switch (desc.operand)
+        {
+        case OPERAND_IMM8:  args << QString::number(ins.u8(0));                     break;
+        case OPERAND_IMM16: args << QString::number(ins.u16(0));                    break;
+        case OPERAND_IMM24: args << QString::number((ins.u16(0) << 8) | ins.u8(2)); break;
+        case OPERAND_IMM32: args << QString::number(ins.u32(0));                    break;
+        default: break;
+        }
+
+        QStringList popped;
+
+        for (int i = 0; i < desc.pops; i++)
+        {
+            popped.prepend(pop().text);
+        }
+
+        QString call = QString(desc.name) + "(" + (args + popped).join(", ") + ")";
+
+        if (desc.pushes == 1)
+            push(call, true, false, true);
+        else
+            statement(call + ";");
+        break;
+    }
+    }
+
+    if ((lifted.term == TERM_JUMP || lifted.term == TERM_COND) && lifted.taken == -1)
+        return fail(ins, "branch outside the function");
+
+    return true;
+}
+
+bool Decompiler::FunctionWriter::isInLoop(int block, int loop) const
+{
+    for (int l = m_cfg.getBlocks()[block].loop; l != -1; l = m_cfg.getLoops()[l].parent)
+    {
+        if (l == loop)
+            return true;
+    }
+
+    return false;
+}
+
+bool Decompiler::FunctionWriter::isLoopHeader(int block) const
+{
+    int loop = m_cfg.getBlocks()[block].loop;
+
+    return loop != -1 && m_cfg.getLoops()[loop].header == block;
+}
+
+QString Decompiler::FunctionWriter::getJump(int block, const Context &ctx, bool mark)
+{
+    if (block == ctx.loopHeader)
+        return "continue;";
+
+    if (block == ctx.breakFollow)
+        return "break;";
+
+    if (block == ctx.loopFollow || m_written[block])
+    {
+        if (mark)
+            m_labelled[block] = 1;
+
+        return QString("goto lbl_%1;").arg(block);
+    }
+
+    return QString();
+}
+
+int Decompiler::FunctionWriter::getJoin(int block, const Context &ctx) const
+{
+    int join = m_cfg.getBlocks()[block].ipdom;
+
+    if (join == -1)
+        return -1;
+
+    // leaving the loop is left to break and goto
+    if (ctx.loop != -1 && !isInLoop(join, ctx.loop))
+        return -1;
+
+    return join;
+}
+
+void Decompiler::FunctionWriter::writeSequence(int block, const Context &ctx, int depth, bool enteringLoop)
+{
+    while (block != -1)
+    {
+        if (!enteringLoop)
+        {
+            if (block == ctx.follow)
+                return;
+
+            QString jump = getJump(block, ctx, true);
+
+            if (!jump.isEmpty())
+            {
+                line(depth, jump);
+                return;
+            }
+
+            if (isLoopHeader(block))
+            {
+                block = writeLoop(block, ctx, depth);
+                continue;
+            }
+        }
+
+        enteringLoop = false;
+
+        m_written[block] = 1;
+
+        if (m_blockLines[block] == -1)
+            m_blockLines[block] = m_lines.size();
+
+        const LiftedBlock &lifted = m_lifted[block];
+
+        for (const QString &stmt : lifted.stmts)
+        {
+            line(depth, stmt);
+        }
+
+        switch (lifted.term)
+        {
+        case TERM_FALL:   block = lifted.next;                    break;
+        case TERM_JUMP:   block = lifted.taken;                   break;
+        case TERM_COND:   block = writeIf(block, ctx, depth);     break;
+        case TERM_SWITCH: block = writeSwitch(block, ctx, depth); break;
+        case TERM_RETURN: return;
+        }
+    }
+}
+
+int Decompiler::FunctionWriter::writeIf(int block, const Context &ctx, int depth)
+{
+    const LiftedBlock &lifted = m_lifted[block];
+
+    int join = getJoin(block, ctx);
+
+    Context arms = ctx;
+    arms.follow = (join != -1) ? join : ctx.follow;
+
+    int then = lifted.next;
+    int other = lifted.taken;
+
+    // an arm that only leaves becomes a guard, and the other arm goes on in line
+    if (then != arms.follow && other != arms.follow)
+    {
+        if (!getJump(other, ctx, false).isEmpty() && getJump(then, ctx, false).isEmpty())
+        {
+            line(depth, "if (" + lifted.negCond + ") {");
+            line(depth + 1, getJump(other, ctx, true));
+            line(depth, "}");
+
+            return then;
+        }
+
+        if (!getJump(then, ctx, false).isEmpty() && getJump(other, ctx, false).isEmpty())
+        {
+            line(depth, "if (" + lifted.cond + ") {");
+            line(depth + 1, getJump(then, ctx, true));
+            line(depth, "}");
+
+            return other;
+        }
+    }
+
+    if (then == arms.follow)
+    {
+        std::swap(then, other);
+        line(depth, "if (" + lifted.negCond + ") {");
+    }
+    else
+    {
+        line(depth, "if (" + lifted.cond + ") {");
+    }
+
+    writeSequence(then, arms, depth + 1);
+
+    if (other != arms.follow)
+    {
+        line(depth, "} else {");
+        writeSequence(other, arms, depth + 1);
+    }
+
+    line(depth, "}");
+
+    return join;
+}
+
+int Decompiler::FunctionWriter::writeSwitch(int block, const Context &ctx, int depth)
+{
+    const LiftedBlock &lifted = m_lifted[block];
+
+    int join = getJoin(block, ctx);
+
+    // the end of a case has to break out, it mustn't run into the next one
+    Context cases = ctx;
+    cases.follow = -1;
+    cases.breakFollow = join;
+
+    std::map<int, std::vector<int>> targets; // block, values, in block order
+    std::vector<int> values;
+
+    // the first case with a value wins, as in the vm
+    for (auto c : lifted.cases)
+    {
+        if (std::find(values.begin(), values.end(), c.first) != values.end())
+            continue;
+
+        values.push_back(c.first);
+        targets[c.second].push_back(c.first);
+    }
+
+    line(depth, "switch (" + lifted.value + ") {");
+
+    bool wroteDefault = false;
+
+    for (auto &target : targets)
+    {
+        for (int value : target.second)
+        {
+            line(depth + 1, QString("case %1:").arg(value));
+        }
+
+        if (target.first == lifted.next)
+        {
+            line(depth + 1, "default:");
+            wroteDefault = true;
+        }
+
+        if (target.first == join)
+            line(depth + 2, "break;");
+        else
+            writeSequence(target.first, cases, depth + 2);
+    }
+
+    if (!wroteDefault && lifted.next != join && lifted.next != -1)
+    {
+        line(depth + 1, "default:");
+        writeSequence(lifted.next, cases, depth + 2);
+    }
+
+    line(depth, "}");
+
+    return join;
+}
+
+int Decompiler::FunctionWriter::writeLoop(int block, const Context &ctx, int depth)
+{
+    int loop = m_cfg.getBlocks()[block].loop;
+    const std::vector<int> &blocks = m_cfg.getLoops()[loop].blocks;
+
+    // the loop goes on after the header's exit, or the first block it leaves to
+    int follow = -1;
+
+    for (int succ : m_cfg.getSuccessors(block))
+    {
+        if (!isInLoop(succ, loop))
+            follow = succ;
+    }
+
+    for (int b = 0; follow == -1 && b < (int)blocks.size(); b++)
+    {
+        for (int succ : m_cfg.getSuccessors(blocks[b]))
+        {
+            if (!isInLoop(succ, loop) && (follow == -1 || succ < follow))
+                follow = succ;
+        }
+    }
+
+    Context body = { block, loop, block, follow, follow };
+
+    m_written[block] = 1;
+    m_blockLines[block] = m_lines.size();
+
+    const LiftedBlock &header = m_lifted[block];
+
+    // a header that only tests the condition becomes the loop's own
+    if (header.term == TERM_COND && header.stmts.isEmpty() && follow != -1 && (header.next == follow) != (header.taken == follow))
+    {
+        bool staysOnCond = header.taken == follow;
+
+        line(depth, "while (" + (staysOnCond ? header.cond : header.negCond) + ") {");
+        writeSequence(staysOnCond ? header.next : header.taken, body, depth + 1);
+    }
+    else
+    {
+        line(depth, "while (true) {");
+        writeSequence(block, body, depth + 1, true);
+    }
+
+    line(depth, "}");
+
+    return follow;
+}
+
+Decompiler::Decompiler(ScriptView script, QMap<unsigned int, QString> nativeMap)
+    : m_script(script)
+    , m_nativeMap(nativeMap)
+    , m_threadCount(0)
+    , m_cachePath(getDefaultCachePath())
+    , m_useCache(true)
+    , m_cacheHits(0)
+{
+    const InstructionStream &instructions = m_script.getInstructions();
+
+    for (auto range : ControlFlowGraph::getFunctionRanges(m_script))
+    {
+        Instruction enter = instructions.at(range.first);
+        Function func = { range.first, range.second, m_script.getFuncs().at(enter.location), enter.u8(0), 0 };
+
+        for (int i = range.first; i < range.second; i++)
+        {
+            Instruction ins = instructions.at(i);
+
+            if (ins.op < OPCODE_COUNT && (ins.desc().flags & OPF_RETURN))
+            {
+                func.results = (ins.desc().operand == OPERAND_RET) ? ins.u8(1) : ins.desc().pops;
+                break;
+            }
+        }
+
+        m_funcs.push_back(func);
+    }
+
+    m_text.resize(m_funcs.size());
+}
+
+QString Decompiler::getDefaultCachePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/decompiled";
+}
+
+int Decompiler::getFunctionByInstruction(int index) const
+{
+    auto func = std::lower_bound(m_funcs.begin(), m_funcs.end(), index, [](const Function &f, int i) { return f.first < i; });
+
+    return (func != m_funcs.end() && func->first == index) ? (int)(func - m_funcs.begin()) : -1;
+}
+
+QString Decompiler::getNativeName(const Instruction &ins) const
+{
+    int native = ((ins.u8(0) << 2) & 0x300) | ins.u8(1);
+
+    return Util::getNative(m_script.getNatives().value(native), m_nativeMap);
+}
+
+QByteArray Decompiler::getKey(int func) const
+{
+    const Function &f = m_funcs[func];
+    const InstructionStream &instructions = m_script.getInstructions();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    hash.addData(QByteArray(CACHE_VERSION));
+    hash.addData(f.name.toUtf8());
+
+    unsigned int start = instructions.at(f.first).location;
+
+    for (int i = f.first; i < f.last; i++)
+    {
+        Instruction ins = instructions.at(i);
+
+        // where it sits relative to the enter decides which instruction a branch lands on
+        unsigned int offset = ins.location - start;
+
+        hash.addData((const char*)&offset, sizeof(offset));
+        hash.addData((const char*)&ins.op, 1);
+        hash.addData((const char*)ins.operand, ins.operandSize);
+
+        if (ins.op >= OPCODE_COUNT)
+            continue;
+
+        if (ins.desc().operand == OPERAND_NATIVE)
+        {
+            hash.addData(getNativeName(ins).toUtf8());
+        }
+        else if (ins.desc().operand == OPERAND_CALL)
+        {
+            int target = m_script.getCallTarget(ins);
+            int callee = (target == -1) ? -1 : getFunctionByInstruction(m_script.getInstructionByLocation(target));
+
+            if (callee != -1)
+            {
+                const Function &c = m_funcs[callee];
+
+                hash.addData(QString("%1/%2/%3").arg(c.name).arg(c.params).arg(c.results).toUtf8());
+            }
+        }
+    }
+
+    return hash.result();
+}
+
+void Decompiler::run()
+{
+    m_cacheHits = 0;
+
+    if (m_useCache && !m_cachePath.isEmpty())
+        QDir().mkpath(m_cachePath);
+
+    int funcs = (int)m_funcs.size();
+
+    std::atomic<int> written(0);
+
+    // functions only depend on the script, so any thread can take the next one
+    Util::parallelFor(funcs, m_threadCount, [&](int func)
+    {
+        if (!m_useCache)
+        {
+            m_text[func] = FunctionWriter(*this, func).write();
+            return;
+        }
+
+        QByteArray key = getKey(func);
+
+        {
+            std::lock_guard<std::mutex> lock(s_cacheMutex);
+
+            if (const QString *text = s_cache.object(key))
+            {
+                m_text[func] = *text;
+                m_cacheHits++;
+                return;
+            }
+        }
+
+        QString path = m_cachePath.isEmpty() ? QString() : m_cachePath + "/" + QString(key.toHex()) + ".c";
+        QFile cached(path);
+
+        if (!path.isEmpty() && cached.open(QIODevice::ReadOnly))
+        {
+            m_text[func] = QString::fromUtf8(cached.readAll());
+            m_cacheHits++;
+        }
+        else
+        {
+            m_text[func] = FunctionWriter(*this, func).write();
+
+            if (!path.isEmpty())
+            {
+                QSaveFile out(path);
+
+                if (out.open(QIODevice::WriteOnly))
+                {
+                    out.write(m_text[func].toUtf8());
+
+                    if (out.commit())
+                        written++;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(s_cacheMutex);
+
+        s_cache.insert(key, new QString(m_text[func]), qMax(1, m_text[func].size()));
+    });
+
+    if (written > 0)
+        pruneCache();
+}
+
+void Decompiler::pruneCache() const
+{
+    QFileInfoList files = QDir(m_cachePath).entryInfoList({ "*.c" }, QDir::Files, QDir::Time);
+
+    qint64 size = 0;
+
+    // newest first, so whatever passes the cap was written longest ago
+    for (const QFileInfo &file : files)
+    {
+        // --cache may name a directory holding other files, only hex keys are ours
+        if (file.completeBaseName().size() != 40)
+            continue;
+
+        size += file.size();
+
+        if (size > CACHE_MAX_DISK_BYTES)
+            QFile::remove(file.filePath());
+    }
+}
+
+void Decompiler::write(QTextStream &stream) const
+{
+    for (const QString &text : m_text)
+    {
+        stream << text << "\n";
+    }
+}
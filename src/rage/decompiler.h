@@ -0,0 +1,72 @@
+#ifndef DECOMPILER_H
+#define DECOMPILER_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QTextStream>
+
+#include <atomic>
+#include <vector>
+
+#include "controlflow.h"
+
+// Turns every function into C-like pseudo code: the stack code of each block
+// is lifted to expressions, and the blocks are structured into if, while and
+// switch from the control flow graph, with goto where that doesn't fit.
+//
+// Functions are decompiled independently on a pool of threads. The text of
+// each is cached by a hash of everything it depends on, in memory for the
+// whole process, and on disk, each up to a size, so opening a script again
+// only looks it up.
+class Decompiler
+{
+public:
+    Decompiler(ScriptView script, QMap<unsigned int, QString> nativeMap);
+
+    void setThreadCount(int count) { m_threadCount = count; } // 0 uses the core count
+    void setCachePath(QString path) { m_cachePath = path; }   // empty disables the disk cache
+    void setUseCache(bool use) { m_useCache = use; }          // false decompiles every function, neither looking it up nor storing it
+
+    // decompiles every function, those already cached are only looked up
+    void run();
+
+    int getFunctionCount() const { return (int)m_funcs.size(); }
+    const QString &getFunction(int func) const { return m_text[func]; } // in function order, empty before run
+    int getCacheHits() const { return m_cacheHits; }
+
+    void write(QTextStream &stream) const;
+
+    static QString getDefaultCachePath();
+
+private:
+    class FunctionWriter;
+
+    struct Function
+    {
+        int first;
+        int last;
+        QString name;
+        int params;
+        int results; // of its first return, 0 if it never returns
+    };
+
+    QByteArray getKey(int func) const; // hash of the code, callees and natives the text depends on
+    void pruneCache() const;           // removes the oldest files once the disk cache passes its cap
+    int getFunctionByInstruction(int index) const; // function whose enter is the instruction, -1 if none
+
+    QString getNativeName(const Instruction &ins) const;
+
+    ScriptView m_script;
+    QMap<unsigned int, QString> m_nativeMap;
+
+    std::vector<Function> m_funcs;
+    std::vector<QString> m_text;
+
+    int m_threadCount;
+    QString m_cachePath;
+    bool m_useCache;
+    std::atomic<int> m_cacheHits;
+};
+
+#endif // DECOMPILER_H
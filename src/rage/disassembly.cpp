@@ -0,0 +1,392 @@
+#include "disassembly.h"
+
+#include <algorithm>
+
+#include "instructionformatter.h"
+#include "opcodes/enter.h"
+#include "../util/util.h"
+
+static const int FIELD_WIDTH = 15;
+static const int FLUSH_SIZE  = 1 << 16;
+
+Disassembly::Disassembly(ScriptView script, QMap<unsigned int, QString> nativeMap)
+    : m_script(script)
+    , m_nativeMap(nativeMap)
+    , m_invalidCalls(0)
+{
+    for (auto func : m_script.getFuncs())
+    {
+        m_funcNames.emplace(func.first, func.second.toUtf8());
+    }
+
+    // one past the slots for an out of range one, which reads as 0 like QVector::value
+    for (unsigned int hash : m_script.getNatives())
+    {
+        m_nativeNames.push_back(Util::getNative(hash, m_nativeMap).toUtf8());
+    }
+
+    m_nativeNames.push_back(Util::getNative(0, m_nativeMap).toUtf8());
+
+    countInvalidCalls();
+}
+
+void Disassembly::countInvalidCalls()
+{
+    for (const Instruction &ins : m_script.getInstructions())
+    {
+        if (ins.desc().operand == OPERAND_CALL && m_script.getCallTarget(ins) == -1)
+            m_invalidCalls++;
+    }
+}
+
+QString Disassembly::getData(std::shared_ptr<IOpcode> op) const
+{
+    if (op->getOp() >= OPCODE_COUNT || op->getData().size() < opcodeDesc(op->getOp()).size - 1)
+        return op->getFormattedData();
+
+    EOperand operand = opcodeDesc(op->getOp()).operand;
+
+    if (operand == OPERAND_ENTER)
+        return std::dynamic_pointer_cast<Op_Enter>(op)->getFuncName();
+
+    if (operand != OPERAND_NATIVE && operand != OPERAND_CALL && operand != OPERAND_JUMP)
+        return op->getFormattedData();
+
+    // resolve names from the opcode's current operand, it may have been edited
+    Instruction ins;
+
+    ins.index       = -1;
+    ins.location    = op->getLocation();
+    ins.page        = op->getPage();
+    ins.op          = op->getOp();
+    ins.operand     = (const unsigned char*)op->getData().constData();
+    ins.operandSize = op->getData().size();
+
+    return getData(ins);
+}
+
+QString Disassembly::getData(const Instruction &ins) const
+{
+    TextBuffer &buffer = TextBuffer::scratch();
+    writeData(buffer, ins);
+    return buffer.toString();
+}
+
+void Disassembly::writeData(TextBuffer &buffer, const Instruction &ins) const
+{
+    // an edited operand may be too short to resolve
+    if (ins.operandSize < ins.desc().size - 1)
+    {
+        InstructionFormatter::writeData(buffer, ins.op, ins.operand, ins.operandSize);
+        return;
+    }
+
+    switch (ins.desc().operand)
+    {
+    case OPERAND_NATIVE:
+    {
+        int native   = ((ins.u8(0) << 2) & 0x300) | ins.u8(1);
+        int argCount = (ins.u8(0) & 0x3e) >> 1;
+        bool hasRets = (ins.u8(0) & 1) == 1 ? true : false;
+
+        buffer.append(getNativeName(native));
+        buffer.append(" (");
+        buffer.appendDecimal(argCount);
+        buffer.append(" args, ret ");
+        buffer.append(hasRets ? '1' : '0');
+        buffer.append(')');
+        return;
+    }
+    case OPERAND_ENTER:
+        buffer.append(m_funcNames.at(ins.location));
+        return;
+    case OPERAND_CALL:
+    {
+        int callOffset = m_script.getCallTarget(ins);
+
+        if (callOffset == -1)
+        {
+            buffer.append(QString("??? (%1)").arg(m_script.getCallAddress(ins), 5, 16).toUtf8());
+            return;
+        }
+
+        buffer.append(m_funcNames.at(callOffset));
+        return;
+    }
+    case OPERAND_JUMP:
+    {
+        // or one edited to land where no label is
+        auto label = m_script.getLabels().find(ins.jumpTarget());
+
+        if (label == m_script.getLabels().end())
+            break;
+
+        buffer.append("@sub_");
+        buffer.appendDecimal(label->second);
+        return;
+    }
+    case OPERAND_STRING:
+        if (ins.op == EOpcodes::OP_SPUSH)
+        {
+            InstructionFormatter::writeString(buffer, ins.operand, ins.operandSize);
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    InstructionFormatter::writeData(buffer, ins.op, ins.operand, ins.operandSize);
+}
+
+void Disassembly::write(QTextStream &stream) const
+{
+    writeListing(ListingFormat::LISTING_TEXT, nullptr, [&](TextBuffer &buffer)
+    {
+        buffer.flush(stream);
+        return true;
+    });
+}
+
+bool Disassembly::write(QIODevice *device, ListingFormat format, const QVector<std::shared_ptr<IOpcode>> *opcodes) const
+{
+    return writeListing(format, opcodes, [device](TextBuffer &buffer)
+    {
+        const char *data = buffer.data();
+        int size = buffer.size();
+
+        // invalid utf-8 in script strings goes out replaced, as it does through a text stream
+        bool ascii = std::all_of(data, data + size, [](char c) { return (unsigned char)c < 0x80; });
+        QByteArray text = ascii ? QByteArray::fromRawData(data, size) : buffer.toString().toUtf8();
+
+        bool written = device->write(text) == text.size();
+        buffer.clear();
+
+        return written;
+    });
+}
+
+bool Disassembly::writeListing(ListingFormat format, const QVector<std::shared_ptr<IOpcode>> *opcodes,
+                               const std::function<bool(TextBuffer &)> &flush) const
+{
+    static const char *const columnNames[] = { "location", "bytes", "op", "data" };
+    static const QByteArray noFunc;
+
+    const InstructionStream &instructions = m_script.getInstructions();
+    const std::vector<Label> &labels = instructions.getLabelIndex();
+
+    auto label = labels.begin();
+    bool firstFunc = true;
+
+    const QByteArray *func = &noFunc;
+
+    // rows go into one buffer, which is flushed in large pieces
+    TextBuffer buffer(FLUSH_SIZE + 1024);
+    TextBuffer columns[4];
+
+    if (format == ListingFormat::LISTING_CSV)
+        buffer.append("location,bytes,op,data,function,label\n");
+
+    for (Instruction ins : instructions)
+    {
+        int number = -1;
+
+        if (opcodes != nullptr)
+        {
+            // the op and location can't be edited, only the operand
+            const QByteArray &operand = opcodes->at(ins.index)->getData();
+
+            ins.operand     = (const unsigned char*)operand.constData();
+            ins.operandSize = operand.size();
+        }
+
+        if (label != labels.end() && label->index == ins.index)
+        {
+            number = label->number;
+            ++label;
+        }
+
+        for (TextBuffer &column : columns)
+        {
+            column.clear();
+        }
+
+        InstructionFormatter::writeLocation(columns[0], ins.page, ins.location);
+        InstructionFormatter::writeBytes(columns[1], ins.op, ins.operand, ins.operandSize);
+        columns[2].append(ins.desc().name);
+        writeData(columns[3], ins);
+
+        if (ins.desc().operand == OPERAND_ENTER)
+        {
+            // don't put spacer in front of first function
+            if (format == ListingFormat::LISTING_TEXT && !firstFunc)
+                buffer.append('\n');
+
+            firstFunc = false;
+            func = &m_funcNames.at(ins.location);
+        }
+
+        switch (format)
+        {
+        case ListingFormat::LISTING_TEXT:
+        {
+            if (number != -1)
+            {
+                int field = buffer.size();
+
+                buffer.append(":sub_");
+                buffer.appendDecimal(number);
+                buffer.leftJustify(field, FIELD_WIDTH);
+                buffer.append('\n');
+            }
+
+            for (const TextBuffer &column : columns)
+            {
+                int field = buffer.size();
+
+                buffer.append(column.data(), column.size());
+                buffer.leftJustify(field, FIELD_WIDTH);
+            }
+
+            buffer.append('\n');
+            break;
+        }
+        case ListingFormat::LISTING_JSONL:
+        {
+            buffer.append('{');
+
+            for (int i = 0; i < 4; i++)
+            {
+                buffer.append('"');
+                buffer.append(columnNames[i]);
+                buffer.append("\":", 2);
+                buffer.appendJsonString(columns[i].data(), columns[i].size());
+                buffer.append(',');
+            }
+
+            buffer.append("\"function\":");
+            buffer.appendJsonString(func->constData(), func->size());
+
+            buffer.append(",\"label\":");
+
+            if (number != -1)
+            {
+                buffer.append("\"sub_");
+                buffer.appendDecimal(number);
+                buffer.append('"');
+            }
+            else
+            {
+                buffer.append("null");
+            }
+
+            buffer.append("}\n");
+            break;
+        }
+        case ListingFormat::LISTING_CSV:
+        {
+            for (const TextBuffer &column : columns)
+            {
+                buffer.appendCsvField(column.data(), column.size());
+                buffer.append(',');
+            }
+
+            buffer.appendCsvField(func->constData(), func->size());
+            buffer.append(',');
+
+            if (number != -1)
+            {
+                buffer.append("sub_");
+                buffer.appendDecimal(number);
+            }
+
+            buffer.append('\n');
+            break;
+        }
+        }
+
+        if (buffer.size() >= FLUSH_SIZE && !flush(buffer))
+            return false;
+    }
+
+    return flush(buffer);
+}
+
+void Disassembly::writeXrefs(QTextStream &stream) const
+{
+    const XrefIndex &xrefs = m_script.getXrefs();
+
+    TextBuffer buffer(FLUSH_SIZE + 1024);
+
+    auto flush = [&]()
+    {
+        if (buffer.size() >= FLUSH_SIZE)
+            buffer.flush(stream);
+    };
+
+    for (auto func : m_funcNames)
+    {
+        writeRefs(buffer, func.second, xrefs.getRefsTo(EXref::XREF_CALL, m_script.getInstructionByLocation(func.first)));
+        flush();
+    }
+
+    for (int slot : xrefs.getTargets(EXref::XREF_NATIVE))
+    {
+        writeRefs(buffer, getNativeName(slot), xrefs.getRefsTo(EXref::XREF_NATIVE, slot));
+        flush();
+    }
+
+    for (int index : xrefs.getTargets(EXref::XREF_STATIC))
+    {
+        writeRefs(buffer, QByteArray("static_") + QByteArray::number(index), xrefs.getRefsTo(EXref::XREF_STATIC, index));
+        flush();
+    }
+
+    for (int index : xrefs.getTargets(EXref::XREF_GLOBAL))
+    {
+        writeRefs(buffer, QByteArray("global_") + QByteArray::number(index), xrefs.getRefsTo(EXref::XREF_GLOBAL, index));
+        flush();
+    }
+
+    buffer.flush(stream);
+}
+
+void Disassembly::writeRefs(TextBuffer &buffer, const QByteArray &target, IndexRange refs) const
+{
+    buffer.append(target);
+    buffer.append(" (");
+    buffer.appendDecimal(refs.size());
+    buffer.append(" refs)\n");
+
+    for (int ref : refs)
+    {
+        Instruction ins = m_script.getInstructions().at(ref);
+
+        buffer.append("    ");
+
+        int field = buffer.size();
+        InstructionFormatter::writeLocation(buffer, ins.page, ins.location);
+        buffer.leftJustify(field, FIELD_WIDTH);
+
+        field = buffer.size();
+        buffer.append(ins.desc().name);
+        buffer.leftJustify(field, FIELD_WIDTH);
+
+        buffer.append(getFuncName(ins.location));
+        buffer.append('\n');
+    }
+}
+
+const QByteArray &Disassembly::getFuncName(unsigned int location) const
+{
+    static const QByteArray unknown("???");
+
+    auto func = m_funcNames.upper_bound(location);
+
+    return (func == m_funcNames.begin()) ? unknown : (--func)->second;
+}
+
+const QByteArray &Disassembly::getNativeName(int slot) const
+{
+    return m_nativeNames[(slot >= 0 && slot < (int)m_nativeNames.size() - 1) ? slot : (int)m_nativeNames.size() - 1];
+}
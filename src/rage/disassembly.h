@@ -0,0 +1,68 @@
+#ifndef DISASSEMBLY_H
+#define DISASSEMBLY_H
+
+#include <QIODevice>
+#include <QMap>
+#include <QTextStream>
+#include <QVector>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "iopcode.h"
+#include "scriptview.h"
+#include "../util/textbuffer.h"
+
+enum ListingFormat
+{
+    LISTING_TEXT,  // columns as in the gui, functions apart and labels on their own line
+    LISTING_JSONL, // one object per instruction
+    LISTING_CSV    // a header, then one row per instruction
+};
+
+// Resolves call, jump and native operands of a script so the listing can be
+// shown or written without any widgets. Only reads the script, so one
+// disassembly can be shared between threads.
+class Disassembly
+{
+public:
+    Disassembly(ScriptView script, QMap<unsigned int, QString> nativeMap);
+
+    QString getData(std::shared_ptr<IOpcode> op) const; // operand text with names resolved
+    QString getData(const Instruction &ins) const;
+
+    int getInvalidCalls() const { return m_invalidCalls; }
+
+    void write(QTextStream &stream) const; // same layout as the gui export
+
+    // formats the listing in pieces of a fixed size and writes each as it fills, so memory stays
+    // the same however big the script is, false if a write fails. Given the opcodes of the script,
+    // one per instruction, their operands are written in place of the decoded ones, edits included.
+    bool write(QIODevice *device, ListingFormat format, const QVector<std::shared_ptr<IOpcode>> *opcodes = nullptr) const;
+    void writeXrefs(QTextStream &stream) const; // callers of each function, users of each native, static and global
+
+private:
+    void countInvalidCalls();
+    void writeData(TextBuffer &buffer, const Instruction &ins) const;
+
+    // flush is handed the buffer whenever it fills and at the end, and clears it
+    bool writeListing(ListingFormat format, const QVector<std::shared_ptr<IOpcode>> *opcodes,
+                      const std::function<bool(TextBuffer &)> &flush) const;
+    void writeRefs(TextBuffer &buffer, const QByteArray &target, IndexRange refs) const;
+
+    const QByteArray &getFuncName(unsigned int location) const; // function the location is in
+    const QByteArray &getNativeName(int slot) const;
+
+    ScriptView m_script;
+    QMap<unsigned int, QString> m_nativeMap;
+
+    // utf-8 names, so rows copy them as they are
+    std::map<unsigned int, QByteArray> m_funcNames;
+    std::vector<QByteArray> m_nativeNames;
+
+    int m_invalidCalls;
+};
+
+#endif // DISASSEMBLY_H
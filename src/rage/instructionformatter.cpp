@@ -0,0 +1,287 @@
+#include "instructionformatter.h"
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+typedef void (*OperandWriter)(TextBuffer &buffer, const unsigned char *operand, int size);
+
+// big endian, as many bytes as there are up to four
+static unsigned int readImmediate(const unsigned char *operand, int size)
+{
+    unsigned int value = 0;
+
+    for (int i = 0; i < size && i < 4; i++)
+    {
+        value = (value << 8) | operand[i];
+    }
+
+    return value;
+}
+
+// %g with six digits as QString::arg gives it, where ties round away from zero and zero has no sign
+static void writeGeneral(TextBuffer &buffer, double value)
+{
+    if (value == 0)
+    {
+        buffer.append('0');
+        return;
+    }
+
+    // every digit a float has, so a tie is seen as one
+    char exact[64];
+    snprintf(exact, sizeof(exact), "%.30e", std::fabs(value));
+
+    const char *e = strchr(exact, 'e');
+    int exponent = atoi(e + 1);
+
+    char digits[7];
+    int count = 0;
+
+    for (const char *c = exact; c < e && count < 7; c++)
+    {
+        if (*c >= '0' && *c <= '9')
+            digits[count++] = *c;
+    }
+
+    if (digits[6] >= '5')
+    {
+        int i = 5;
+
+        for (; i >= 0 && digits[i] == '9'; i--)
+        {
+            digits[i] = '0';
+        }
+
+        if (i < 0)
+        {
+            digits[0] = '1';
+            exponent++;
+        }
+        else
+        {
+            digits[i]++;
+        }
+    }
+
+    count = 6;
+
+    while (count > 1 && digits[count - 1] == '0')
+    {
+        count--;
+    }
+
+    if (value < 0)
+        buffer.append('-');
+
+    if (exponent < -4 || exponent >= 6)
+    {
+        buffer.append(digits[0]);
+
+        if (count > 1)
+        {
+            buffer.append('.');
+            buffer.append(digits + 1, count - 1);
+        }
+
+        buffer.append((exponent < 0) ? "e-" : "e+");
+
+        if (std::abs(exponent) < 10)
+            buffer.append('0');
+
+        buffer.appendDecimal(std::abs(exponent));
+    }
+    else if (exponent >= 0)
+    {
+        for (int i = 0; i <= exponent; i++)
+        {
+            buffer.append((i < count) ? digits[i] : '0');
+        }
+
+        if (count > exponent + 1)
+        {
+            buffer.append('.');
+            buffer.append(digits + exponent + 1, count - exponent - 1);
+        }
+    }
+    else
+    {
+        buffer.append("0.");
+
+        for (int i = 0; i < -exponent - 1; i++)
+        {
+            buffer.append('0');
+        }
+
+        buffer.append(digits, count);
+    }
+}
+
+static void writeFloat(TextBuffer &buffer, const unsigned char *operand, int size)
+{
+    // a short operand reads as 0, as it did through QDataStream
+    unsigned int bits = (size >= 4) ? readImmediate(operand, 4) : 0;
+    float value;
+
+    memcpy(&value, &bits, sizeof(value));
+
+    // whole numbers below a million have no exponent and are most of them
+    if (std::fabs(value) < 1e6f && value == (float)(int)value)
+        buffer.appendDecimal((int)value);
+    else if (std::isnan(value))
+        buffer.append("nan");
+    else if (std::isinf(value))
+        buffer.append((value < 0) ? "-inf" : "inf");
+    else
+        writeGeneral(buffer, value);
+
+    buffer.append((value - std::floor(value) == 0) ? ".0f" : "f");
+}
+
+template<int Op>
+static void writeOperand(TextBuffer &buffer, const unsigned char *operand, int size)
+{
+    if constexpr (Op == EOpcodes::OP_IPUSH || Op == EOpcodes::OP_IPUSH2 || Op == EOpcodes::OP_IPUSH3 || Op == EOpcodes::OP_SADDI)
+    {
+        buffer.appendDecimal((int)readImmediate(operand, size));
+    }
+    else if constexpr (Op == EOpcodes::OP_FPUSH)
+    {
+        writeFloat(buffer, operand, size);
+    }
+    else if constexpr (Op == EOpcodes::OP_PUSH2B || Op == EOpcodes::OP_PUSH3B)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            buffer.appendHexBytes(operand + i, 1, false);
+            buffer.append(' ');
+        }
+    }
+    else
+    {
+        buffer.appendHexBytes(operand, size);
+    }
+}
+
+template<int Op>
+static void writeOpBytes(TextBuffer &buffer, const unsigned char *operand, int size)
+{
+    if constexpr (opcodeDesc(Op).operand == OPERAND_ENTER)
+    {
+        // without the name
+        buffer.appendHexBytes(operand, std::min(size, 4));
+    }
+    else if constexpr (Op == EOpcodes::OP_SPUSH)
+    {
+        // only the length, a char that QString::number showed as 64 bit when negative
+        int length = (size > 0) ? (char)operand[0] : 0;
+
+        buffer.appendDecimal(Op);
+
+        if (length < 0)
+            buffer.append("FFFFFFFF");
+
+        buffer.appendHex((unsigned int)length, 1);
+    }
+    else
+    {
+        buffer.appendDecimal(Op);
+        buffer.appendHexBytes(operand, size);
+    }
+}
+
+template<int... Ops>
+static constexpr std::array<OperandWriter, sizeof...(Ops)> makeOperandWriters(std::integer_sequence<int, Ops...>)
+{
+    return { { &writeOperand<Ops>... } };
+}
+
+template<int... Ops>
+static constexpr std::array<OperandWriter, sizeof...(Ops)> makeBytesWriters(std::integer_sequence<int, Ops...>)
+{
+    return { { &writeOpBytes<Ops>... } };
+}
+
+static constexpr auto s_operandWriters = makeOperandWriters(std::make_integer_sequence<int, OPCODE_COUNT>());
+static constexpr auto s_bytesWriters   = makeBytesWriters(std::make_integer_sequence<int, OPCODE_COUNT>());
+
+void InstructionFormatter::writeLocation(TextBuffer &buffer, int page, unsigned int location)
+{
+    buffer.appendHex(page, 5);
+    buffer.append(':');
+    buffer.appendHex(location, 7);
+}
+
+void InstructionFormatter::writeBytes(TextBuffer &buffer, int op, const unsigned char *operand, int size)
+{
+    if (op >= 0 && op < OPCODE_COUNT)
+    {
+        s_bytesWriters[op](buffer, operand, size);
+        return;
+    }
+
+    buffer.appendDecimal(op);
+    buffer.appendHexBytes(operand, size);
+}
+
+void InstructionFormatter::writeData(TextBuffer &buffer, int op, const unsigned char *operand, int size)
+{
+    if (op >= 0 && op < OPCODE_COUNT)
+    {
+        s_operandWriters[op](buffer, operand, size);
+        return;
+    }
+
+    buffer.appendHexBytes(operand, size);
+}
+
+void InstructionFormatter::writeFuncName(TextBuffer &buffer, const unsigned char *operand, int size)
+{
+    if (size <= 4)
+        return;
+
+    // up to the terminator, as QString took it from the bytes
+    const void *end = memchr(operand + 4, 0, size - 4);
+
+    buffer.append((const char*)operand + 4, end ? (int)((const unsigned char*)end - operand) - 4 : size - 4);
+}
+
+void InstructionFormatter::writeString(TextBuffer &buffer, const unsigned char *operand, int size)
+{
+    const void *terminator = memchr(operand, 0, size);
+    int length = terminator ? (int)((const unsigned char*)terminator - operand) : size;
+
+    buffer.append('"');
+
+    if (length > 0 && operand[0] >= 0x80)
+    {
+        // the length byte may decode together with the text, so leave it to QString
+        QString text = QString::fromUtf8((const char*)operand, length);
+
+        text.remove(0, 1);
+        text.replace(0x0A, "\\n");
+
+        buffer.append(text.toUtf8());
+    }
+    else
+    {
+        // after the length, line breaks escaped
+        for (int i = 1; i < length;)
+        {
+            const void *newline = memchr(operand + i, '\n', length - i);
+            int end = newline ? (int)((const unsigned char*)newline - operand) : length;
+
+            buffer.append((const char*)operand + i, end - i);
+
+            if (newline)
+                buffer.append("\\n", 2);
+
+            i = end + 1;
+        }
+    }
+
+    buffer.append('"');
+}
@@ -0,0 +1,26 @@
+#ifndef INSTRUCTIONFORMATTER_H
+#define INSTRUCTIONFORMATTER_H
+
+#include "opcodedesc.h"
+#include "../util/textbuffer.h"
+
+// Writes the columns of a listing row into a TextBuffer. Each opcode has its
+// own data writer, picked from a table built at compile time, so a row costs
+// a table lookup and a few byte copies. The text is the same as the QString
+// formatters of IOpcode give, which are built on this.
+class InstructionFormatter
+{
+public:
+    static void writeLocation(TextBuffer &buffer, int page, unsigned int location); // page:offset
+
+    // the op and operand bytes, shortened for enter and spush as in the listing
+    static void writeBytes(TextBuffer &buffer, int op, const unsigned char *operand, int size);
+
+    // operand as a value, without resolving names
+    static void writeData(TextBuffer &buffer, int op, const unsigned char *operand, int size);
+
+    static void writeFuncName(TextBuffer &buffer, const unsigned char *operand, int size); // of an enter
+    static void writeString(TextBuffer &buffer, const unsigned char *operand, int size);   // of an spush, quoted
+};
+
+#endif // INSTRUCTIONFORMATTER_H
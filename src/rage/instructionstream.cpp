@@ -0,0 +1,147 @@
+#include "instructionstream.h"
+
+static inline int popCount(quint64 x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+void InstructionStream::reserve(int count)
+{
+    m_locations.reserve(count);
+    m_ops.reserve(count);
+    m_operandSizes.reserve(count);
+    m_pages.reserve(count);
+}
+
+int InstructionStream::append(unsigned int location, byte op, int operandSize, int page)
+{
+    m_locations.push_back(location);
+    m_ops.push_back(op);
+    m_operandSizes.push_back(operandSize);
+    m_pages.push_back(page);
+
+    return size() - 1;
+}
+
+void InstructionStream::append(const InstructionStream &other)
+{
+    int first = size();
+
+    m_locations.insert(m_locations.end(), other.m_locations.begin(), other.m_locations.end());
+    m_ops.insert(m_ops.end(), other.m_ops.begin(), other.m_ops.end());
+    m_operandSizes.insert(m_operandSizes.end(), other.m_operandSizes.begin(), other.m_operandSizes.end());
+    m_pages.insert(m_pages.end(), other.m_pages.begin(), other.m_pages.end());
+
+    m_labels.insert(other.m_labels.begin(), other.m_labels.end());
+
+    for (int index : other.m_strings)
+    {
+        m_strings.push_back(first + index);
+    }
+}
+
+void InstructionStream::buildLabelIndex()
+{
+    m_labelIndex.clear();
+
+    // locations only ascend within a page, so merge each page's run with the labels
+    for (int first = 0, last; first < size(); first = last)
+    {
+        auto label = m_labels.lower_bound(m_locations[first]);
+
+        for (last = first; last < size() && m_pages[last] == m_pages[first]; last++)
+        {
+            while (label != m_labels.end() && label->first < m_locations[last])
+                ++label;
+
+            if (label != m_labels.end() && label->first == m_locations[last])
+                m_labelIndex.push_back({ last, label->second });
+        }
+    }
+}
+
+void InstructionStream::buildAddressIndex(const std::vector<unsigned int> &pageLocations)
+{
+    m_starts.assign(pageLocations.size() * (0x4000 / 64), 0);
+    m_startRanks.assign(m_starts.size(), 0);
+
+    for (int i = 0; i < size(); i++)
+    {
+        unsigned int address = (m_pages[i] << 14) + (m_locations[i] - pageLocations[m_pages[i]]);
+
+        m_starts[address >> 6] |= 1ULL << (address & 63);
+    }
+
+    // pages are decoded in order, so an instruction's index is the number of starts below it
+    for (size_t word = 1; word < m_starts.size(); word++)
+    {
+        m_startRanks[word] = m_startRanks[word - 1] + popCount(m_starts[word - 1]);
+    }
+}
+
+int InstructionStream::indexOf(unsigned int address) const
+{
+    unsigned int word = address >> 6;
+    quint64 bit = 1ULL << (address & 63);
+
+    if (word >= m_starts.size() || (m_starts[word] & bit) == 0)
+        return -1;
+
+    return m_startRanks[word] + popCount(m_starts[word] & (bit - 1));
+}
+
+int InstructionStream::readOperandSize(byte op, const unsigned char *operand, int available)
+{
+    int size = 0;
+
+    switch (opcodeDesc(op).operand)
+    {
+    case OPERAND_ENTER:
+        // param count, frame size (2), name length, then the name
+        size = (available < 4) ? -1 : 4 + operand[3];
+        break;
+    case OPERAND_SWITCH:
+        // case count, then a value and jump offset per case
+        size = (available < 1) ? -1 : 1 + operand[0] * 6;
+        break;
+    case OPERAND_STRING:
+        // spushl isn't understood yet and is decoded without an operand
+        if (op == EOpcodes::OP_SPUSH)
+            size = (available < 1) ? -1 : 1 + operand[0];
+        break;
+    default:
+        size = opcodeDesc(op).size - 1;
+        break;
+    }
+
+    return (size > available) ? -1 : size;
+}
+
+Instruction InstructionStream::at(int index) const
+{
+    Instruction ins;
+
+    ins.index       = index;
+    ins.location    = m_locations[index];
+    ins.page        = m_pages[index];
+    ins.op          = m_ops[index];
+    ins.operand     = (const unsigned char*)m_data.constData() + ins.location + 1;
+    ins.operandSize = m_operandSizes[index];
+
+    return ins;
+}
+
+qint64 InstructionStream::memoryUsage() const
+{
+    return (qint64)m_locations.capacity()    * sizeof(unsigned int)
+         + (qint64)m_ops.capacity()          * sizeof(byte)
+         + (qint64)m_operandSizes.capacity() * sizeof(unsigned short)
+         + (qint64)m_pages.capacity()        * sizeof(unsigned short)
+         + (qint64)m_strings.capacity()      * sizeof(int)
+         + (qint64)m_starts.capacity()       * sizeof(quint64)
+         + (qint64)m_startRanks.capacity()   * sizeof(int);
+}
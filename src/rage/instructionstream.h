@@ -0,0 +1,141 @@
+#ifndef INSTRUCTIONSTREAM_H
+#define INSTRUCTIONSTREAM_H
+
+#include <map>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+#include "opcodedesc.h"
+
+// One decoded instruction. The operand points into the script data, so it is
+// only valid as long as the stream that returned it.
+struct Instruction
+{
+    int index;
+    unsigned int location;
+    int page;
+    byte op;
+    const unsigned char *operand;
+    int operandSize;
+
+    const OpcodeDesc &desc() const { return opcodeDesc(op); }
+    int size() const               { return operandSize + 1; }
+
+    // big endian immediates at operand offset i
+    int u8(int i) const  { return operand[i]; }
+    int u16(int i) const { return (operand[i] << 8) | operand[i + 1]; }
+    int u32(int i) const { return (int)(((unsigned int)u16(i) << 16) | u16(i + 2)); }
+
+    QByteArray operandData() const { return QByteArray::fromRawData((const char*)operand, operandSize); }
+
+    // location a jump lands on, relative to the next instruction
+    unsigned int jumpTarget() const { return location + 3 + (short)u16(0); }
+
+    // switch cases: a 32 bit value and a jump offset relative to the end of the case
+    int switchCount() const                { return u8(0); }
+    int switchValue(int i) const           { return u32(1 + i * 6); }
+    unsigned int switchTarget(int i) const { return location + 8 + i * 6 + (short)u16(5 + i * 6); }
+};
+
+// A run of instruction or block indices in one of the index arrays
+struct IndexRange
+{
+    const int *first;
+    const int *last;
+
+    const int *begin() const { return first;              }
+    const int *end()   const { return last;               }
+    int size() const         { return (int)(last - first); }
+    bool empty() const       { return first == last;      }
+};
+
+// A jump target that lands on an instruction
+struct Label
+{
+    int index;  // instruction the label goes in front of
+    int number; // shown as sub_<number>
+};
+
+// The decoded code pages of a script, one entry per instruction in parallel
+// arrays, with side tables for labels, functions and strings.
+class InstructionStream
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const InstructionStream *stream, int index) : m_stream(stream), m_index(index) {}
+
+        Instruction operator*() const { return m_stream->at(m_index); }
+
+        const_iterator &operator++()                   { m_index++; return *this;         }
+        bool operator!=(const const_iterator &o) const { return m_index != o.m_index;     }
+        bool operator==(const const_iterator &o) const { return m_index == o.m_index;     }
+
+    private:
+        const InstructionStream *m_stream;
+        int m_index;
+    };
+
+    void setData(const QByteArray &data) { m_data = data; }
+    void reserve(int count);
+
+    // returns the new instruction's index
+    int append(unsigned int location, byte op, int operandSize, int page);
+
+    // appends the instructions, labels and strings of another stream over the same data,
+    // labels already here win, functions are left to the caller to name
+    void append(const InstructionStream &other);
+
+    // operand length of an instruction, -1 if it runs past the available bytes
+    static int readOperandSize(byte op, const unsigned char *operand, int available);
+
+    int size() const { return (int)m_ops.size(); }
+    Instruction at(int index) const;
+
+    const_iterator begin() const { return const_iterator(this, 0);      }
+    const_iterator end()   const { return const_iterator(this, size()); }
+
+    // label number of each jump target, the number of the first jump to it within its page
+    void addLabel(unsigned int location, int number) { m_labels.insert(std::make_pair(location, number)); }
+    const std::map<unsigned int, int> &getLabels() const { return m_labels; }
+
+    // the labels that land on an instruction, in instruction order, built once decoding is done
+    void buildLabelIndex();
+    const std::vector<Label> &getLabelIndex() const { return m_labelIndex; }
+
+    // marks where each instruction starts by code address (page << 14 | offset), built once decoding is done
+    void buildAddressIndex(const std::vector<unsigned int> &pageLocations);
+    int indexOf(unsigned int address) const; // instruction starting at a code address, -1 if none
+
+    // function name of each enter instruction
+    void addFunc(unsigned int location, QString name) { m_funcs.insert(std::make_pair(location, name)); }
+    const std::map<unsigned int, QString> &getFuncs() const { return m_funcs; }
+
+    // instruction index of each string push
+    void addString(int index) { m_strings.push_back(index); }
+    const std::vector<int> &getStrings() const { return m_strings; }
+
+    qint64 memoryUsage() const; // bytes held by the arrays, not counting the script data or side tables
+
+private:
+    QByteArray m_data;
+
+    std::vector<unsigned int>   m_locations;
+    std::vector<byte>           m_ops;
+    std::vector<unsigned short> m_operandSizes;
+    std::vector<unsigned short> m_pages;
+
+    std::map<unsigned int, int>     m_labels;
+    std::vector<Label>              m_labelIndex;
+
+    // one bit per code byte, with the number of instructions before each 64 bit word
+    std::vector<quint64> m_starts;
+    std::vector<int>     m_startRanks;
+    std::map<unsigned int, QString> m_funcs;
+    std::vector<int> m_strings;
+};
+
+#endif // INSTRUCTIONSTREAM_H
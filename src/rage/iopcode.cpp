@@ -1,5 +1,7 @@
 #include "iopcode.h"
 
+#include "instructionformatter.h"
+
 void IOpcode::read(QDataStream *stream)
 {
     m_delete   = false;
@@ -16,70 +18,38 @@ void IOpcode::read(QDataStream *stream)
 
 QString IOpcode::getFormattedLocation()
 {
-    QString page = QString::number(getPage(), 16).rightJustified(5, '0').toUpper();
-    QString loc = QString::number(getLocation(), 16).rightJustified(7, '0').toUpper();
-    return page + ":" + loc;
+    return formatLocation(getPage(), getLocation());
 }
 
 QString IOpcode::getFormattedBytes()
 {
-    return QString::number(getOp()) + getData().toHex().toUpper();
+    return formatBytes(getOp(), getData());
 }
 
 QString IOpcode::getFormattedData()
 {
-    if (getOp() == EOpcodes::OP_IPUSH || getOp() == EOpcodes::OP_IPUSH2 || getOp() == EOpcodes::OP_IPUSH3 || getOp() == EOpcodes::OP_SADDI)
-    {
-        int result;
-        char temp[4];
-
-        memset(temp, 0, 4);
-
-        for (int i = 0; i < getData().size(); i++)
-        {
-            temp[i] = getData()[getData().size() - 1 - i];
-        }
-
-        memcpy(&result, &temp, sizeof(int));
-
-        return QString("%1").arg(result);
-    }
-
-    if (getOp() == EOpcodes::OP_FPUSH)
-    {
-        QDataStream str(getData());
-        QString result;
-        float fl;
-
-        str.setFloatingPointPrecision(QDataStream::SinglePrecision);
-
-        str >> fl;
-
-        if (fl - floor(fl) == 0)
-            result = QString("%1.0f").arg(fl);
-        else
-            result = QString("%1f").arg(fl);
-
-        return result;
-    }
-
-    if (getOp() == EOpcodes::OP_PUSH2B || getOp() == EOpcodes::OP_PUSH3B)
-    {
-        QString result;
-        QByteArray data = getData().toHex();
-
-        for (int i = 0; i < data.length(); i++)
-        {
-            result += data[i];
+    return formatData(getOp(), getData());
+}
 
-            if (i % 2 == 1)
-                result += " ";
-        }
+QString IOpcode::formatLocation(int page, unsigned int location)
+{
+    TextBuffer &buffer = TextBuffer::scratch();
+    InstructionFormatter::writeLocation(buffer, page, location);
+    return buffer.toString();
+}
 
-        return result;
-    }
+QString IOpcode::formatBytes(int op, const QByteArray &data)
+{
+    TextBuffer &buffer = TextBuffer::scratch();
+    InstructionFormatter::writeBytes(buffer, op, (const unsigned char*)data.constData(), data.size());
+    return buffer.toString();
+}
 
-    return getData().toHex().toUpper();
+QString IOpcode::formatData(int op, const QByteArray &data)
+{
+    TextBuffer &buffer = TextBuffer::scratch();
+    InstructionFormatter::writeData(buffer, op, (const unsigned char*)data.constData(), data.size());
+    return buffer.toString();
 }
 
 QByteArray IOpcode::getFullData()
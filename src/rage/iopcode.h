@@ -73,6 +73,11 @@ public:
 
     virtual QByteArray getFullData();
 
+    // the same text for instructions decoded without an opcode object
+    static QString formatLocation(int page, unsigned int location);
+    static QString formatBytes(int op, const QByteArray &data);
+    static QString formatData(int op, const QByteArray &data);
+
     // Editing related
 
     virtual bool getDeleted()             { return m_delete;    }
@@ -88,6 +93,6 @@ protected:
     QVector<IOpcode*> m_references;
     int m_size;
     int m_page;
-    bool m_delete;
+    bool m_delete = false;
 };
 #endif // IOPCODE_H
@@ -0,0 +1,58 @@
+#ifndef OPCODEDESC_H
+#define OPCODEDESC_H
+
+#include "iopcode.h"
+
+enum EOperand
+{
+    OPERAND_NONE,
+    OPERAND_IMM8,   // one byte
+    OPERAND_IMM16,  // big endian
+    OPERAND_IMM24,  // big endian
+    OPERAND_IMM32,  // big endian
+    OPERAND_FLOAT,  // big endian
+    OPERAND_BYTES,  // one immediate per byte
+    OPERAND_NATIVE,
+    OPERAND_ENTER,  // param count, frame size, name length + name
+    OPERAND_RET,    // param count, result count
+    OPERAND_CALL,   // imm16, high nibble of the target in the opcode
+    OPERAND_JUMP,   // signed 16 bit, relative to the next instruction
+    OPERAND_SWITCH, // case count + cases
+    OPERAND_STRING  // length + string
+};
+
+enum EOpcodeFlags
+{
+    OPF_BRANCH     = 1 << 0, // jumps or switches, may transfer control within the function
+    OPF_CALL       = 1 << 1, // calls a function or native
+    OPF_PUSH       = 1 << 2, // pushes a constant
+    OPF_TERMINATOR = 1 << 3, // control never falls through to the next instruction
+    OPF_STATIC     = 1 << 4, // operand is a static index
+    OPF_GLOBAL     = 1 << 5, // operand is a global index
+    OPF_RETURN     = 1 << 6  // leaves the function, popping its results
+};
+
+struct OpcodeDesc
+{
+    int size; // including the opcode byte, 0 when it depends on the operand
+    EOperand operand;
+    const char *name;
+    int flags;
+    int pops;   // stack slots taken, -1 when the operand, callee or stack contents decide
+    int pushes; // stack slots left, -1 likewise
+};
+
+#include "opcodes_gen.h" // s_opcodeDescs, built from res/rage/opcodes.json
+
+constexpr int OPCODE_COUNT = sizeof(s_opcodeDescs) / sizeof(s_opcodeDescs[0]);
+
+static_assert(OPCODE_COUNT == EOpcodes::_SPACER, "opcodes.json is out of sync with EOpcodes");
+static_assert(s_opcodeDescs[EOpcodes::OP_ENTER].operand == OPERAND_ENTER, "opcodes.json is out of sync with EOpcodes");
+static_assert(s_opcodeDescs[EOpcodes::OP_JMPGT].operand == OPERAND_JUMP, "opcodes.json is out of sync with EOpcodes");
+static_assert(s_opcodeDescs[EOpcodes::OP_FPUSH7].flags == OPF_PUSH, "opcodes.json is out of sync with EOpcodes");
+static_assert(s_opcodeDescs[EOpcodes::OP_RET3R2].pops == 2, "opcodes.json is out of sync with EOpcodes");
+
+// op must be below OPCODE_COUNT
+constexpr const OpcodeDesc &opcodeDesc(int op) { return s_opcodeDescs[op]; }
+
+#endif // OPCODEDESC_H
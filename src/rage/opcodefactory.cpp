@@ -1,28 +1,26 @@
 #include "opcodefactory.h"
 
 #include <memory>
-#include <map>
 #include <iostream>
 
 bool OpcodeFactory::Register(const EOpcodes op, TCreateMethod createFunc)
 {
-    if (auto it = s_methods.find(op); it == s_methods.end())
-    {
-        s_methods[op] = createFunc;
-        return true;
-    }
-    return false;
+    if (op < 0 || op > EOpcodes::_SUB || s_methods[op])
+        return false;
+
+    s_methods[op] = createFunc;
+    return true;
 }
 
 std::shared_ptr<IOpcode> OpcodeFactory::Create(const EOpcodes name)
 {
-    if (auto it = s_methods.find(name); it != s_methods.end())
-        return it->second();
+    if (name < 0 || name > EOpcodes::_SUB || !s_methods[name])
+        return nullptr;
 
-    return nullptr;
+    return s_methods[name]();
 }
 
 template <typename T>
 bool RegisteredInFactory<T>::s_bRegistered = OpcodeFactory::Register(T::GetFactoryName(), T::CreateMethod);
 
-std::map<EOpcodes, OpcodeFactory::TCreateMethod> OpcodeFactory::s_methods;
+OpcodeFactory::TCreateMethod OpcodeFactory::s_methods[EOpcodes::_SUB + 1];
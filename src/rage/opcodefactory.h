@@ -26,7 +26,8 @@ public:
     static std::shared_ptr<IOpcode> Create(const EOpcodes opcode);
 
 private:
-    static std::map<EOpcodes, TCreateMethod> s_methods;
+    // indexed by opcode, zero initialized before any opcode registers itself
+    static TCreateMethod s_methods[EOpcodes::_SUB + 1];
 };
 
 template <typename T>
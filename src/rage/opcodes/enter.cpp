@@ -2,6 +2,8 @@
 
 #include <QDebug>
 
+#include "../instructionformatter.h"
+
 void Op_Enter::read(QDataStream *stream)
 {
     m_delete   = false;
@@ -30,18 +32,28 @@ void Op_Enter::read(QDataStream *stream)
 
 QString Op_Enter::getFormattedBytes()
 {
-    // ignore func name in data string
-    QByteArray copy(getData());
-
-    return copy.remove(4, getData().size()).toHex().toUpper();
+    return formatBytes(getData());
 }
 
 QString Op_Enter::getFormattedData()
 {
-    // only return func name
-    QByteArray copy(getData());
+    return formatData(getData());
+}
 
-    return copy.remove(0, 4);
+QString Op_Enter::formatBytes(const QByteArray &data)
+{
+    // ignore func name in data string
+    TextBuffer &buffer = TextBuffer::scratch();
+    InstructionFormatter::writeBytes(buffer, EOpcodes::OP_ENTER, (const unsigned char*)data.constData(), data.size());
+    return buffer.toString();
+}
+
+QString Op_Enter::formatData(const QByteArray &data)
+{
+    // only return func name
+    TextBuffer &buffer = TextBuffer::scratch();
+    InstructionFormatter::writeFuncName(buffer, (const unsigned char*)data.constData(), data.size());
+    return buffer.toString();
 }
 
 OP_REGISTER(Op_Enter);
@@ -13,6 +13,9 @@ public:
     virtual QString getFormattedBytes() override;
     virtual QString getFormattedData() override;
 
+    static QString formatBytes(const QByteArray &data);
+    static QString formatData(const QByteArray &data);
+
     virtual QVector<std::shared_ptr<IOpcode>> getReferences() { return m_references;      }
     virtual void addReference(std::shared_ptr<IOpcode> ref)   { m_references.append(ref); }
 
@@ -48,6 +48,6 @@ MAKE_SIMPLE_OP(Op_Push3B, EOpcodes::OP_PUSH3B, "push3b", 4);
 MAKE_SIMPLE_OP(Op_IAddImm1, EOpcodes::OP_IADDIMM1, "iaddimm1", 2);
 MAKE_SIMPLE_OP(Op_IAddImm2, EOpcodes::OP_IADDIMM2, "iaddimm2", 3);
 MAKE_SIMPLE_OP(Op_IMulImm1, EOpcodes::OP_IMULIMM1, "imulimm1", 2);
-MAKE_SIMPLE_OP(Op_IMulImm2, EOpcodes::OP_IMULIMM2, "imulimm1", 3);
+MAKE_SIMPLE_OP(Op_IMulImm2, EOpcodes::OP_IMULIMM2, "imulimm2", 3);
 
 #endif // INTEGER_H
@@ -16,7 +16,7 @@ void Op_SwitchR2::read(QDataStream *stream)
 
     m_data.push_back(b1);
 
-    // TODO: correctly implement switches
+    // a 32 bit value and jump offset per case, see Instruction::switchTarget
 
     for (int i = 0; i < b1 * 6; i++)
     {
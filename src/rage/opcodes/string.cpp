@@ -1,5 +1,7 @@
 #include "string.h"
 
+#include "../instructionformatter.h"
+
 void Op_SPush::read(QDataStream *stream)
 {
     m_delete   = false;
@@ -24,20 +26,28 @@ void Op_SPush::read(QDataStream *stream)
 
 QString Op_SPush::getFormattedBytes()
 {
-    // ignore string in data array
-    return QString::number(getOp()) + QString::number(getData()[0], 16).toUpper();
+    return formatBytes(getData());
 }
 
 QString Op_SPush::getFormattedData()
 {
-    // only return string
-    QString result(getData());
-
-    result.remove(0, 1);
+    return formatData(getData());
+}
 
-    result.replace(0x0A, "\\n");
+QString Op_SPush::formatBytes(const QByteArray &data)
+{
+    // ignore string in data array
+    TextBuffer &buffer = TextBuffer::scratch();
+    InstructionFormatter::writeBytes(buffer, EOpcodes::OP_SPUSH, (const unsigned char*)data.constData(), data.size());
+    return buffer.toString();
+}
 
-    return "\"" + result + "\"";
+QString Op_SPush::formatData(const QByteArray &data)
+{
+    // only return string
+    TextBuffer &buffer = TextBuffer::scratch();
+    InstructionFormatter::writeString(buffer, (const unsigned char*)data.constData(), data.size());
+    return buffer.toString();
 }
 
 void Op_SPushL::read(QDataStream *stream)
@@ -16,11 +16,14 @@ public:
     virtual void read(QDataStream *stream) override;
     virtual QString getFormattedBytes() override;
     virtual QString getFormattedData() override;
+
+    static QString formatBytes(const QByteArray &data);
+    static QString formatData(const QByteArray &data);
 };
 
 class Op_SPushL : public IOpcode, public RegisteredInFactory<Op_SPushL>
 {
-    REGISTER(Op_SPushL, EOpcodes::OP_SPUSHL, "spuhsl")
+    REGISTER(Op_SPushL, EOpcodes::OP_SPUSHL, "spushl")
 public:
     virtual void read(QDataStream *stream) override;
 };
@@ -1,10 +1,17 @@
 #include "script.h"
 
-#include <QFileDialog>
-#include <QMessageBox>
-#include <QSysInfo>
+#include <QElapsedTimer>
+#include <QFileInfo>
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+
+#include "../rage/opcodedesc.h"
 #include "../rage/opcodefactory.h"
+#include "../rage/scriptview.h"
+#include "../util/keyring.h"
+#include "../util/streamextractor.h"
 #include "../util/util.h"
 
 #include "../rage/opcodes/enter.h"
@@ -12,59 +19,109 @@
 #define ReadVar(x) stream >> x;
 #define ReadPointer(x) stream >> x; x = x & 0xffffff;
 
-Script::Script(QString path, bool debug)
-    : m_funcCount(0)
+static std::atomic<int> s_decodeThreads(0);
+
+Script::Script(QString path, bool debug, LoadMode mode)
+    : m_pagesContiguous(true)
+    , m_opcodesBuilt(false)
+    , m_funcCount(0)
     , m_script(path)
+    , m_error(ErrorCode::ERR_NONE)
     , m_debug(debug)
 {
+    m_scriptHeader.headerPos = -1;
+
     if (!m_script.open(QIODevice::ReadOnly))
     {
-        QMessageBox::critical(nullptr, "Error", "Error: Unable to open script.");
+        m_error = ErrorCode::ERR_OPEN_FAILED;
         return;
     }
 
-    m_scriptHeader.headerPos = -1;
-
     if (path.contains(".csc"))
         m_scriptType = ScriptType::TYPE_PS3;
     else
         m_scriptType = ScriptType::TYPE_X360;
 
-    m_data = m_script.readAll();
+    m_loadStats.fileSize = m_script.size();
+
+    uchar *file = nullptr;
+
+    if (mode == LoadMode::LOAD_MAPPED)
+    {
+        file = m_script.map(0, m_script.size());
+    }
 
     // Decompress and unencrypt script from inside resource file
-    if (readRSCHeader() == false)
+    if (file != nullptr)
+    {
+        m_error = extractMapped(file, m_script.size());
+
+        m_script.unmap(file);
+    }
+    else
     {
-        QMessageBox::critical(nullptr, "Error", "Error: Invalid script.");
+        m_data = m_script.readAll();
+        m_loadStats.bytesCopied += m_data.size();
 
+        m_error = readRSCHeader(m_data) ? extractData() : ErrorCode::ERR_INVALID_SCRIPT;
+    }
+
+    if (m_error != ErrorCode::ERR_NONE)
+    {
         return;
     }
 
-    extractData();
+    readScript();
+}
+
+Script::Script(const QByteArray &data, ScriptType type)
+    : m_pagesContiguous(true)
+    , m_opcodesBuilt(false)
+    , m_funcCount(0)
+    , m_data(data)
+    , m_scriptType(type)
+    , m_error(ErrorCode::ERR_NONE)
+    , m_debug(false)
+{
+    m_header = ResourceHeader();
+    m_scriptHeader.headerPos = -1;
+    m_loadStats.fileSize = data.size();
+
+    readScript();
+}
+
+void Script::readScript()
+{
+    m_loadStats.dataSize = m_data.size();
 
     // Begin disassembling script once extracted from resource file
     m_scriptHeader.headerPos = findScriptHeader();
 
     if (m_scriptHeader.headerPos == -1)
     {
-        QMessageBox::critical(nullptr, "Error", "Error: Unable to find script header.");
+        m_error = ErrorCode::ERR_NO_HEADER;
         return;
     }
 
     readScriptHeader(m_scriptHeader.headerPos);
     readNatives();
     readStatics();
+
+    QElapsedTimer timer;
+    timer.start();
+
     readPages();
-    insertJumps();
+
+    m_loadStats.decodeTime = timer.nsecsElapsed();
 
     //clean();
 }
 
-bool Script::readRSCHeader()
+bool Script::readRSCHeader(const QByteArray &data)
 {
     // Read data from header, which doesn't need to be uncompressed or unencrypted
 
-    QDataStream stream(m_data);
+    QDataStream stream(data);
 
     stream >> m_header.magic;
 
@@ -85,38 +142,128 @@ bool Script::readRSCHeader()
     return true;
 }
 
-void Script::extractData()
+ErrorCode Script::extractData()
 {
     if (m_header.version == 2)
     {
+        if (!KeyRing::get().isValid())
+        {
+            return ErrorCode::ERR_NO_KEY;
+        }
+
         // remove rsc header
         m_data = m_data.remove(0, 16);
+        m_loadStats.bytesCopied += m_data.size();
 
         m_data = Util::decrypt(m_data);
+        m_loadStats.bytesCopied += m_data.size();
 
         int outSize = m_header.getSizeP() + m_header.getSizeV();
+        int res;
 
-        if (m_debug)
-        {
-            QFileInfo info(m_script);
-            QFile out("debug/" + info.fileName() + ".dbg");
-
-            out.open(QIODevice::WriteOnly | QIODevice::Truncate);
-            out.write(m_data);
-        }
+        writeDebugData(m_data.constData(), m_data.size());
 
         if (m_scriptType == ScriptType::TYPE_X360)
         {
             // remove lzx header
             m_data.remove(0, 8);
+            m_loadStats.bytesCopied += m_data.size();
 
-            m_data = Util::lzxDecompress(m_data, outSize);
+            m_data = Util::lzxDecompress(m_data, outSize, &res);
         }
         else
         {
-            m_data = Util::zlibDecompress(m_data, outSize);
+            m_data = Util::zlibDecompress(m_data, outSize, &res);
+        }
+
+        if (res != 0)
+        {
+            return ErrorCode::ERR_DECOMPRESS_FAILED;
         }
     }
+
+    return ErrorCode::ERR_NONE;
+}
+
+ErrorCode Script::extractMapped(const uchar *file, qint64 size)
+{
+    // wraps the mapping, nothing is copied until decryption
+    QByteArray mapped = QByteArray::fromRawData((const char *)file, size);
+
+    if (readRSCHeader(mapped) == false || size < 16)
+    {
+        return ErrorCode::ERR_INVALID_SCRIPT;
+    }
+
+    if (m_header.version != 2)
+    {
+        m_data = QByteArray((const char *)file, size);
+        m_loadStats.bytesCopied += size;
+
+        return ErrorCode::ERR_NONE;
+    }
+
+    const char *payload = (const char *)file + 16;
+    int payloadSize = size - 16;
+    int outSize = m_header.getSizeP() + m_header.getSizeV();
+
+    m_data.resize(outSize);
+
+    if (!m_debug)
+    {
+        // decrypt and decompress on two threads, through a small ring instead of a full copy
+        StreamExtractor::Codec codec = (m_scriptType == ScriptType::TYPE_X360) ? StreamExtractor::CODEC_LZX : StreamExtractor::CODEC_ZLIB;
+        StreamExtractor extractor(payload, payloadSize, codec);
+
+        m_loadStats.bytesCopied += payloadSize;
+
+        int res = extractor.extract(m_data.data(), outSize);
+
+        if (res == StreamExtractor::EXTRACT_NOKEY)
+        {
+            return ErrorCode::ERR_NO_KEY;
+        }
+
+        return (res == 0) ? ErrorCode::ERR_NONE : ErrorCode::ERR_DECOMPRESS_FAILED;
+    }
+
+    // the debug dump needs the whole decrypted payload, so decrypt into a single scratch buffer
+    QByteArray decrypted(payloadSize, Qt::Uninitialized);
+
+    if (!Util::decrypt(payload, decrypted.data(), payloadSize))
+    {
+        return ErrorCode::ERR_NO_KEY;
+    }
+
+    m_loadStats.bytesCopied += payloadSize;
+
+    writeDebugData(decrypted.constData(), decrypted.size());
+
+    int res;
+
+    if (m_scriptType == ScriptType::TYPE_X360)
+    {
+        // skip lzx header
+        res = Util::lzxDecompress(decrypted.constData() + 8, payloadSize - 8, m_data.data(), outSize);
+    }
+    else
+    {
+        res = Util::zlibDecompress(decrypted.constData(), payloadSize, m_data.data(), outSize);
+    }
+
+    return (res == 0) ? ErrorCode::ERR_NONE : ErrorCode::ERR_DECOMPRESS_FAILED;
+}
+
+void Script::writeDebugData(const char *data, int size)
+{
+    if (m_debug)
+    {
+        QFileInfo info(m_script);
+        QFile out("debug/" + info.fileName() + ".dbg");
+
+        out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        out.write(data, size);
+    }
 }
 
 int Script::findScriptHeader()
@@ -207,7 +354,7 @@ void Script::readPages()
 
     int prevEnd = 0;
 
-    // get address for each page and read it
+    // get address for each page
     for (int i = 0; i < m_scriptHeader.codePagesSize; i++)
     {
         int address;
@@ -217,124 +364,288 @@ void Script::readPages()
         m_pageLocations.push_back(address);
 
         prevEnd = address + 0x4000;
+    }
 
-        readPage(address, i);
+    m_pagesContiguous = true;
+
+    for (int i = 0; i < m_scriptHeader.codePagesSize; i++)
+    {
+        m_pagesContiguous &= (m_pageLocations[i] == m_pageLocations[0] + i * 0x4000);
+        m_pagesByLocation.push_back(std::make_pair(m_pageLocations[i], i));
     }
+
+    std::sort(m_pagesByLocation.begin(), m_pagesByLocation.end());
+
+    // instructions never straddle a page, so every page decodes on its own
+    int pages = m_scriptHeader.codePagesSize;
+
+    std::vector<InstructionStream> decoded(pages);
+    std::vector<char> valid(pages);
+
+    Util::parallelFor(pages, s_decodeThreads.load(), [&](int page)
+    {
+        valid[page] = readPage(m_pageLocations[page], page, decoded[page]);
+    });
+
+    // merge in page order, numbering functions as a sequential decode would
+    m_instructions.setData(m_data);
+    m_instructions.reserve(m_scriptHeader.codeSize / 2); // roughly two bytes per instruction
+
+    for (int page = 0; page < pages; page++)
+    {
+        for (auto func : decoded[page].getFuncs())
+        {
+            QString funcName = func.second;
+
+            if (funcName.isEmpty() && m_funcCount > 0)
+            {
+                funcName = "func_" + QString::number(m_funcCount).rightJustified(5, '0');
+            }
+            else if (m_funcCount == 0)
+            {
+                funcName = "__entrypoint";
+            }
+
+            m_instructions.addFunc(func.first, funcName);
+
+            m_funcCount++;
+        }
+
+        m_instructions.append(decoded[page]);
+
+        if (!valid[page])
+            m_error = ErrorCode::ERR_INVALID_SCRIPT;
+
+        decoded[page] = InstructionStream();
+    }
+
+    m_instructions.buildLabelIndex();
+    m_instructions.buildAddressIndex(m_pageLocations);
+
+    buildXrefs();
 }
 
-unsigned int Script::getPageByLocation(unsigned int location)
+void Script::buildXrefs()
 {
-    for (unsigned int i = 0; i < m_pageLocations.size(); i++)
+    for (const Instruction &ins : m_instructions)
     {
-        if (m_pageLocations[i] <= location && m_pageLocations[i] + 0x4000 >= location)
+        const OpcodeDesc &desc = ins.desc();
+
+        if (desc.operand == OPERAND_CALL)
+        {
+            int target = getCallTarget(ins);
+
+            if (target != -1)
+                m_xrefs.add(EXref::XREF_CALL, ins.index, getInstructionByLocation(target));
+        }
+        else if (desc.operand == OPERAND_JUMP)
+        {
+            int target = getInstructionByLocation(ins.jumpTarget());
+
+            if (target != -1)
+                m_xrefs.add(EXref::XREF_JUMP, ins.index, target);
+        }
+        else if (desc.operand == OPERAND_NATIVE)
         {
-            return i;
+            m_xrefs.add(EXref::XREF_NATIVE, ins.index, ((ins.u8(0) << 2) & 0x300) | ins.u8(1));
+        }
+        else if (desc.flags & OPF_STATIC)
+        {
+            m_xrefs.add(EXref::XREF_STATIC, ins.index, ins.u16(0));
+        }
+        else if (desc.flags & OPF_GLOBAL)
+        {
+            int global = (desc.operand == OPERAND_IMM24) ? (ins.u16(0) << 8) | ins.u8(2) : ins.u16(0);
+
+            m_xrefs.add(EXref::XREF_GLOBAL, ins.index, global);
         }
     }
 
-    return 0;
+    m_xrefs.build();
 }
 
-void Script::readPage(int address, int page)
+int Script::getDecodeThreadCount()
 {
-    QDataStream stream(m_data);
+    return s_decodeThreads;
+}
+
+void Script::setDecodeThreadCount(int count)
+{
+    s_decodeThreads = count;
+}
+
+ScriptView Script::getView() const
+{
+    return ScriptView(*this);
+}
+
+int Script::getPageByLocation(unsigned int location) const
+{
+    if (m_pageLocations.empty())
+        return -1;
+
+    if (m_pagesContiguous)
+    {
+        unsigned int page = (location - m_pageLocations[0]) >> 14;
+
+        return (location >= m_pageLocations[0] && page < m_pageLocations.size()) ? (int)page : -1;
+    }
+
+    auto next = std::upper_bound(m_pagesByLocation.begin(), m_pagesByLocation.end(), std::make_pair(location, INT_MAX));
+
+    if (next == m_pagesByLocation.begin() || location - (next - 1)->first >= 0x4000)
+        return -1;
+
+    return (next - 1)->second;
+}
+
+int Script::getLocationByAddress(unsigned int address) const
+{
+    unsigned int page = address >> 14;
+
+    return (page < m_pageLocations.size()) ? (int)(m_pageLocations[page] + (address & 0x3FFF)) : -1;
+}
+
+int Script::getAddressByLocation(unsigned int location) const
+{
+    int page = getPageByLocation(location);
+
+    return (page == -1) ? -1 : (int)((page << 14) | (location - m_pageLocations[page]));
+}
+
+int Script::getInstructionByLocation(unsigned int location) const
+{
+    int address = getAddressByLocation(location);
+
+    return (address == -1) ? -1 : m_instructions.indexOf(address);
+}
+
+int Script::getCallAddress(const Instruction &ins) const
+{
+    return ins.u16(0) | (ins.op - EOpcodes::OP_CALL2) << 0x10;
+}
+
+int Script::getCallTarget(const Instruction &ins) const
+{
+    int location = getLocationByAddress(getCallAddress(ins));
+
+    return (location == -1 || m_instructions.getFuncs().count(location) == 0) ? -1 : location;
+}
 
-    stream.device()->seek(address);
+bool Script::readPage(int address, int page, InstructionStream &instructions) const
+{
+    const unsigned char *code = (const unsigned char*)m_data.constData();
 
     // set length to 0x4000, unless last page, then set length to remainder
     int length = (page == m_scriptHeader.codePagesSize - 1) ? m_scriptHeader.codeSize % 0x4000 : 0x4000;
     int jumpCount = 0;
+    int pos = address;
 
-    while (stream.device()->pos() < address + length)
+    instructions.setData(m_data);
+    instructions.reserve(length / 2);
+
+    while (pos < address + length)
     {
-        unsigned char opcode;
-        ReadVar(opcode);
+        byte opcode = (pos < m_data.size()) ? code[pos] : 0xFF;
+
+        int operandSize = (opcode < OPCODE_COUNT) ? InstructionStream::readOperandSize(opcode, code + pos + 1, m_data.size() - pos - 1) : -1;
 
-        auto op = OpcodeFactory::Create((EOpcodes)opcode);
+        // unknown opcode, or the instruction runs past the data
+        if (operandSize == -1)
+            return false;
 
-        op->read(&stream);
-        op->setPage(page);
+        int index = instructions.append(pos, opcode, operandSize, page);
+        const OpcodeDesc &desc = opcodeDesc(opcode);
 
-        if (op->getOp() == EOpcodes::OP_ENTER)
+        if (desc.operand == OPERAND_ENTER)
         {
-            m_opcodes.push_back(OpcodeFactory::Create((EOpcodes)EOpcodes::_SPACER));
+            // named once every page is decoded, the numbering runs across pages
+            instructions.addFunc(pos, Op_Enter::formatData(instructions.at(index).operandData()));
+        }
+        else if (desc.operand == OPERAND_STRING)
+        {
+            instructions.addString(index);
+        }
+        else if (desc.operand == OPERAND_JUMP)
+        {
+            instructions.addLabel(instructions.at(index).jumpTarget(), jumpCount);
 
-            QString funcName;
+            jumpCount++;
+        }
 
-            std::shared_ptr<Op_Enter> enter = std::dynamic_pointer_cast<Op_Enter>(op);
+        pos += 1 + operandSize;
+    }
 
-            if (op->getFormattedData().isEmpty() && m_funcCount > 0)
-            {
-                funcName = "func_" + QString::number(m_funcCount).rightJustified(5, '0');
-            }
-            else if (m_funcCount == 0)
-            {
-                funcName = "__entrypoint";
-            }
-            else
-            {
-                funcName = op->getFormattedData();
-            }
+    return true;
+}
+
+void Script::buildOpcodes()
+{
+    if (m_opcodesBuilt)
+        return;
 
-            m_funcs.insert(std::pair<unsigned int, std::shared_ptr<Op_Enter>>(op->getLocation(), enter));
+    m_opcodesBuilt = true;
 
-            enter->setFuncName(funcName);
+    QDataStream stream(m_data);
 
-            op = enter;
+    for (const Instruction &ins : m_instructions)
+    {
+        auto op = OpcodeFactory::Create((EOpcodes)ins.op);
 
-            m_funcCount++;
+        if (ins.desc().size == 0)
+        {
+            // variable length opcodes work out their own size
+            stream.device()->seek(ins.location + 1);
+            op->read(&stream);
+        }
+        else
+        {
+            op->setLocation(ins.location);
+            op->setData(QByteArray((const char*)ins.operand, ins.operandSize));
+        }
+
+        op->setPage(ins.page);
+
+        if (ins.desc().operand == OPERAND_ENTER)
+        {
+            std::shared_ptr<Op_Enter> enter = std::dynamic_pointer_cast<Op_Enter>(op);
+
+            enter->setFuncName(m_instructions.getFuncs().at(ins.location));
+
+            m_funcs.insert(std::pair<unsigned int, std::shared_ptr<Op_Enter>>(ins.location, enter));
         }
-        else if (op->getOp() == EOpcodes::OP_SPUSH || op->getOp() == EOpcodes::OP_SPUSHL)
+        else if (ins.desc().operand == OPERAND_STRING)
         {
             m_strings.push_back(op);
         }
-        else if (op->getOp() >= EOpcodes::OP_JMP && op->getOp() <= EOpcodes::OP_JMPGT)
+        else if (ins.desc().operand == OPERAND_JUMP)
         {
-            int jumpPos = op->getData()[1] + op->getLocation() + 3;
-            std::shared_ptr<Op_HSub> jump;
+            unsigned int jumpPos = ins.jumpTarget();
 
             if (m_jumps.count(jumpPos) == 0)
             {
-                jump = std::dynamic_pointer_cast<Op_HSub>(OpcodeFactory::Create(EOpcodes::_SUB));
+                auto jump = std::dynamic_pointer_cast<Op_HSub>(OpcodeFactory::Create(EOpcodes::_SUB));
 
-                jump->setSub(jumpCount);
+                jump->setSub(m_instructions.getLabels().at(jumpPos));
                 jump->setLocation(jumpPos);
-                jump->addReference(op);
 
-                m_jumps.insert(std::pair<int, std::shared_ptr<Op_HSub>>(jumpPos, jump));
+                m_jumps.insert(std::pair<unsigned int, std::shared_ptr<Op_HSub>>(jumpPos, jump));
             }
-            else
-            {
-                jump = m_jumps.at(jumpPos);
 
-                jump->addReference(op);
-            }
-
-            jumpCount++;
+            m_jumps.at(jumpPos)->addReference(op);
         }
 
         m_opcodes.push_back(op);
     }
-}
-
-void Script::insertJumps()
-{
-    auto temp(m_jumps); // save jumps
 
-    for (int i = 0; i < m_opcodes.size(); i++)
+    // calls can only be linked once every function has its opcode
+    for (int target : m_xrefs.getTargets(EXref::XREF_CALL))
     {
-        auto op = m_opcodes[i];
+        auto func = m_funcs.at(m_instructions.at(target).location);
 
-        if (m_jumps.count(op->getLocation()) != 0)
+        for (int ref : m_xrefs.getRefsTo(EXref::XREF_CALL, target))
         {
-            auto jump = m_jumps.at(op->getLocation());
-
-            m_opcodes.insert(i, jump);
-
-            // clear jump at current location, otherwise program gets stuck in an infinite loop
-            m_jumps.erase(op->getLocation());
+            func->addReference(m_opcodes[ref]);
         }
     }
-
-    m_jumps = temp; // restore jumps
 }
@@ -5,9 +5,14 @@
 #include <QFile>
 #include <QString>
 
+#include "instructionstream.h"
+#include "xrefindex.h"
 #include "opcodefactory.h"
 #include "../rage/opcodes/helper.h"
 #include "../rage/opcodes/enter.h"
+#include "../util/util.h"
+
+class ScriptView;
 
 struct ResourceHeader
 {
@@ -21,8 +26,8 @@ struct ResourceHeader
     int _f14_30;
     bool extended;
 
-    int getSizeV() { return extended ? (vSize << 12) : ((int)(flags1 & 0x7FF) << ((int)((flags1 >> 11) & 15) + 8)); }
-    int getSizeP() { return extended ? (pSize << 12) : ((int)((flags1 >> 15) & 0x7FF) << ((int)((flags1 >> 26) & 15) + 8)); }
+    int getSizeV() const { return extended ? (vSize << 12) : ((int)(flags1 & 0x7FF) << ((int)((flags1 >> 11) & 15) + 8)); }
+    int getSizeP() const { return extended ? (pSize << 12) : ((int)((flags1 >> 15) & 0x7FF) << ((int)((flags1 >> 26) & 15) + 8)); }
 };
 
 struct ScriptHeader
@@ -54,49 +59,97 @@ enum ScriptType
     TYPE_PS3
 };
 
+enum LoadMode
+{
+    LOAD_READALL, // read the whole file into memory before extracting
+    LOAD_MAPPED   // map the file read-only and extract straight from the mapping
+};
+
+struct LoadStats
+{
+    qint64 fileSize    = 0;
+    qint64 bytesCopied = 0; // bytes duplicated between the file and the extracted data
+    qint64 dataSize    = 0; // size of the extracted data
+    qint64 decodeTime  = 0; // nanoseconds spent decoding the code pages
+};
+
 class Script
 {
 public:
-    Script(QString path, bool debug = false);
+    Script(QString path, bool debug = false, LoadMode mode = LoadMode::LOAD_READALL);
+
+    // from data already taken out of its resource, such as a script built in memory
+    Script(const QByteArray &data, ScriptType type);
+
+    ErrorCode getError() const { return m_error; }
+    bool isValid() const { return m_error == ErrorCode::ERR_NONE; }
 
-    ScriptType getScriptType() { return m_scriptType; }
+    ScriptType getScriptType() const { return m_scriptType; }
 
-    QByteArray getData() { return m_data; };
+    const QByteArray &getData() const { return m_data; }
 
-    ResourceHeader getResourceHeader() { return m_header;       }
-    ScriptHeader   getScriptHeader()   { return m_scriptHeader; }
+    LoadStats getLoadStats() const { return m_loadStats; }
 
-    QVector<std::shared_ptr<IOpcode>>     getOpcodes() { return m_opcodes; }
-    std::vector<std::shared_ptr<IOpcode>> getStrings() { return m_strings; }
+    const ResourceHeader &getResourceHeader() const { return m_header;       }
+    const ScriptHeader   &getScriptHeader()   const { return m_scriptHeader; }
 
-    QVector<unsigned int> getNatives() { return m_natives; }
-    QVector<int> getStatics() { return m_statics; }
+    // read-only access that any number of threads can share
+    ScriptView getView() const;
 
-    std::map<unsigned int, std::shared_ptr<Op_HSub>>  getJumps() { return m_jumps; }
-    std::map<unsigned int, std::shared_ptr<Op_Enter>> getFuncs() { return m_funcs; }
+    // decoded code pages, without any opcode objects
+    const InstructionStream &getInstructions() const { return m_instructions; }
 
-    unsigned int getFuncCount() { return m_funcCount; }
+    // calls, jumps, natives, statics and globals by instruction index, built while loading
+    const XrefIndex &getXrefs() const { return m_xrefs; }
 
-    std::vector<unsigned int> getPageOffsets()   { return m_pageOffsets;   }
-    std::vector<unsigned int> getPageLocations() { return m_pageLocations; }
+    // opcode objects for editing and recompiling, built from the instructions on first use,
+    // one per instruction at the same index
+    const QVector<std::shared_ptr<IOpcode>>     &getOpcodes() { buildOpcodes(); return m_opcodes; }
+    const std::vector<std::shared_ptr<IOpcode>> &getStrings() { buildOpcodes(); return m_strings; }
 
-    unsigned int getPageByLocation(unsigned int location);
+    const QVector<unsigned int> &getNatives() const { return m_natives; }
+    const QVector<int>          &getStatics() const { return m_statics; }
+
+    const std::map<unsigned int, std::shared_ptr<Op_HSub>>  &getJumps() { buildOpcodes(); return m_jumps; }
+    const std::map<unsigned int, std::shared_ptr<Op_Enter>> &getFuncs() { buildOpcodes(); return m_funcs; }
+
+    unsigned int getFuncCount() const { return m_funcCount; }
+
+    const std::vector<unsigned int> &getPageOffsets()   const { return m_pageOffsets;   }
+    const std::vector<unsigned int> &getPageLocations() const { return m_pageLocations; }
+
+    // locations are offsets into the script data, addresses are what the code itself uses: page << 14 | offset
+    int getPageByLocation(unsigned int location) const;        // -1 outside the code pages
+    int getLocationByAddress(unsigned int address) const;      // -1 past the last page
+    int getAddressByLocation(unsigned int location) const;     // -1 outside the code pages
+    int getInstructionByLocation(unsigned int location) const; // index of the instruction starting there, -1 if none
+
+    static int getDecodeThreadCount();
+    static void setDecodeThreadCount(int count); // code pages are decoded on this many threads, 0 uses the core count
+
+    int getCallAddress(const Instruction &ins) const; // address a call2 instruction points at
+    int getCallTarget(const Instruction &ins) const;  // function location, -1 if no function starts there
 
 private:
     // Extract script from RSC container
-    bool readRSCHeader();
-    void extractData();
+    bool readRSCHeader(const QByteArray &data);
+    ErrorCode extractData();
+    ErrorCode extractMapped(const uchar *file, qint64 size);
+
+    void writeDebugData(const char *data, int size);
 
     // Read script data
+    void readScript();
     int  findScriptHeader();
     void readScriptHeader(int headerPos);
     void readNatives();
     void readStatics();
 
     void readPages();
-    void readPage(int address, int page);
+    bool readPage(int address, int page, InstructionStream &instructions) const;
+    void buildXrefs();
 
-    void insertJumps();
+    void buildOpcodes();
 
     // Resource data
     ResourceHeader m_header;
@@ -109,10 +162,16 @@ private:
     std::vector<unsigned int> m_pageOffsets;
     std::vector<unsigned int> m_pageLocations;
 
+    bool m_pagesContiguous; // each page directly follows the one before, so a shift finds the page
+    std::vector<std::pair<unsigned int, int>> m_pagesByLocation; // sorted, for when they don't
+
+    InstructionStream m_instructions;
+    XrefIndex m_xrefs;
+
     QVector<std::shared_ptr<IOpcode>> m_opcodes;
+    bool m_opcodesBuilt;
 
     unsigned int m_funcCount;
-    std::map<int, QString> m_funcNames;
 
     std::vector<std::shared_ptr<IOpcode>> m_strings;
 
@@ -123,6 +182,8 @@ private:
     QByteArray m_data;
     QFile m_script;
     ScriptType m_scriptType;
+    LoadStats m_loadStats;
+    ErrorCode m_error;
     bool m_debug;
 };
 
@@ -0,0 +1,51 @@
+#ifndef SCRIPTVIEW_H
+#define SCRIPTVIEW_H
+
+#include "script.h"
+
+// Read-only view of a loaded script. Everything it hands out was decoded while
+// loading and never changes afterwards, so any number of threads can share one
+// view without copies or locks. The opcode objects are left out on purpose,
+// they are built on first use and are only meant for the editor.
+//
+// The view must not outlive its script.
+class ScriptView
+{
+public:
+    explicit ScriptView(const Script &script) : m_script(&script) {}
+
+    const Script &getScript() const { return *m_script; }
+
+    ScriptType getScriptType() const { return m_script->getScriptType(); }
+
+    const QByteArray     &getData()           const { return m_script->getData();           }
+    const ResourceHeader &getResourceHeader() const { return m_script->getResourceHeader(); }
+    const ScriptHeader   &getScriptHeader()   const { return m_script->getScriptHeader();   }
+
+    const QVector<unsigned int> &getNatives() const { return m_script->getNatives(); }
+    const QVector<int>          &getStatics() const { return m_script->getStatics(); }
+
+    const InstructionStream &getInstructions() const { return m_script->getInstructions(); }
+    const XrefIndex         &getXrefs()        const { return m_script->getXrefs();        }
+
+    const std::map<unsigned int, QString> &getFuncs()  const { return getInstructions().getFuncs();  }
+    const std::map<unsigned int, int>     &getLabels() const { return getInstructions().getLabels(); }
+
+    unsigned int getFuncCount() const { return m_script->getFuncCount(); }
+
+    const std::vector<unsigned int> &getPageOffsets()   const { return m_script->getPageOffsets();   }
+    const std::vector<unsigned int> &getPageLocations() const { return m_script->getPageLocations(); }
+
+    int getPageByLocation(unsigned int location) const        { return m_script->getPageByLocation(location);        }
+    int getLocationByAddress(unsigned int address) const      { return m_script->getLocationByAddress(address);      }
+    int getAddressByLocation(unsigned int location) const     { return m_script->getAddressByLocation(location);     }
+    int getInstructionByLocation(unsigned int location) const { return m_script->getInstructionByLocation(location); }
+
+    int getCallAddress(const Instruction &ins) const { return m_script->getCallAddress(ins); }
+    int getCallTarget(const Instruction &ins) const  { return m_script->getCallTarget(ins);  }
+
+private:
+    const Script *m_script;
+};
+
+#endif // SCRIPTVIEW_H
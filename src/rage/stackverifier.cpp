@@ -0,0 +1,295 @@
+#include "stackverifier.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "iopcode.h"
+#include "../util/util.h"
+
+static const int UNKNOWN = INT_MIN; // stack slot that isn't a known constant
+
+StackVerifier::StackVerifier(const InstructionStream &instructions, const std::vector<unsigned int> &pageLocations)
+    : m_instructions(instructions)
+    , m_pageLocations(pageLocations)
+{
+    // a function runs up to the next enter, and returns as many results as its first return
+    for (const Instruction &ins : m_instructions)
+    {
+        if (ins.op >= OPCODE_COUNT)
+            continue;
+
+        if (ins.desc().operand == OPERAND_ENTER)
+        {
+            if (!m_funcs.empty())
+                m_funcs.back().last = ins.index;
+
+            m_funcs.push_back({ ins.index, m_instructions.size(), -1 });
+        }
+        else if ((ins.desc().flags & OPF_RETURN) && !m_funcs.empty() && m_funcs.back().results == -1)
+        {
+            m_funcs.back().results = (ins.desc().operand == OPERAND_RET) ? ins.u8(1) : ins.desc().pops;
+        }
+    }
+
+    for (Function &func : m_funcs)
+    {
+        func.results = std::max(func.results, 0);
+    }
+}
+
+bool StackVerifier::verify(int threadCount)
+{
+    m_depths.assign(m_instructions.size(), -1);
+    m_issues.clear();
+
+    int funcs = (int)m_funcs.size();
+
+    std::vector<std::vector<StackIssue>> issues(funcs);
+
+    // functions only write their own instructions' depths
+    Util::parallelFor(funcs, threadCount, [&](int func)
+    {
+        verifyFunction(m_funcs[func], issues[func]);
+    });
+
+    for (auto &funcIssues : issues)
+    {
+        std::stable_sort(funcIssues.begin(), funcIssues.end(), [](const StackIssue &a, const StackIssue &b) { return a.index < b.index; });
+
+        m_issues.insert(m_issues.end(), funcIssues.begin(), funcIssues.end());
+    }
+
+    return getErrorCount() == 0;
+}
+
+int StackVerifier::getErrorCount() const
+{
+    return (int)std::count_if(m_issues.begin(), m_issues.end(), [](const StackIssue &issue) { return issue.kind != STACK_UNKNOWN; });
+}
+
+QString StackVerifier::issueToString(const StackIssue &issue) const
+{
+    Instruction ins = m_instructions.at(issue.index);
+
+    QString where = QString("%1 %2: ").arg(IOpcode::formatLocation(ins.page, ins.location))
+                                      .arg(ins.op < OPCODE_COUNT ? ins.desc().name : "???");
+
+    switch (issue.kind)
+    {
+        case STACK_UNDERFLOW:  return where + QString("stack underflow, depth %1 but takes %2").arg(issue.depth).arg(issue.expected);
+        case STACK_MISMATCH:   return where + QString("reached with depth %1 and %2").arg(issue.depth).arg(issue.expected);
+        case STACK_RETURN:     return where + QString("returns with depth %1 instead of %2").arg(issue.depth).arg(issue.expected);
+        case STACK_BAD_TARGET: return where + "branch or call to an invalid target";
+        case STACK_FALLS_OFF:  return where + "falls off the end of the function";
+        case STACK_UNKNOWN:    return where + "stack effect unknown, not followed";
+    }
+
+    return where;
+}
+
+int StackVerifier::getFunction(int index) const
+{
+    auto func = std::lower_bound(m_funcs.begin(), m_funcs.end(), index, [](const Function &f, int i) { return f.first < i; });
+
+    return (func != m_funcs.end() && func->first == index) ? (int)(func - m_funcs.begin()) : -1;
+}
+
+int StackVerifier::getTarget(const Instruction &ins, unsigned int location) const
+{
+    // by address, as the vm does, so a branch may run over into the next page
+    unsigned int address = (ins.page << 14) + (ins.location - m_pageLocations[ins.page]) + (location - ins.location);
+
+    return m_instructions.indexOf(address);
+}
+
+void StackVerifier::verifyFunction(const Function &func, std::vector<StackIssue> &issues)
+{
+    int count = func.last - func.first;
+    int *depth = m_depths.data() + func.first;
+
+    std::vector<int> top0(count, UNKNOWN), top1(count, UNKNOWN);
+    std::vector<char> queued(count, 0), visited(count, 0), mismatched(count, 0);
+    std::vector<int> work;
+
+    // merges the state coming from a predecessor, queueing the instruction when it changes
+    auto flow = [&](int to, int d, int t0, int t1)
+    {
+        if (depth[to] == -1)
+        {
+            depth[to] = d;
+            top0[to] = t0;
+            top1[to] = t1;
+        }
+        else if (depth[to] != d)
+        {
+            if (!mismatched[to])
+                issues.push_back({ func.first + to, STACK_MISMATCH, d, depth[to] });
+
+            mismatched[to] = 1;
+            return;
+        }
+        else if ((top0[to] == t0 || top0[to] == UNKNOWN) && (top1[to] == t1 || top1[to] == UNKNOWN))
+        {
+            return;
+        }
+        else
+        {
+            top0[to] = (top0[to] == t0) ? t0 : UNKNOWN;
+            top1[to] = (top1[to] == t1) ? t1 : UNKNOWN;
+        }
+
+        if (!queued[to])
+            work.push_back(to);
+
+        queued[to] = 1;
+    };
+
+    if (count > 0)
+        flow(0, 0, UNKNOWN, UNKNOWN);
+
+    // an instruction is only requeued when a constant it knew turns unknown, at most twice
+    while (!work.empty())
+    {
+        int i = work.back();
+        work.pop_back();
+        queued[i] = 0;
+
+        Instruction ins = m_instructions.at(func.first + i);
+        int d = depth[i];
+
+        bool first = !visited[i];
+        visited[i] = 1;
+
+        auto report = [&](EStackIssue kind, int dep, int expected)
+        {
+            if (first)
+                issues.push_back({ ins.index, kind, dep, expected });
+        };
+
+        if (ins.op >= OPCODE_COUNT)
+        {
+            report(STACK_UNKNOWN, d, -1);
+            continue;
+        }
+
+        const OpcodeDesc &desc = ins.desc();
+
+        int pops   = desc.pops;
+        int pushes = desc.pushes;
+
+        if (desc.operand == OPERAND_NATIVE)
+        {
+            pops   = (ins.u8(0) & 0x3e) >> 1;
+            pushes = ins.u8(0) & 1;
+        }
+        else if (desc.operand == OPERAND_RET)
+        {
+            pops   = ins.u8(1);
+            pushes = 0;
+        }
+        else if (desc.operand == OPERAND_CALL)
+        {
+            int callee = getFunction(m_instructions.indexOf(ins.u16(0) | (ins.op - EOpcodes::OP_CALL2) << 16));
+
+            if (callee == -1)
+            {
+                report(STACK_BAD_TARGET, d, -1);
+                continue;
+            }
+
+            pops   = m_instructions.at(m_funcs[callee].first).u8(0);
+            pushes = m_funcs[callee].results;
+        }
+        else if (ins.op == EOpcodes::OP_TOSTACK || ins.op == EOpcodes::OP_FROMSTACK)
+        {
+            // pointer on top, the slot count below it
+            if (top1[i] == UNKNOWN || top1[i] < 0)
+            {
+                report(STACK_UNKNOWN, d, -1);
+                continue;
+            }
+
+            pops   = (ins.op == EOpcodes::OP_FROMSTACK) ? 2 + top1[i] : 2;
+            pushes = (ins.op == EOpcodes::OP_TOSTACK)   ? top1[i]     : 0;
+        }
+        else if (pops == -1)
+        {
+            report(STACK_UNKNOWN, d, -1);
+            continue;
+        }
+
+        if (d < pops)
+        {
+            report(STACK_UNDERFLOW, d, pops);
+            continue;
+        }
+
+        if (desc.flags & OPF_RETURN)
+        {
+            if (d != pops)
+                report(STACK_RETURN, d, pops);
+
+            continue;
+        }
+
+        // constants pushed, the last one on top
+        int pushed[2] = { UNKNOWN, UNKNOWN };
+
+        switch (ins.op)
+        {
+        case EOpcodes::OP_PUSH1B: pushed[0] = ins.u8(0);                             break;
+        case EOpcodes::OP_PUSH2B: pushed[0] = ins.u8(1); pushed[1] = ins.u8(0);      break;
+        case EOpcodes::OP_PUSH3B: pushed[0] = ins.u8(2); pushed[1] = ins.u8(1);      break;
+        case EOpcodes::OP_IPUSH:  pushed[0] = ins.u32(0);                            break;
+        case EOpcodes::OP_IPUSH2: pushed[0] = ins.u16(0);                            break;
+        case EOpcodes::OP_IPUSH3: pushed[0] = (ins.u16(0) << 8) | ins.u8(2);         break;
+        default:
+            if (ins.op >= EOpcodes::OP_PUSHNEG1 && ins.op <= EOpcodes::OP_PUSH7)
+                pushed[0] = ins.op - EOpcodes::OP_PUSH0;
+            break;
+        }
+
+        int before[2] = { top0[i], top1[i] };
+        int after[2];
+
+        for (int j = 0; j < 2; j++)
+        {
+            if (j < pushes)
+                after[j] = pushed[j];
+            else
+                after[j] = (j - pushes + pops < 2) ? before[j - pushes + pops] : UNKNOWN;
+        }
+
+        int next = d - pops + pushes;
+
+        auto branch = [&](unsigned int location)
+        {
+            int target = getTarget(ins, location) - func.first;
+
+            if (target < 0 || target >= count)
+                report(STACK_BAD_TARGET, d, -1);
+            else
+                flow(target, next, after[0], after[1]);
+        };
+
+        if (desc.operand == OPERAND_JUMP)
+        {
+            branch(ins.jumpTarget());
+        }
+        else if (desc.operand == OPERAND_SWITCH)
+        {
+            for (int c = 0; c < ins.switchCount(); c++)
+            {
+                branch(ins.switchTarget(c));
+            }
+        }
+
+        if (desc.flags & OPF_TERMINATOR)
+            continue;
+
+        if (i + 1 < count)
+            flow(i + 1, next, after[0], after[1]);
+        else
+            report(STACK_FALLS_OFF, d, -1);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef STACKVERIFIER_H
+#define STACKVERIFIER_H
+
+#include <vector>
+
+#include <QString>
+
+#include "instructionstream.h"
+
+enum EStackIssue
+{
+    STACK_UNDERFLOW,  // pops more than the function has pushed
+    STACK_MISMATCH,   // paths reach the instruction with different depths
+    STACK_RETURN,     // returns with a depth other than its result count
+    STACK_BAD_TARGET, // jump, case or call that doesn't land where it should
+    STACK_FALLS_OFF,  // runs off the end of the function
+    STACK_UNKNOWN     // effect can't be worked out statically, the path isn't followed further
+};
+
+struct StackIssue
+{
+    int index; // instruction
+    EStackIssue kind;
+    int depth;    // depth before the instruction
+    int expected; // depth the instruction needed, or the other path brought
+};
+
+// Works out the stack depth before every instruction of every function and
+// reports where it doesn't add up. Each function starts empty, its parameters
+// having been moved into the frame by enter.
+//
+// Only the top two stack slots are tracked beyond the depth, as constants, so
+// the counts of tostack and fromstack can be found when pushed just before.
+class StackVerifier
+{
+public:
+    // the stream must have its address index built over the given pages
+    StackVerifier(const InstructionStream &instructions, const std::vector<unsigned int> &pageLocations);
+
+    // checks every function on threadCount threads (0 uses the core count), true if every effect could be
+    // followed without an error
+    bool verify(int threadCount = 0);
+
+    // in instruction order, the unknown ones included
+    const std::vector<StackIssue> &getIssues() const { return m_issues; }
+    int getErrorCount() const; // issues other than STACK_UNKNOWN
+
+    int getDepth(int index) const { return m_depths[index]; } // -1 if never reached
+
+    QString issueToString(const StackIssue &issue) const; // location, instruction and what's wrong
+
+private:
+    struct Function
+    {
+        int first;
+        int last;
+        int results; // of its first return, 0 if it never returns
+    };
+
+    void verifyFunction(const Function &func, std::vector<StackIssue> &issues);
+
+    int getFunction(int index) const; // function whose enter is the instruction, -1 if none
+    int getTarget(const Instruction &ins, unsigned int address) const;
+
+    const InstructionStream &m_instructions;
+    const std::vector<unsigned int> &m_pageLocations;
+
+    std::vector<Function> m_funcs;
+    std::vector<int> m_depths;
+
+    std::vector<StackIssue> m_issues;
+};
+
+#endif // STACKVERIFIER_H
@@ -0,0 +1,84 @@
+#include "xrefindex.h"
+
+#include <algorithm>
+
+void XrefIndex::add(EXref kind, int source, int target)
+{
+    m_tables[kind].sources.push_back(source);
+    m_tables[kind].targets.push_back(target);
+}
+
+void XrefIndex::build()
+{
+    for (Table &table : m_tables)
+    {
+        table.keys = table.targets;
+
+        std::sort(table.keys.begin(), table.keys.end());
+        table.keys.erase(std::unique(table.keys.begin(), table.keys.end()), table.keys.end());
+
+        std::vector<int> rows(table.targets.size());
+
+        table.offsets.assign(table.keys.size() + 1, 0);
+
+        for (size_t i = 0; i < table.targets.size(); i++)
+        {
+            rows[i] = (int)(std::lower_bound(table.keys.begin(), table.keys.end(), table.targets[i]) - table.keys.begin());
+            table.offsets[rows[i] + 1]++;
+        }
+
+        for (size_t row = 1; row < table.offsets.size(); row++)
+        {
+            table.offsets[row] += table.offsets[row - 1];
+        }
+
+        // sources ascend, so every row stays in instruction order
+        std::vector<int> next(table.offsets.begin(), table.offsets.end() - 1);
+
+        table.refs.resize(table.sources.size());
+
+        for (size_t i = 0; i < table.sources.size(); i++)
+        {
+            table.refs[next[rows[i]]++] = table.sources[i];
+        }
+    }
+}
+
+IndexRange XrefIndex::getRefsTo(EXref kind, int target) const
+{
+    const Table &table = m_tables[kind];
+
+    auto key = std::lower_bound(table.keys.begin(), table.keys.end(), target);
+
+    if (key == table.keys.end() || *key != target)
+        return { nullptr, nullptr };
+
+    int row = (int)(key - table.keys.begin());
+
+    return { table.refs.data() + table.offsets[row], table.refs.data() + table.offsets[row + 1] };
+}
+
+int XrefIndex::getTarget(EXref kind, int source) const
+{
+    const Table &table = m_tables[kind];
+
+    auto it = std::lower_bound(table.sources.begin(), table.sources.end(), source);
+
+    if (it == table.sources.end() || *it != source)
+        return -1;
+
+    return table.targets[it - table.sources.begin()];
+}
+
+qint64 XrefIndex::memoryUsage() const
+{
+    qint64 size = 0;
+
+    for (const Table &table : m_tables)
+    {
+        size += (table.sources.capacity() + table.targets.capacity() + table.keys.capacity()
+               + table.offsets.capacity() + table.refs.capacity()) * sizeof(int);
+    }
+
+    return size;
+}
@@ -0,0 +1,58 @@
+#ifndef XREFINDEX_H
+#define XREFINDEX_H
+
+#include <vector>
+
+#include <QtGlobal>
+
+#include "instructionstream.h"
+
+enum EXref
+{
+    XREF_CALL,   // call2 to the enter instruction it lands on
+    XREF_JUMP,   // jump to the instruction it lands on
+    XREF_NATIVE, // native call to its slot in the native table
+    XREF_STATIC, // static access to the static index
+    XREF_GLOBAL, // global access to the global index
+    XREF_COUNT
+};
+
+// Cross references of a script in both directions. Each kind keeps the
+// referencing instructions with their target in instruction order, and the
+// same pairs grouped by target as compressed rows (a sorted key list, offsets
+// into one array of instruction indices), so both lookups cost a binary
+// search plus the number of references.
+class XrefIndex
+{
+public:
+    // sources must be added in ascending order for each kind, build once they all are
+    void add(EXref kind, int source, int target);
+    void build();
+
+    IndexRange getRefsTo(EXref kind, int target) const; // instructions referencing the target, in instruction order
+    int getTarget(EXref kind, int source) const;       // target of an instruction, -1 if it has none of that kind
+
+    // every target with at least one reference, ascending
+    const std::vector<int> &getTargets(EXref kind) const { return m_tables[kind].keys; }
+
+    int count(EXref kind) const { return (int)m_tables[kind].sources.size(); }
+
+    qint64 memoryUsage() const;
+
+private:
+    struct Table
+    {
+        // source -> target
+        std::vector<int> sources;
+        std::vector<int> targets;
+
+        // target -> sources
+        std::vector<int> keys;
+        std::vector<int> offsets; // one more than keys
+        std::vector<int> refs;
+    };
+
+    Table m_tables[XREF_COUNT];
+};
+
+#endif // XREFINDEX_H
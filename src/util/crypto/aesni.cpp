@@ -0,0 +1,227 @@
+#include "aesni.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define AESNI_X86
+#endif
+
+#ifdef AESNI_X86
+
+#include <wmmintrin.h>
+#include <emmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AESNI_TARGET
+#else
+#include <cpuid.h>
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+#endif
+
+int aesni_supported(void)
+{
+    unsigned int ecx;
+
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    ecx = (unsigned int)info[2];
+#else
+    unsigned int eax, ebx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+#endif
+
+    return (ecx & (1 << 25)) != 0; // AES
+}
+
+AESNI_TARGET static __m128i aesni_shiftXor(__m128i k)
+{
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    return _mm_xor_si128(k, _mm_slli_si128(k, 4));
+}
+
+#define AESNI_EXPAND(i, rcon) \
+    t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k1, rcon), 0xff); \
+    k0 = _mm_xor_si128(aesni_shiftXor(k0), t); \
+    rk[i] = k0; \
+    if (i < 14) \
+    { \
+        t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k0, 0), 0xaa); \
+        k1 = _mm_xor_si128(aesni_shiftXor(k1), t); \
+        rk[i + 1] = k1; \
+    }
+
+AESNI_TARGET void aesni_init(aesni_context *ctx, const uint8_t *key)
+{
+    __m128i rk[15];
+    __m128i k0 = _mm_loadu_si128((const __m128i *)key);
+    __m128i k1 = _mm_loadu_si128((const __m128i *)(key + 16));
+    __m128i t;
+
+    rk[0] = k0;
+    rk[1] = k1;
+
+    AESNI_EXPAND(2,  0x01);
+    AESNI_EXPAND(4,  0x02);
+    AESNI_EXPAND(6,  0x04);
+    AESNI_EXPAND(8,  0x08);
+    AESNI_EXPAND(10, 0x10);
+    AESNI_EXPAND(12, 0x20);
+    AESNI_EXPAND(14, 0x40);
+
+    for (int i = 0; i < 15; i++)
+    {
+        _mm_storeu_si128((__m128i *)ctx->enckey[i], rk[i]);
+    }
+
+    _mm_storeu_si128((__m128i *)ctx->deckey[0], rk[14]);
+
+    for (int i = 1; i < 14; i++)
+    {
+        _mm_storeu_si128((__m128i *)ctx->deckey[i], _mm_aesimc_si128(rk[14 - i]));
+    }
+
+    _mm_storeu_si128((__m128i *)ctx->deckey[14], rk[0]);
+}
+
+// eight independent blocks per iteration hide the latency of each aes round
+#define AESNI_LANES 8
+
+#define AESNI_LOAD8(buf) \
+    __m128i s0 = _mm_loadu_si128((const __m128i *)(buf) + 0); \
+    __m128i s1 = _mm_loadu_si128((const __m128i *)(buf) + 1); \
+    __m128i s2 = _mm_loadu_si128((const __m128i *)(buf) + 2); \
+    __m128i s3 = _mm_loadu_si128((const __m128i *)(buf) + 3); \
+    __m128i s4 = _mm_loadu_si128((const __m128i *)(buf) + 4); \
+    __m128i s5 = _mm_loadu_si128((const __m128i *)(buf) + 5); \
+    __m128i s6 = _mm_loadu_si128((const __m128i *)(buf) + 6); \
+    __m128i s7 = _mm_loadu_si128((const __m128i *)(buf) + 7);
+
+#define AESNI_STORE8(buf) \
+    _mm_storeu_si128((__m128i *)(buf) + 0, s0); \
+    _mm_storeu_si128((__m128i *)(buf) + 1, s1); \
+    _mm_storeu_si128((__m128i *)(buf) + 2, s2); \
+    _mm_storeu_si128((__m128i *)(buf) + 3, s3); \
+    _mm_storeu_si128((__m128i *)(buf) + 4, s4); \
+    _mm_storeu_si128((__m128i *)(buf) + 5, s5); \
+    _mm_storeu_si128((__m128i *)(buf) + 6, s6); \
+    _mm_storeu_si128((__m128i *)(buf) + 7, s7);
+
+#define AESNI_ROUND8(op, k) \
+    s0 = op(s0, k); s1 = op(s1, k); s2 = op(s2, k); s3 = op(s3, k); \
+    s4 = op(s4, k); s5 = op(s5, k); s6 = op(s6, k); s7 = op(s7, k);
+
+AESNI_TARGET void aesni_encrypt_ecb(const aesni_context *ctx, uint8_t *buf, size_t blocks, int passes)
+{
+    __m128i rk[15];
+
+    for (int i = 0; i < 15; i++)
+        rk[i] = _mm_loadu_si128((const __m128i *)ctx->enckey[i]);
+
+    size_t b = 0;
+
+    for (; b + AESNI_LANES <= blocks; b += AESNI_LANES)
+    {
+        AESNI_LOAD8(buf + b * 16);
+
+        for (int p = 0; p < passes; p++)
+        {
+            AESNI_ROUND8(_mm_xor_si128, rk[0]);
+
+            for (int r = 1; r < 14; r++)
+            {
+                AESNI_ROUND8(_mm_aesenc_si128, rk[r]);
+            }
+
+            AESNI_ROUND8(_mm_aesenclast_si128, rk[14]);
+        }
+
+        AESNI_STORE8(buf + b * 16);
+    }
+
+    for (; b < blocks; b++)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(buf + b * 16));
+
+        for (int p = 0; p < passes; p++)
+        {
+            s = _mm_xor_si128(s, rk[0]);
+
+            for (int r = 1; r < 14; r++)
+                s = _mm_aesenc_si128(s, rk[r]);
+
+            s = _mm_aesenclast_si128(s, rk[14]);
+        }
+
+        _mm_storeu_si128((__m128i *)(buf + b * 16), s);
+    }
+}
+
+AESNI_TARGET void aesni_decrypt_ecb(const aesni_context *ctx, uint8_t *buf, size_t blocks, int passes)
+{
+    __m128i rk[15];
+
+    for (int i = 0; i < 15; i++)
+        rk[i] = _mm_loadu_si128((const __m128i *)ctx->deckey[i]);
+
+    size_t b = 0;
+
+    for (; b + AESNI_LANES <= blocks; b += AESNI_LANES)
+    {
+        AESNI_LOAD8(buf + b * 16);
+
+        for (int p = 0; p < passes; p++)
+        {
+            AESNI_ROUND8(_mm_xor_si128, rk[0]);
+
+            for (int r = 1; r < 14; r++)
+            {
+                AESNI_ROUND8(_mm_aesdec_si128, rk[r]);
+            }
+
+            AESNI_ROUND8(_mm_aesdeclast_si128, rk[14]);
+        }
+
+        AESNI_STORE8(buf + b * 16);
+    }
+
+    for (; b < blocks; b++)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(buf + b * 16));
+
+        for (int p = 0; p < passes; p++)
+        {
+            s = _mm_xor_si128(s, rk[0]);
+
+            for (int r = 1; r < 14; r++)
+                s = _mm_aesdec_si128(s, rk[r]);
+
+            s = _mm_aesdeclast_si128(s, rk[14]);
+        }
+
+        _mm_storeu_si128((__m128i *)(buf + b * 16), s);
+    }
+}
+
+#else // no AES-NI on this architecture
+
+int aesni_supported(void)
+{
+    return 0;
+}
+
+void aesni_init(aesni_context *, const uint8_t *)
+{
+}
+
+void aesni_encrypt_ecb(const aesni_context *, uint8_t *, size_t, int)
+{
+}
+
+void aesni_decrypt_ecb(const aesni_context *, uint8_t *, size_t, int)
+{
+}
+
+#endif
@@ -0,0 +1,33 @@
+/*
+*   AES-256 using the AES-NI instructions.
+*   Only usable when aesni_supported() returns non-zero, every other
+*   function must not be called otherwise.
+*/
+#ifndef AESNI_H
+#define AESNI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    typedef struct {
+        uint8_t enckey[15][16];
+        uint8_t deckey[15][16]; // equivalent inverse cipher schedule
+    } aesni_context;
+
+    int  aesni_supported(void);
+
+    void aesni_init(aesni_context *, const uint8_t * /* key */);
+
+    // runs every block through the cipher 'passes' times
+    void aesni_encrypt_ecb(const aesni_context *, uint8_t * /* plaintext */, size_t /* blocks */, int /* passes */);
+    void aesni_decrypt_ecb(const aesni_context *, uint8_t * /* ciphertext */, size_t /* blocks */, int /* passes */);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AESNI_H
@@ -0,0 +1,237 @@
+#include "aestable.h"
+
+#define ROR8(x) (((x) >> 8) | ((x) << 24))
+
+#define GETU32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define PUTU32(p, v) { (p)[0] = (uint8_t)((v) >> 24); (p)[1] = (uint8_t)((v) >> 16); (p)[2] = (uint8_t)((v) >> 8); (p)[3] = (uint8_t)(v); }
+
+#define B0(x) ((x) >> 24)
+#define B1(x) (((x) >> 16) & 0xff)
+#define B2(x) (((x) >> 8) & 0xff)
+#define B3(x) ((x) & 0xff)
+
+struct AesTables
+{
+    uint8_t  sbox[256];
+    uint8_t  sboxInv[256];
+    uint32_t te[4][256];
+    uint32_t td[4][256];
+
+    AesTables()
+    {
+        // sbox from the multiplicative inverse (walking generator 3) and the affine transform
+        uint8_t p = 1, q = 1;
+
+        do
+        {
+            p = p ^ (uint8_t)(p << 1) ^ ((p & 0x80) ? 0x1b : 0);
+
+            q ^= q << 1;
+            q ^= q << 2;
+            q ^= q << 4;
+
+            if (q & 0x80)
+                q ^= 0x09;
+
+            uint8_t x = q ^ rotl(q, 1) ^ rotl(q, 2) ^ rotl(q, 3) ^ rotl(q, 4);
+
+            sbox[p] = x ^ 0x63;
+        } while (p != 1);
+
+        sbox[0] = 0x63;
+
+        for (int i = 0; i < 256; i++)
+        {
+            sboxInv[sbox[i]] = (uint8_t)i;
+        }
+
+        for (int i = 0; i < 256; i++)
+        {
+            uint8_t s = sbox[i];
+            uint8_t v = sboxInv[i];
+
+            te[0][i] = ((uint32_t)mul(s, 2) << 24) | ((uint32_t)s << 16) | ((uint32_t)s << 8) | mul(s, 3);
+            td[0][i] = ((uint32_t)mul(v, 0x0e) << 24) | ((uint32_t)mul(v, 0x09) << 16) | ((uint32_t)mul(v, 0x0d) << 8) | mul(v, 0x0b);
+
+            for (int t = 1; t < 4; t++)
+            {
+                te[t][i] = ROR8(te[t - 1][i]);
+                td[t][i] = ROR8(td[t - 1][i]);
+            }
+        }
+    }
+
+    static uint8_t rotl(uint8_t x, int shift)
+    {
+        return (uint8_t)((x << shift) | (x >> (8 - shift)));
+    }
+
+    static uint8_t mul(uint8_t a, uint8_t b)
+    {
+        uint8_t result = 0;
+
+        while (b)
+        {
+            if (b & 1)
+                result ^= a;
+
+            a = (uint8_t)(a << 1) ^ ((a & 0x80) ? 0x1b : 0);
+            b >>= 1;
+        }
+
+        return result;
+    }
+};
+
+static const AesTables &tables()
+{
+    static const AesTables t; // built once, thread-safe
+    return t;
+}
+
+static uint32_t subWord(const AesTables &t, uint32_t w)
+{
+    return ((uint32_t)t.sbox[B0(w)] << 24) | ((uint32_t)t.sbox[B1(w)] << 16) | ((uint32_t)t.sbox[B2(w)] << 8) | t.sbox[B3(w)];
+}
+
+void aestable_init(aestable_context *ctx, const uint8_t *key)
+{
+    const AesTables &t = tables();
+    uint32_t *ek = ctx->enckey;
+    uint32_t *dk = ctx->deckey;
+    uint8_t rcon = 1;
+
+    for (int i = 0; i < 8; i++)
+    {
+        ek[i] = GETU32(key + i * 4);
+    }
+
+    for (int i = 8; i < 60; i++)
+    {
+        uint32_t temp = ek[i - 1];
+
+        if (i % 8 == 0)
+        {
+            temp = subWord(t, (temp << 8) | (temp >> 24)) ^ ((uint32_t)rcon << 24);
+            rcon = AesTables::mul(rcon, 2);
+        }
+        else if (i % 8 == 4)
+        {
+            temp = subWord(t, temp);
+        }
+
+        ek[i] = ek[i - 8] ^ temp;
+    }
+
+    // reverse the rounds and apply InvMixColumns to all but the first and last
+    for (int r = 0; r <= 14; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            uint32_t w = ek[(14 - r) * 4 + c];
+
+            if (r > 0 && r < 14)
+            {
+                w = t.td[0][t.sbox[B0(w)]] ^ t.td[1][t.sbox[B1(w)]] ^ t.td[2][t.sbox[B2(w)]] ^ t.td[3][t.sbox[B3(w)]];
+            }
+
+            dk[r * 4 + c] = w;
+        }
+    }
+}
+
+void aestable_encrypt_ecb(const aestable_context *ctx, uint8_t *buf, size_t blocks, int passes)
+{
+    const AesTables &t = tables();
+    const uint32_t *rk = ctx->enckey;
+
+    for (size_t b = 0; b < blocks; b++)
+    {
+        uint8_t *block = buf + b * 16;
+
+        uint32_t s0 = GETU32(block);
+        uint32_t s1 = GETU32(block + 4);
+        uint32_t s2 = GETU32(block + 8);
+        uint32_t s3 = GETU32(block + 12);
+
+        for (int p = 0; p < passes; p++)
+        {
+            s0 ^= rk[0]; s1 ^= rk[1]; s2 ^= rk[2]; s3 ^= rk[3];
+
+            for (int r = 1; r < 14; r++)
+            {
+                const uint32_t *k = rk + r * 4;
+
+                uint32_t t0 = t.te[0][B0(s0)] ^ t.te[1][B1(s1)] ^ t.te[2][B2(s2)] ^ t.te[3][B3(s3)] ^ k[0];
+                uint32_t t1 = t.te[0][B0(s1)] ^ t.te[1][B1(s2)] ^ t.te[2][B2(s3)] ^ t.te[3][B3(s0)] ^ k[1];
+                uint32_t t2 = t.te[0][B0(s2)] ^ t.te[1][B1(s3)] ^ t.te[2][B2(s0)] ^ t.te[3][B3(s1)] ^ k[2];
+                uint32_t t3 = t.te[0][B0(s3)] ^ t.te[1][B1(s0)] ^ t.te[2][B2(s1)] ^ t.te[3][B3(s2)] ^ k[3];
+
+                s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+            }
+
+            const uint32_t *k = rk + 56;
+            const uint8_t *sb = t.sbox;
+
+            uint32_t t0 = ((uint32_t)sb[B0(s0)] << 24) ^ ((uint32_t)sb[B1(s1)] << 16) ^ ((uint32_t)sb[B2(s2)] << 8) ^ sb[B3(s3)] ^ k[0];
+            uint32_t t1 = ((uint32_t)sb[B0(s1)] << 24) ^ ((uint32_t)sb[B1(s2)] << 16) ^ ((uint32_t)sb[B2(s3)] << 8) ^ sb[B3(s0)] ^ k[1];
+            uint32_t t2 = ((uint32_t)sb[B0(s2)] << 24) ^ ((uint32_t)sb[B1(s3)] << 16) ^ ((uint32_t)sb[B2(s0)] << 8) ^ sb[B3(s1)] ^ k[2];
+            uint32_t t3 = ((uint32_t)sb[B0(s3)] << 24) ^ ((uint32_t)sb[B1(s0)] << 16) ^ ((uint32_t)sb[B2(s1)] << 8) ^ sb[B3(s2)] ^ k[3];
+
+            s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+        }
+
+        PUTU32(block,      s0);
+        PUTU32(block + 4,  s1);
+        PUTU32(block + 8,  s2);
+        PUTU32(block + 12, s3);
+    }
+}
+
+void aestable_decrypt_ecb(const aestable_context *ctx, uint8_t *buf, size_t blocks, int passes)
+{
+    const AesTables &t = tables();
+    const uint32_t *rk = ctx->deckey;
+
+    for (size_t b = 0; b < blocks; b++)
+    {
+        uint8_t *block = buf + b * 16;
+
+        uint32_t s0 = GETU32(block);
+        uint32_t s1 = GETU32(block + 4);
+        uint32_t s2 = GETU32(block + 8);
+        uint32_t s3 = GETU32(block + 12);
+
+        for (int p = 0; p < passes; p++)
+        {
+            s0 ^= rk[0]; s1 ^= rk[1]; s2 ^= rk[2]; s3 ^= rk[3];
+
+            for (int r = 1; r < 14; r++)
+            {
+                const uint32_t *k = rk + r * 4;
+
+                uint32_t t0 = t.td[0][B0(s0)] ^ t.td[1][B1(s3)] ^ t.td[2][B2(s2)] ^ t.td[3][B3(s1)] ^ k[0];
+                uint32_t t1 = t.td[0][B0(s1)] ^ t.td[1][B1(s0)] ^ t.td[2][B2(s3)] ^ t.td[3][B3(s2)] ^ k[1];
+                uint32_t t2 = t.td[0][B0(s2)] ^ t.td[1][B1(s1)] ^ t.td[2][B2(s0)] ^ t.td[3][B3(s3)] ^ k[2];
+                uint32_t t3 = t.td[0][B0(s3)] ^ t.td[1][B1(s2)] ^ t.td[2][B2(s1)] ^ t.td[3][B3(s0)] ^ k[3];
+
+                s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+            }
+
+            const uint32_t *k = rk + 56;
+            const uint8_t *sb = t.sboxInv;
+
+            uint32_t t0 = ((uint32_t)sb[B0(s0)] << 24) ^ ((uint32_t)sb[B1(s3)] << 16) ^ ((uint32_t)sb[B2(s2)] << 8) ^ sb[B3(s1)] ^ k[0];
+            uint32_t t1 = ((uint32_t)sb[B0(s1)] << 24) ^ ((uint32_t)sb[B1(s0)] << 16) ^ ((uint32_t)sb[B2(s3)] << 8) ^ sb[B3(s2)] ^ k[1];
+            uint32_t t2 = ((uint32_t)sb[B0(s2)] << 24) ^ ((uint32_t)sb[B1(s1)] << 16) ^ ((uint32_t)sb[B2(s0)] << 8) ^ sb[B3(s3)] ^ k[2];
+            uint32_t t3 = ((uint32_t)sb[B0(s3)] << 24) ^ ((uint32_t)sb[B1(s2)] << 16) ^ ((uint32_t)sb[B2(s1)] << 8) ^ sb[B3(s0)] ^ k[3];
+
+            s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+        }
+
+        PUTU32(block,      s0);
+        PUTU32(block + 4,  s1);
+        PUTU32(block + 8,  s2);
+        PUTU32(block + 12, s3);
+    }
+}
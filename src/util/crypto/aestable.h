@@ -0,0 +1,31 @@
+/*
+*   Table-driven AES-256 (32-bit T-tables), for cpus without AES-NI.
+*   The key schedules are expanded once by aestable_init, the context is
+*   only read afterwards and can be shared between threads.
+*/
+#ifndef AESTABLE_H
+#define AESTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    typedef struct {
+        uint32_t enckey[60];
+        uint32_t deckey[60]; // equivalent inverse cipher schedule
+    } aestable_context;
+
+    void aestable_init(aestable_context *, const uint8_t * /* key */);
+
+    // runs every block through the cipher 'passes' times
+    void aestable_encrypt_ecb(const aestable_context *, uint8_t * /* plaintext */, size_t /* blocks */, int /* passes */);
+    void aestable_decrypt_ecb(const aestable_context *, uint8_t * /* ciphertext */, size_t /* blocks */, int /* passes */);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AESTABLE_H
@@ -43,6 +43,7 @@ typedef unsigned char  UBYTE; /* 8 bits exactly    */
 typedef unsigned short UWORD; /* 16 bits (or more) */
 typedef unsigned int   ULONG; /* 32 bits (or more) */
 typedef   signed int    LONG; /* 32 bits (or more) */
+typedef unsigned long long BITBUF; /* 64 bits, the bit reservoir */
 
 /* some constants defined by the LZX specification */
 #define LZX_MIN_MATCH                (2)
@@ -69,6 +70,15 @@ typedef   signed int    LONG; /* 32 bits (or more) */
 
 #define LZX_LENTABLE_SAFETY (64) /* we allow length table decoding overruns */
 
+/* fast main tree entries: sym1 (10 bits), sym2 (8 bits), len1 (5 bits),
+ * len1 + len2 (5 bits) and the symbol count (2 bits, 0 for codes longer
+ * than the table, 2 when two literals fit in one lookup) */
+#define FAST_SYM1(e)  ((e) & 0x3FF)
+#define FAST_SYM2(e)  (((e) >> 10) & 0xFF)
+#define FAST_LEN1(e)  (((e) >> 18) & 0x1F)
+#define FAST_LEN2(e)  (((e) >> 23) & 0x1F)
+#define FAST_COUNT(e) ((e) >> 28)
+
 #define LZX_DECLARE_TABLE(tbl) \
   UWORD tbl##_table[(1<<LZX_##tbl##_TABLEBITS) + (LZX_##tbl##_MAXSYMBOLS<<1)];\
   UBYTE tbl##_len  [LZX_##tbl##_MAXSYMBOLS + LZX_LENTABLE_SAFETY]
@@ -94,6 +104,8 @@ struct LZXstate
     LZX_DECLARE_TABLE(MAINTREE);
     LZX_DECLARE_TABLE(LENGTH);
     LZX_DECLARE_TABLE(ALIGNED);
+
+    ULONG MAINTREE_fast[1 << LZX_MAINTREE_TABLEBITS];
 };
 
 /* LZX decruncher */
@@ -253,31 +265,44 @@ int lzxReset(struct LZXstate *pState)
  * These bit access routines work by using the area beyond the MSB and the
  * LSB as a free source of zeroes. This avoids having to mask any bits.
  * So we have to know the bit width of the bitbuffer variable. This is
- * sizeof(ULONG) * 8, also defined as ULONG_BITS
+ * sizeof(BITBUF) * 8, also defined as BITBUF_BITS
  */
 
- /* number of bits in ULONG. Note: This must be at multiple of 16, and at
-  * least 32 for the bitbuffer code to work (ie, it must be able to ensure
-  * up to 17 bits - that's adding 16 bits when there's one bit left, or
-  * adding 32 bits when there are no bits left. The code should work fine
-  * for machines where ULONG >= 32 bits.
+ /* number of bits in BITBUF. A refill tops the buffer up to at least 49
+  * bits, so a whole symbol and its extra bits are read without a refill.
+  * Words past the end of the input read as zero, inpos still advances so
+  * the exhaustion check can tell how far the reader has run over.
   */
-#define ULONG_BITS (sizeof(ULONG)<<3)
+#define BITBUF_BITS (sizeof(BITBUF)<<3)
 
 #define INIT_BITSTREAM do { bitsleft = 0; bitbuf = 0; } while (0)
 
-#define ENSURE_BITS(n)                            \
-  while (bitsleft < (n)) {                        \
-    bitbuf |= ((inpos[1]<<8)|inpos[0]) << (ULONG_BITS-16 - bitsleft);    \
-    bitsleft += 16; inpos+=2;                        \
-  }
+#define READ_WORD(p, end) \
+  (((end) - (p) >= 2) ? (ULONG)(((p)[1]<<8)|(p)[0]) : ((end) - (p) == 1) ? (ULONG)(p)[0] : 0)
+
+#define REFILL_BITS do {                                                  \
+  if (endinp - inpos >= 8) {                                              \
+    while (bitsleft <= (int)BITBUF_BITS - 16) {                           \
+      bitbuf |= (BITBUF)((inpos[1]<<8)|inpos[0]) << (BITBUF_BITS-16 - bitsleft); \
+      bitsleft += 16; inpos += 2;                                         \
+    }                                                                     \
+  }                                                                       \
+  else {                                                                  \
+    while (bitsleft <= (int)BITBUF_BITS - 16) {                           \
+      bitbuf |= (BITBUF)READ_WORD(inpos, endinp) << (BITBUF_BITS-16 - bitsleft); \
+      bitsleft += 16; inpos += 2;                                         \
+    }                                                                     \
+  }                                                                       \
+} while (0)
 
-#define PEEK_BITS(n)   (bitbuf >> (ULONG_BITS - (n)))
+#define ENSURE_BITS(n) do { if (bitsleft < (n)) REFILL_BITS; } while (0)
+
+#define PEEK_BITS(n)   (bitbuf >> (BITBUF_BITS - (n)))
 #define REMOVE_BITS(n) ((bitbuf <<= (n)), (bitsleft -= (n)))
 
 #define READ_BITS(v,n) do {                        \
   ENSURE_BITS(n);                            \
-  (v) = PEEK_BITS(n);                            \
+  (v) = (n) ? PEEK_BITS(n) : 0;                \
   REMOVE_BITS(n);                            \
 } while (0)
 
@@ -307,7 +332,7 @@ int lzxReset(struct LZXstate *pState)
   ENSURE_BITS(16);                            \
   hufftbl = SYMTABLE(tbl);                        \
   if ((i = hufftbl[PEEK_BITS(TABLEBITS(tbl))]) >= MAXSYMBOLS(tbl)) {    \
-    j = 1 << (ULONG_BITS - TABLEBITS(tbl));                \
+    j = (BITBUF)1 << (BITBUF_BITS - TABLEBITS(tbl));            \
     do {                                \
       j >>= 1; i <<= 1; i |= (bitbuf & j) ? 1 : 0;            \
       if (!j) { return DECR_ILLEGALDATA; }                            \
@@ -323,7 +348,7 @@ int lzxReset(struct LZXstate *pState)
    * own special LZX way.
    */
 #define READ_LENGTHS(tbl,first,last) do { \
-  lb.bb = bitbuf; lb.bl = bitsleft; lb.ip = inpos; \
+  lb.bb = bitbuf; lb.bl = bitsleft; lb.ip = inpos; lb.end = endinp; \
   if (lzx_read_lens(pState, LENTABLE(tbl),(first),(last),&lb)) { \
     return DECR_ILLEGALDATA; \
   } \
@@ -415,19 +440,93 @@ static int make_decode_table(ULONG nsyms, ULONG nbits, UBYTE *length, UWORD *tab
     return 0;
 }
 
+/* fills the fast main tree table from the decode table. Codes that fit
+ * are decoded in one lookup, and a literal whose code leaves room for the
+ * next literal's code is paired with it
+ */
+static void make_fast_table(struct LZXstate *pState) {
+    ULONG mask = (1 << LZX_MAINTREE_TABLEBITS) - 1;
+    ULONG i, sym1, sym2, len1, len2;
+
+    for (i = 0; i <= mask; i++) {
+        sym1 = pState->MAINTREE_table[i];
+
+        if (sym1 >= LZX_MAINTREE_MAXSYMBOLS) {
+            pState->MAINTREE_fast[i] = 0;
+            continue;
+        }
+
+        len1 = pState->MAINTREE_len[sym1];
+        pState->MAINTREE_fast[i] = sym1 | (len1 << 18) | (len1 << 23) | (1u << 28);
+
+        if (sym1 >= LZX_NUM_CHARS || len1 >= LZX_MAINTREE_TABLEBITS) continue;
+
+        sym2 = pState->MAINTREE_table[(i << len1) & mask];
+        if (sym2 >= LZX_NUM_CHARS) continue;
+
+        len2 = pState->MAINTREE_len[sym2];
+        if (len1 + len2 > LZX_MAINTREE_TABLEBITS) continue;
+
+        pState->MAINTREE_fast[i] = sym1 | (sym2 << 10) | (len1 << 18) | ((len1 + len2) << 23) | (2u << 28);
+    }
+}
+
+/* copies a match inside the window, 16 or 8 bytes at a time when the
+ * source is far enough behind. Never writes past the end of the match,
+ * the bytes after it can still be referenced through the wraparound.
+ */
+static void copy_match(UBYTE *window, ULONG window_size, UBYTE *rundest, ULONG match_offset, int match_length) {
+    UBYTE *runsrc = rundest - match_offset;
+    UBYTE *end;
+
+    /* copy any wrapped around source data */
+    while ((runsrc < window) && (match_length > 0)) {
+        *rundest++ = *(runsrc + window_size); runsrc++;
+        match_length--;
+    }
+
+    end = rundest + match_length;
+
+    if (match_offset >= 16 && match_length >= 16) {
+        while (end - rundest > 16) {
+            memcpy(rundest, runsrc, 16);
+            rundest += 16; runsrc += 16;
+        }
+        /* last chunk overlaps bytes already copied */
+        memcpy(end - 16, runsrc - (rundest - (end - 16)), 16);
+    }
+    else if (match_offset >= 8 && match_length >= 8) {
+        while (end - rundest > 8) {
+            memcpy(rundest, runsrc, 8);
+            rundest += 8; runsrc += 8;
+        }
+        memcpy(end - 8, runsrc - (rundest - (end - 8)), 8);
+    }
+    else if (match_offset == 1) {
+        memset(rundest, runsrc[0], (size_t)match_length);
+    }
+    else {
+        /* copy match data - no worries about destination wraps */
+        while (rundest < end) *rundest++ = *runsrc++;
+    }
+}
+
 struct lzx_bits {
-    ULONG bb;
+    BITBUF bb;
     int bl;
     UBYTE *ip;
+    UBYTE *end;
 };
 
 static int lzx_read_lens(struct LZXstate *pState, UBYTE *lens, ULONG first, ULONG last, struct lzx_bits *lb) {
-    ULONG i, j, x, y;
+    ULONG i, x, y;
+    BITBUF j;
     int z;
 
-    register ULONG bitbuf = lb->bb;
+    register BITBUF bitbuf = lb->bb;
     register int bitsleft = lb->bl;
     UBYTE *inpos = lb->ip;
+    UBYTE *endinp = lb->end;
     UWORD *hufftbl;
 
     for (x = 0; x < 20; x++) {
@@ -467,7 +566,7 @@ static int lzx_read_lens(struct LZXstate *pState, UBYTE *lens, ULONG first, ULON
 int lzxDecompress(struct LZXstate *pState, unsigned char *inpos, unsigned char *outpos, int inlen, int outlen) {
     UBYTE *endinp = inpos + inlen;
     UBYTE *window = pState->window;
-    UBYTE *runsrc, *rundest;
+    UBYTE *rundest;
     UWORD *hufftbl; /* used in READ_HUFFSYM macro as chosen decoding table */
 
     ULONG window_posn = pState->window_posn;
@@ -476,9 +575,10 @@ int lzxDecompress(struct LZXstate *pState, unsigned char *inpos, unsigned char *
     ULONG R1 = pState->R1;
     ULONG R2 = pState->R2;
 
-    register ULONG bitbuf;
+    register BITBUF bitbuf;
     register int bitsleft;
-    ULONG match_offset, i, j, k; /* ijk used in READ_HUFFSYM macro */
+    ULONG match_offset, i, k, entry; /* ij used in READ_HUFFSYM macro */
+    BITBUF j;
     struct lzx_bits lb; /* used in READ_LENGTHS macro */
 
     int togo = outlen, this_run, main_element, aligned_bits;
@@ -518,6 +618,7 @@ int lzxDecompress(struct LZXstate *pState, unsigned char *inpos, unsigned char *
                 READ_LENGTHS(MAINTREE, 0, 256);
                 READ_LENGTHS(MAINTREE, 256, pState->main_elements);
                 BUILD_TABLE(MAINTREE);
+                make_fast_table(pState);
                 if (LENTABLE(MAINTREE)[0xE8] != 0) pState->intel_started = 1;
 
                 READ_LENGTHS(LENGTH, 0, LZX_NUM_SECONDARY_LENGTHS);
@@ -526,11 +627,14 @@ int lzxDecompress(struct LZXstate *pState, unsigned char *inpos, unsigned char *
 
             case LZX_BLOCKTYPE_UNCOMPRESSED:
                 pState->intel_started = 1; /* because we can't assume otherwise */
-                ENSURE_BITS(16); /* get up to 16 pad bits into the buffer */
-                if (bitsleft > 16) inpos -= 2; /* and align the bitstream! */
-                R0 = inpos[0] | (inpos[1] << 8) | (inpos[2] << 16) | (inpos[3] << 24); inpos += 4;
-                R1 = inpos[0] | (inpos[1] << 8) | (inpos[2] << 16) | (inpos[3] << 24); inpos += 4;
-                R2 = inpos[0] | (inpos[1] << 8) | (inpos[2] << 16) | (inpos[3] << 24); inpos += 4;
+                /* skip to the next word, or a whole word of padding if aligned.
+                 * The reservoir may hold several words the raw data starts in */
+                inpos -= (bitsleft >> 4) << 1;
+                if ((bitsleft & 15) == 0) inpos += 2;
+                INIT_BITSTREAM;
+                R0 = inpos[0] | (inpos[1] << 8) | (inpos[2] << 16) | ((ULONG)inpos[3] << 24); inpos += 4;
+                R1 = inpos[0] | (inpos[1] << 8) | (inpos[2] << 16) | ((ULONG)inpos[3] << 24); inpos += 4;
+                R2 = inpos[0] | (inpos[1] << 8) | (inpos[2] << 16) | ((ULONG)inpos[3] << 24); inpos += 4;
                 break;
 
             default:
@@ -548,7 +652,7 @@ int lzxDecompress(struct LZXstate *pState, unsigned char *inpos, unsigned char *
              * remaining - in this boundary case they aren't really part of
              * the compressed data)
              */
-            if (inpos > (endinp + 2) || bitsleft < 16) return DECR_ILLEGALDATA;
+            if ((inpos - endinp) * 8 > bitsleft) return DECR_ILLEGALDATA;
         }
 
         while ((this_run = pState->block_remaining) > 0 && togo > 0) {
@@ -566,7 +670,25 @@ int lzxDecompress(struct LZXstate *pState, unsigned char *inpos, unsigned char *
 
             case LZX_BLOCKTYPE_VERBATIM:
                 while (this_run > 0) {
-                    READ_HUFFSYM(MAINTREE, main_element);
+                    ENSURE_BITS(16);
+                    entry = pState->MAINTREE_fast[PEEK_BITS(LZX_MAINTREE_TABLEBITS)];
+
+                    if (FAST_COUNT(entry) == 2 && this_run >= 2) {
+                        /* two literals in one lookup */
+                        window[window_posn++] = FAST_SYM1(entry);
+                        window[window_posn++] = FAST_SYM2(entry);
+                        REMOVE_BITS(FAST_LEN2(entry));
+                        this_run -= 2;
+                        continue;
+                    }
+
+                    if (FAST_COUNT(entry) != 0) {
+                        main_element = FAST_SYM1(entry);
+                        REMOVE_BITS(FAST_LEN1(entry));
+                    }
+                    else {
+                        READ_HUFFSYM(MAINTREE, main_element);
+                    }
 
                     if (main_element < LZX_NUM_CHARS) {
                         /* literal: 0 to LZX_NUM_CHARS-1 */
@@ -613,17 +735,11 @@ int lzxDecompress(struct LZXstate *pState, unsigned char *inpos, unsigned char *
                         }
 
                         rundest = window + window_posn;
-                        runsrc = rundest - match_offset;
                         window_posn += match_length;
                         if (window_posn > window_size) return DECR_ILLEGALDATA;
                         this_run -= match_length;
 
-                        /* copy any wrapped around source data */
-                        while ((runsrc < window) && (match_length-- > 0)) {
-                            *rundest++ = *(runsrc + window_size); runsrc++;
-                        }
-                        /* copy match data - no worries about destination wraps */
-                        while (match_length-- > 0) *rundest++ = *runsrc++;
+                        copy_match(window, window_size, rundest, match_offset, match_length);
 
                     }
                 }
@@ -694,17 +810,11 @@ int lzxDecompress(struct LZXstate *pState, unsigned char *inpos, unsigned char *
                         }
 
                         rundest = window + window_posn;
-                        runsrc = rundest - match_offset;
                         window_posn += match_length;
                         if (window_posn > window_size) return DECR_ILLEGALDATA;
                         this_run -= match_length;
 
-                        /* copy any wrapped around source data */
-                        while ((runsrc < window) && (match_length-- > 0)) {
-                            *rundest++ = *(runsrc + window_size); runsrc++;
-                        }
-                        /* copy match data - no worries about destination wraps */
-                        while (match_length-- > 0) *rundest++ = *runsrc++;
+                        copy_match(window, window_size, rundest, match_offset, match_length);
 
                     }
                 }
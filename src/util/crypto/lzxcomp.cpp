@@ -0,0 +1,746 @@
+/***************************************************************************
+ *                     lzxcomp.cpp - LZX compression routines              *
+ *                                                                         *
+ *  The decoder (lzx.c) restarts its bit reader on every frame, but keeps  *
+ *  the repeated offsets, the window and the previous tree lengths, so     *
+ *  each frame here is one self-contained block that delta codes its trees *
+ *  against the previous block's.                                          *
+ ***************************************************************************/
+
+#include "lzxcomp.h"
+
+#include <algorithm>
+#include <queue>
+#include <string.h>
+#include <vector>
+
+/* some constants defined by the LZX specification */
+#define LZX_MIN_MATCH              (2)
+#define LZX_MAX_MATCH              (257)
+#define LZX_NUM_CHARS              (256)
+#define LZX_BLOCKTYPE_VERBATIM     (1)
+#define LZX_BLOCKTYPE_UNCOMPRESSED (3)
+#define LZX_PRETREE_NUM_ELEMENTS   (20)
+#define LZX_NUM_PRIMARY_LENGTHS    (7)
+#define LZX_NUM_SECONDARY_LENGTHS  (249)
+#define LZX_MAINTREE_MAXSYMBOLS    (LZX_NUM_CHARS + 50 * 8)
+
+/* the decoder handles codes of up to 16 bits, pretree lengths are stored in 4 */
+#define LZX_MAX_CODE_LENGTH        (16)
+#define LZX_PRETREE_MAX_LENGTH     (15)
+
+#define HASH_BITS (15)
+#define HASH_SIZE (1 << HASH_BITS)
+
+static const unsigned char extra_bits[51] = {
+     0,  0,  0,  0,  1,  1,  2,  2,  3,  3,  4,  4,  5,  5,  6,  6,
+     7,  7,  8,  8,  9,  9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14,
+    15, 15, 16, 16, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+    17, 17, 17
+};
+
+static const unsigned int position_base[51] = {
+          0,       1,       2,      3,      4,      6,      8,     12,     16,     24,     32,       48,      64,      96,     128,     192,
+        256,     384,     512,    768,   1024,   1536,   2048,   3072,   4096,   6144,   8192,    12288,   16384,   24576,   32768,   49152,
+      65536,   98304,  131072, 196608, 262144, 393216, 524288, 655360, 786432, 917504, 1048576, 1179648, 1310720, 1441792, 1572864, 1703936,
+    1835008, 1966080, 2097152
+};
+
+struct LevelConfig
+{
+    int maxChain;   /* hash chain entries to visit per position */
+    int niceLength; /* stop searching once a match is this long */
+    bool lazy;      /* check if the next position has a better match */
+};
+
+static const LevelConfig s_levels[LZX_LEVEL_BEST + 1] = {
+    {    0,   0, false },
+    {    4,  16, false },
+    {    8,  32, false },
+    {   16,  32, false },
+    {   16,  64, true  },
+    {   32, 128, true  },
+    {   64, 128, true  },
+    {  128, 257, true  },
+    {  512, 257, true  },
+    { 2048, 257, true  }
+};
+
+struct Token
+{
+    unsigned short mainSym;
+    short lengthSym;          /* -1 if the length fits in the main symbol */
+    unsigned int extra;       /* verbatim offset bits */
+    unsigned char extraCount;
+};
+
+struct PreItem
+{
+    unsigned char sym;
+    unsigned char extraCount;
+    unsigned char extra;
+};
+
+/* Writes 16 bit little endian words, filled from the most significant bit */
+class BitWriter
+{
+public:
+    BitWriter(unsigned char *out, int capacity)
+        : m_out(out), m_capacity(capacity), m_pos(0), m_buf(0), m_count(0), m_overflow(false) {}
+
+    void write(unsigned int value, int bits)
+    {
+        if (bits == 0)
+            return;
+
+        m_buf = (m_buf << bits) | (value & ((1u << bits) - 1));
+        m_count += bits;
+
+        while (m_count >= 16)
+        {
+            m_count -= 16;
+            unsigned int word = (unsigned int)(m_buf >> m_count) & 0xffff;
+
+            writeByte(word & 0xff);
+            writeByte(word >> 8);
+        }
+
+        m_buf &= (1ull << m_count) - 1;
+    }
+
+    void align()
+    {
+        if (m_count > 0)
+            write(0, 16 - m_count);
+    }
+
+    void writeByte(unsigned char b)
+    {
+        if (m_pos >= m_capacity)
+        {
+            m_overflow = true;
+            return;
+        }
+
+        m_out[m_pos++] = b;
+    }
+
+    int  pending()  const { return m_count;    }
+    int  size()     const { return m_pos;      }
+    bool overflow() const { return m_overflow; }
+
+private:
+    unsigned char *m_out;
+    int m_capacity;
+    int m_pos;
+    unsigned long long m_buf;
+    int m_count;
+    bool m_overflow;
+};
+
+/* length limited huffman code lengths, a used tree always gets at least two codes */
+static void buildLengths(const unsigned int *freq, int count, int maxLength, unsigned char *lengths)
+{
+    std::vector<int> symbols;
+
+    for (int i = 0; i < count; i++)
+    {
+        lengths[i] = 0;
+
+        if (freq[i] > 0)
+            symbols.push_back(i);
+    }
+
+    if (symbols.empty())
+        return;
+
+    if (symbols.size() == 1)
+    {
+        /* the decoder rejects incomplete trees, so pair it with an unused code */
+        lengths[symbols[0]] = 1;
+        lengths[symbols[0] == 0 ? 1 : 0] = 1;
+        return;
+    }
+
+    int leaves = (int)symbols.size();
+
+    std::vector<int> parent(leaves * 2, -1);
+    std::priority_queue<std::pair<unsigned long long, int>, std::vector<std::pair<unsigned long long, int>>, std::greater<std::pair<unsigned long long, int>>> queue;
+
+    for (int i = 0; i < leaves; i++)
+        queue.push(std::make_pair((unsigned long long)freq[symbols[i]], i));
+
+    int next = leaves;
+
+    while (queue.size() > 1)
+    {
+        std::pair<unsigned long long, int> a = queue.top(); queue.pop();
+        std::pair<unsigned long long, int> b = queue.top(); queue.pop();
+
+        parent[a.second] = next;
+        parent[b.second] = next;
+
+        queue.push(std::make_pair(a.first + b.first, next++));
+    }
+
+    /* depths, parents are always created after their children */
+    std::vector<int> depth(next, 0);
+    int lengthCount[33] = { 0 };
+
+    for (int i = next - 2; i >= 0; i--)
+        depth[i] = depth[parent[i]] + 1;
+
+    for (int i = 0; i < leaves; i++)
+        lengthCount[std::min(depth[i], 32)]++;
+
+    /* fold anything deeper than maxLength back in until the kraft sum is exact */
+    for (int i = maxLength + 1; i <= 32; i++)
+    {
+        lengthCount[maxLength] += lengthCount[i];
+        lengthCount[i] = 0;
+    }
+
+    unsigned int total = 0;
+
+    for (int i = 1; i <= maxLength; i++)
+        total += (unsigned int)lengthCount[i] << (maxLength - i);
+
+    while (total != (1u << maxLength))
+    {
+        lengthCount[maxLength]--;
+
+        for (int i = maxLength - 1; i > 0; i--)
+        {
+            if (lengthCount[i])
+            {
+                lengthCount[i]--;
+                lengthCount[i + 1] += 2;
+                break;
+            }
+        }
+
+        total--;
+    }
+
+    /* most frequent symbols get the shortest codes */
+    std::stable_sort(symbols.begin(), symbols.end(), [freq](int a, int b) { return freq[a] > freq[b]; });
+
+    int index = 0;
+
+    for (int length = 1; length <= maxLength; length++)
+    {
+        for (int i = 0; i < lengthCount[length]; i++)
+            lengths[symbols[index++]] = (unsigned char)length;
+    }
+}
+
+/* canonical codes, in the order make_decode_table expects */
+static void buildCodes(const unsigned char *lengths, int count, unsigned short *codes)
+{
+    int lengthCount[LZX_MAX_CODE_LENGTH + 1] = { 0 };
+    unsigned int nextCode[LZX_MAX_CODE_LENGTH + 2];
+
+    for (int i = 0; i < count; i++)
+        lengthCount[lengths[i]]++;
+
+    lengthCount[0] = 0;
+
+    unsigned int code = 0;
+
+    for (int bits = 1; bits <= LZX_MAX_CODE_LENGTH; bits++)
+    {
+        code = (code + lengthCount[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+
+    for (int i = 0; i < count; i++)
+        codes[i] = lengths[i] ? (unsigned short)nextCode[lengths[i]]++ : 0;
+}
+
+/* lengths are sent as deltas from the previous block's, with zero runs and repeats */
+static void writeLengths(BitWriter &bw, const unsigned char *prev, const unsigned char *lens, int first, int last)
+{
+    std::vector<PreItem> items;
+
+    for (int x = first; x < last; )
+    {
+        int run = 1;
+
+        while (x + run < last && lens[x + run] == lens[x])
+            run++;
+
+        if (lens[x] == 0 && run >= 4)
+        {
+            int n = std::min(run, 51);
+
+            if (n >= 20)
+                items.push_back({ 18, 5, (unsigned char)(n - 20) });
+            else
+                items.push_back({ 17, 4, (unsigned char)(n - 4) });
+
+            x += n;
+            continue;
+        }
+
+        unsigned char delta = (unsigned char)((prev[x] - lens[x] + 17) % 17);
+
+        if (run >= 4)
+        {
+            int n = std::min(run, 5);
+
+            items.push_back({ 19, 1, (unsigned char)(n - 4) });
+            items.push_back({ delta, 0, 0 });
+
+            x += n;
+            continue;
+        }
+
+        items.push_back({ delta, 0, 0 });
+        x++;
+    }
+
+    unsigned int freq[LZX_PRETREE_NUM_ELEMENTS] = { 0 };
+    unsigned char preLens[LZX_PRETREE_NUM_ELEMENTS];
+    unsigned short preCodes[LZX_PRETREE_NUM_ELEMENTS];
+
+    for (const PreItem &item : items)
+        freq[item.sym]++;
+
+    buildLengths(freq, LZX_PRETREE_NUM_ELEMENTS, LZX_PRETREE_MAX_LENGTH, preLens);
+    buildCodes(preLens, LZX_PRETREE_NUM_ELEMENTS, preCodes);
+
+    for (int i = 0; i < LZX_PRETREE_NUM_ELEMENTS; i++)
+        bw.write(preLens[i], 4);
+
+    for (const PreItem &item : items)
+    {
+        bw.write(preCodes[item.sym], preLens[item.sym]);
+        bw.write(item.extra, item.extraCount);
+    }
+}
+
+class LzxCompressor
+{
+public:
+    LzxCompressor(const unsigned char *in, int inLen, int window, int level)
+        : m_in(in)
+        , m_inLen(inLen)
+        , m_windowSize(1 << window)
+        , m_config(s_levels[std::max(LZX_LEVEL_STORE, std::min(level, LZX_LEVEL_BEST))])
+        , m_store(level <= LZX_LEVEL_STORE)
+        , m_inserted(0)
+        , m_R0(1), m_R1(1), m_R2(1)
+    {
+        int posnSlots = (window == 20) ? 42 : (window == 21) ? 50 : window << 1;
+
+        m_mainElements = LZX_NUM_CHARS + (posnSlots << 3);
+        m_maxOffset    = m_windowSize - 3;
+
+        memset(m_prevMain,   0, sizeof(m_prevMain));
+        memset(m_prevLength, 0, sizeof(m_prevLength));
+
+        m_uncompressed.resize(LZX_FRAME_SIZE + 64);
+
+        /* storing needs no match finder */
+        if (m_store)
+            return;
+
+        m_head.assign(HASH_SIZE, -1);
+        m_prev.assign(m_windowSize, -1);
+
+        m_tokens.reserve(LZX_FRAME_SIZE);
+        m_verbatim.resize(LZX_FRAME_SIZE * 3);
+    }
+
+    int compress(unsigned char *out, int outCapacity)
+    {
+        int outPos = 0;
+
+        for (int frameStart = 0; frameStart < m_inLen; frameStart += LZX_FRAME_SIZE)
+        {
+            int frameLen = std::min(LZX_FRAME_SIZE, m_inLen - frameStart);
+            bool first = (frameStart == 0);
+
+            int verbatimSize = -1;
+
+            if (!m_store)
+            {
+                tokenize(frameStart, frameStart + frameLen);
+                verbatimSize = writeVerbatim(frameLen, first);
+            }
+
+            int uncompressedSize = writeUncompressed(frameStart, frameLen, first);
+
+            const unsigned char *block = m_uncompressed.data();
+            int blockSize = uncompressedSize;
+
+            if (verbatimSize > 0 && verbatimSize <= uncompressedSize)
+            {
+                block = m_verbatim.data();
+                blockSize = verbatimSize;
+
+                memcpy(m_prevMain,   m_mainLens,   sizeof(m_prevMain));
+                memcpy(m_prevLength, m_lengthLens, sizeof(m_prevLength));
+            }
+
+            if (blockSize < 0)
+                return -1;
+
+            int headerSize = (frameLen == LZX_FRAME_SIZE) ? 2 : 5;
+
+            if (outPos + headerSize + blockSize > outCapacity)
+                return -1;
+
+            if (frameLen == LZX_FRAME_SIZE)
+            {
+                out[outPos++] = (unsigned char)(blockSize >> 8);
+                out[outPos++] = (unsigned char)blockSize;
+            }
+            else
+            {
+                out[outPos++] = 0xFF;
+                out[outPos++] = (unsigned char)(frameLen >> 8);
+                out[outPos++] = (unsigned char)frameLen;
+                out[outPos++] = (unsigned char)(blockSize >> 8);
+                out[outPos++] = (unsigned char)blockSize;
+            }
+
+            memcpy(out + outPos, block, blockSize);
+            outPos += blockSize;
+        }
+
+        return outPos;
+    }
+
+private:
+    unsigned int hash(int pos) const
+    {
+        unsigned int v = m_in[pos] | (m_in[pos + 1] << 8) | (m_in[pos + 2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void insertUpTo(int end)
+    {
+        end = std::min(end, m_inLen - 2);
+
+        for (; m_inserted < end; m_inserted++)
+        {
+            unsigned int h = hash(m_inserted);
+
+            m_prev[m_inserted & (m_windowSize - 1)] = m_head[h];
+            m_head[h] = m_inserted;
+        }
+    }
+
+    int matchLength(int pos, int offset, int maxLen) const
+    {
+        const unsigned char *a = m_in + pos;
+        const unsigned char *b = a - offset;
+        int len = 0;
+
+        while (len < maxLen && a[len] == b[len])
+            len++;
+
+        return len;
+    }
+
+    static int slotOf(unsigned int formatted)
+    {
+        return (int)(std::upper_bound(position_base, position_base + 51, formatted) - position_base) - 1;
+    }
+
+    /* rough bits saved over coding the bytes as literals */
+    static int score(int len, int extraCount)
+    {
+        return len * 8 - 8 - extraCount;
+    }
+
+    /* best match at pos, offset 0 means none. repeat is 0-2 for R0-R2, otherwise -1 */
+    int findMatch(int pos, int frameEnd, int *bestOffset, int *bestRepeat)
+    {
+        int maxLen = std::min(LZX_MAX_MATCH, frameEnd - pos);
+        int bestScore = 0;
+        int bestLen = 0;
+
+        *bestOffset = 0;
+        *bestRepeat = -1;
+
+        if (maxLen < LZX_MIN_MATCH)
+            return 0;
+
+        unsigned int repeats[3] = { m_R0, m_R1, m_R2 };
+
+        for (int r = 0; r < 3; r++)
+        {
+            if ((int)repeats[r] > pos)
+                continue;
+
+            int len = matchLength(pos, repeats[r], maxLen);
+
+            if (len >= LZX_MIN_MATCH && score(len, 0) > bestScore)
+            {
+                bestScore   = score(len, 0);
+                bestLen     = len;
+                *bestOffset = repeats[r];
+                *bestRepeat = r;
+            }
+        }
+
+        if (maxLen < 3 || bestLen >= m_config.niceLength)
+            return bestLen;
+
+        insertUpTo(pos);
+
+        int candidate = m_head[hash(pos)];
+        int chain = m_config.maxChain;
+
+        // past maxLen the compare below would read beyond the input
+        while (candidate >= 0 && chain-- > 0 && bestLen < maxLen)
+        {
+            int offset = pos - candidate;
+
+            if (offset > m_maxOffset)
+                break;
+
+            if (m_in[candidate + bestLen] == m_in[pos + bestLen] || bestLen < 3)
+            {
+                int len = matchLength(pos, offset, maxLen);
+
+                if (len >= 3)
+                {
+                    int s = score(len, extra_bits[slotOf(offset + 2)]);
+
+                    if (s > bestScore)
+                    {
+                        bestScore   = s;
+                        bestLen     = len;
+                        *bestOffset = offset;
+                        *bestRepeat = -1;
+
+                        if (len >= m_config.niceLength)
+                            break;
+                    }
+                }
+            }
+
+            candidate = m_prev[candidate & (m_windowSize - 1)];
+        }
+
+        return bestLen;
+    }
+
+    int matchScore(int len, int offset, int repeat)
+    {
+        if (len == 0)
+            return 0;
+
+        return score(len, repeat >= 0 ? 0 : extra_bits[slotOf(offset + 2)]);
+    }
+
+    void tokenize(int frameStart, int frameEnd)
+    {
+        m_tokens.clear();
+
+        int pos = frameStart;
+
+        while (pos < frameEnd)
+        {
+            int offset, repeat;
+            int len = findMatch(pos, frameEnd, &offset, &repeat);
+
+            if (len > 0 && m_config.lazy && len < m_config.niceLength && pos + 1 < frameEnd)
+            {
+                int nextOffset, nextRepeat;
+                int nextLen = findMatch(pos + 1, frameEnd, &nextOffset, &nextRepeat);
+
+                if (matchScore(nextLen, nextOffset, nextRepeat) > matchScore(len, offset, repeat))
+                    len = 0;
+            }
+
+            if (len == 0)
+            {
+                m_tokens.push_back({ m_in[pos], -1, 0, 0 });
+                pos++;
+                continue;
+            }
+
+            m_tokens.push_back(makeMatch(len, offset, repeat));
+            pos += len;
+        }
+    }
+
+    Token makeMatch(int len, int offset, int repeat)
+    {
+        Token token = { 0, -1, 0, 0 };
+        int slot;
+
+        if (repeat == 0)
+        {
+            slot = 0;
+        }
+        else if (repeat == 1)
+        {
+            slot = 1;
+            m_R1 = m_R0;
+            m_R0 = offset;
+        }
+        else if (repeat == 2)
+        {
+            slot = 2;
+            m_R2 = m_R0;
+            m_R0 = offset;
+        }
+        else
+        {
+            unsigned int formatted = offset + 2;
+
+            slot = slotOf(formatted);
+
+            token.extraCount = extra_bits[slot];
+            token.extra      = formatted - position_base[slot];
+
+            m_R2 = m_R1;
+            m_R1 = m_R0;
+            m_R0 = offset;
+        }
+
+        int lengthHeader = std::min(len - LZX_MIN_MATCH, LZX_NUM_PRIMARY_LENGTHS);
+
+        token.mainSym = (unsigned short)(LZX_NUM_CHARS + (slot << 3) + lengthHeader);
+
+        if (lengthHeader == LZX_NUM_PRIMARY_LENGTHS)
+            token.lengthSym = (short)(len - LZX_MIN_MATCH - LZX_NUM_PRIMARY_LENGTHS);
+
+        return token;
+    }
+
+    void writeBlockHeader(BitWriter &bw, int type, int frameLen, bool first)
+    {
+        if (first)
+            bw.write(0, 1); /* no intel e8 translation */
+
+        bw.write(type, 3);
+        bw.write(frameLen >> 8, 16);
+        bw.write(frameLen & 0xff, 8);
+    }
+
+    int writeVerbatim(int frameLen, bool first)
+    {
+        unsigned int mainFreq[LZX_MAINTREE_MAXSYMBOLS]      = { 0 };
+        unsigned int lengthFreq[LZX_NUM_SECONDARY_LENGTHS] = { 0 };
+
+        for (const Token &token : m_tokens)
+        {
+            mainFreq[token.mainSym]++;
+
+            if (token.lengthSym >= 0)
+                lengthFreq[token.lengthSym]++;
+        }
+
+        memset(m_mainLens, 0, sizeof(m_mainLens));
+
+        buildLengths(mainFreq, m_mainElements, LZX_MAX_CODE_LENGTH, m_mainLens);
+        buildLengths(lengthFreq, LZX_NUM_SECONDARY_LENGTHS, LZX_MAX_CODE_LENGTH, m_lengthLens);
+
+        unsigned short mainCodes[LZX_MAINTREE_MAXSYMBOLS];
+        unsigned short lengthCodes[LZX_NUM_SECONDARY_LENGTHS];
+
+        buildCodes(m_mainLens, m_mainElements, mainCodes);
+        buildCodes(m_lengthLens, LZX_NUM_SECONDARY_LENGTHS, lengthCodes);
+
+        BitWriter bw(m_verbatim.data(), (int)m_verbatim.size());
+
+        writeBlockHeader(bw, LZX_BLOCKTYPE_VERBATIM, frameLen, first);
+
+        writeLengths(bw, m_prevMain, m_mainLens, 0, LZX_NUM_CHARS);
+        writeLengths(bw, m_prevMain, m_mainLens, LZX_NUM_CHARS, m_mainElements);
+        writeLengths(bw, m_prevLength, m_lengthLens, 0, LZX_NUM_SECONDARY_LENGTHS);
+
+        for (const Token &token : m_tokens)
+        {
+            bw.write(mainCodes[token.mainSym], m_mainLens[token.mainSym]);
+
+            if (token.lengthSym >= 0)
+                bw.write(lengthCodes[token.lengthSym], m_lengthLens[token.lengthSym]);
+
+            bw.write(token.extra, token.extraCount);
+        }
+
+        bw.align();
+
+        return bw.overflow() ? -1 : bw.size();
+    }
+
+    int writeUncompressed(int frameStart, int frameLen, bool first)
+    {
+        BitWriter bw(m_uncompressed.data(), (int)m_uncompressed.size());
+
+        writeBlockHeader(bw, LZX_BLOCKTYPE_UNCOMPRESSED, frameLen, first);
+
+        /* the decoder skips to the next word, or a whole word if already aligned */
+        if (bw.pending() == 0)
+            bw.write(0, 16);
+        else
+            bw.align();
+
+        unsigned int repeats[3] = { m_R0, m_R1, m_R2 };
+
+        for (unsigned int r : repeats)
+        {
+            bw.writeByte(r & 0xff);
+            bw.writeByte((r >> 8) & 0xff);
+            bw.writeByte((r >> 16) & 0xff);
+            bw.writeByte((r >> 24) & 0xff);
+        }
+
+        for (int i = 0; i < frameLen; i++)
+            bw.writeByte(m_in[frameStart + i]);
+
+        if (frameLen & 1)
+            bw.writeByte(0);
+
+        return bw.overflow() ? -1 : bw.size();
+    }
+
+    const unsigned char *m_in;
+    int m_inLen;
+    int m_windowSize;
+    int m_maxOffset;
+    int m_mainElements;
+    LevelConfig m_config;
+    bool m_store;
+
+    std::vector<int> m_head;
+    std::vector<int> m_prev;
+    int m_inserted;
+
+    unsigned int m_R0, m_R1, m_R2;
+
+    std::vector<Token> m_tokens;
+
+    unsigned char m_mainLens[LZX_MAINTREE_MAXSYMBOLS];
+    unsigned char m_lengthLens[LZX_NUM_SECONDARY_LENGTHS];
+    unsigned char m_prevMain[LZX_MAINTREE_MAXSYMBOLS];
+    unsigned char m_prevLength[LZX_NUM_SECONDARY_LENGTHS];
+
+    std::vector<unsigned char> m_verbatim;
+    std::vector<unsigned char> m_uncompressed;
+};
+
+int lzxCompressBound(int inLen)
+{
+    int frames = (inLen + LZX_FRAME_SIZE - 1) / LZX_FRAME_SIZE;
+
+    /* every frame can fall back to an uncompressed block */
+    return inLen + frames * (5 + 4 + 12 + 2) + 16;
+}
+
+int lzxCompress(const unsigned char *in, int inLen, unsigned char *out, int outCapacity, int window, int level)
+{
+    if (window < 15 || window > 21 || inLen < 0)
+        return -1;
+
+    LzxCompressor compressor(in, inLen, window, level);
+
+    return compressor.compress(out, outCapacity);
+}
@@ -0,0 +1,34 @@
+/***************************************************************************
+ *                      lzxcomp.h - LZX compression routines               *
+ *                                                                         *
+ *  Produces the framed stream read by Util::lzxDecompress: one verbatim   *
+ *  (or uncompressed) block per 32Kb frame, each frame prefixed by its     *
+ *  compressed size, and a 0xFF prefix with both sizes on a short final    *
+ *  frame. Matches are found with hash chains.                             *
+ ***************************************************************************/
+
+#ifndef LZXCOMP_H_
+#define LZXCOMP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LZX_LEVEL_STORE   (0) /* uncompressed blocks only */
+#define LZX_LEVEL_FASTEST (1)
+#define LZX_LEVEL_DEFAULT (6)
+#define LZX_LEVEL_BEST    (9)
+
+#define LZX_FRAME_SIZE    (0x8000)
+
+    /* largest framed stream lzxCompress can produce for inLen bytes */
+    int lzxCompressBound(int inLen);
+
+    /* compresses in to out, returns the framed stream size or -1 on failure */
+    int lzxCompress(const unsigned char *in, int inLen, unsigned char *out, int outCapacity, int window, int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZXCOMP_H_
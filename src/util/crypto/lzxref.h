@@ -0,0 +1,28 @@
+/***************************************************************************
+ *             lzxref.h - reference LZX decompression routines             *
+ *                                                                         *
+ *  The decoder lzx.c replaced, with the same interface. It is slower and  *
+ *  only used to check and time the current decoder against.               *
+ ***************************************************************************/
+
+#ifndef LZXREF_H_
+#define LZXREF_H_
+
+#include "lzx.h" /* return codes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    struct LZXrefstate;
+
+    struct LZXrefstate *lzxRefInit(int window);
+    void lzxRefTeardown(struct LZXrefstate *pState);
+    int lzxRefReset(struct LZXrefstate *pState);
+    int lzxRefDecompress(struct LZXrefstate *pState, unsigned char *inPos, unsigned char *outPos, int inLen, int outLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LZXREF_H_
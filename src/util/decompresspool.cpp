@@ -0,0 +1,115 @@
+#include "decompresspool.h"
+
+#include <atomic>
+#include <vector>
+
+#include "crypto/lzx.h"
+
+#define LZX_WINDOW 17
+
+static std::atomic<qint64> s_lzxAllocated(0);
+static std::atomic<qint64> s_lzxReused(0);
+static std::atomic<qint64> s_inflateAllocated(0);
+static std::atomic<qint64> s_inflateReused(0);
+
+// contexts not currently handed out, freed when the thread exits
+struct ThreadContexts
+{
+    std::vector<LZXstate*> lzx;
+    std::vector<z_stream*> inflate;
+
+    ~ThreadContexts()
+    {
+        for (LZXstate *state : lzx)
+            lzxTeardown(state);
+
+        for (z_stream *stream : inflate)
+        {
+            inflateEnd(stream);
+            delete stream;
+        }
+    }
+};
+
+static thread_local ThreadContexts t_contexts;
+
+DecompressStats DecompressPool::getStats()
+{
+    DecompressStats stats;
+
+    stats.lzxAllocated     = s_lzxAllocated;
+    stats.lzxReused        = s_lzxReused;
+    stats.inflateAllocated = s_inflateAllocated;
+    stats.inflateReused    = s_inflateReused;
+
+    return stats;
+}
+
+LzxContext::LzxContext()
+{
+    if (!t_contexts.lzx.empty())
+    {
+        m_state = t_contexts.lzx.back();
+        t_contexts.lzx.pop_back();
+
+        lzxReset(m_state);
+        s_lzxReused++;
+
+        return;
+    }
+
+    m_state = lzxInit(LZX_WINDOW);
+
+    if (m_state != nullptr)
+        s_lzxAllocated++;
+}
+
+LzxContext::~LzxContext()
+{
+    if (m_state != nullptr)
+        t_contexts.lzx.push_back(m_state);
+}
+
+InflateContext::InflateContext()
+{
+    if (!t_contexts.inflate.empty())
+    {
+        m_stream = t_contexts.inflate.back();
+        t_contexts.inflate.pop_back();
+
+        // keeps the allocated state and window
+        if (inflateReset(m_stream) == Z_OK)
+        {
+            s_inflateReused++;
+            return;
+        }
+
+        inflateEnd(m_stream);
+        delete m_stream;
+    }
+
+    m_stream = new z_stream();
+
+    m_stream->zalloc = Z_NULL;
+    m_stream->zfree  = Z_NULL;
+    m_stream->opaque = Z_NULL;
+
+    m_stream->avail_in = 0;
+    m_stream->next_in  = Z_NULL;
+
+    if (inflateInit(m_stream) != Z_OK)
+    {
+        delete m_stream;
+        m_stream = nullptr;
+
+        return;
+    }
+
+    s_inflateAllocated++;
+}
+
+InflateContext::~InflateContext()
+{
+    if (m_stream != nullptr)
+        t_contexts.inflate.push_back(m_stream);
+}
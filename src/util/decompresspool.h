@@ -0,0 +1,68 @@
+#ifndef DECOMPRESSPOOL_H
+#define DECOMPRESSPOOL_H
+
+#include <QtGlobal>
+
+#include "crypto/zlib.h"
+
+struct LZXstate;
+
+struct DecompressStats
+{
+    qint64 lzxAllocated     = 0;
+    qint64 lzxReused        = 0;
+    qint64 inflateAllocated = 0;
+    qint64 inflateReused    = 0;
+};
+
+// Every thread keeps the LZX and inflate contexts it has used, and hands
+// them out again after a reset instead of allocating new ones. A batch
+// worker allocates once per codec and reuses them for every later script.
+class DecompressPool
+{
+public:
+    static DecompressStats getStats();
+
+private:
+    DecompressPool() = delete;
+
+    friend class LzxContext;
+    friend class InflateContext;
+};
+
+// A window 17 LZX state from this thread's pool, returned when destroyed
+class LzxContext
+{
+public:
+    LzxContext();
+    ~LzxContext();
+
+    LzxContext(const LzxContext &) = delete;
+    LzxContext &operator=(const LzxContext &) = delete;
+
+    bool isValid() const { return m_state != nullptr; }
+    LZXstate *get() const { return m_state; }
+
+private:
+    LZXstate *m_state;
+};
+
+// An inflate stream from this thread's pool, returned when destroyed.
+// The caller sets next_in/next_out, the stream is already reset.
+class InflateContext
+{
+public:
+    InflateContext();
+    ~InflateContext();
+
+    InflateContext(const InflateContext &) = delete;
+    InflateContext &operator=(const InflateContext &) = delete;
+
+    bool isValid() const { return m_stream != nullptr; }
+    z_stream *get() const { return m_stream; }
+
+private:
+    z_stream *m_stream;
+};
+
+#endif // DECOMPRESSPOOL_H
@@ -0,0 +1,62 @@
+#include "keyring.h"
+
+#include <mutex>
+
+#include <QFile>
+
+static std::mutex s_mutex;
+static QString s_keyPath = "rdr_key.bin";
+static bool s_loaded = false;
+
+AesSchedule::AesSchedule(const QByteArray &key)
+    : key(key)
+{
+    if (!isValid())
+        return;
+
+    aestable_init(&table, (const uint8_t*)key.constData());
+
+    if (aesni_supported())
+        aesni_init(&ni, (const uint8_t*)key.constData());
+}
+
+bool KeyRing::setKeyPath(QString path)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    if (s_loaded)
+        return false;
+
+    s_keyPath = path;
+
+    return true;
+}
+
+QString KeyRing::getKeyPath()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    return s_keyPath;
+}
+
+static AesSchedule loadSchedule()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    s_loaded = true;
+
+    QFile file(s_keyPath);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return AesSchedule();
+    }
+
+    return AesSchedule(file.readAll());
+}
+
+const AesSchedule &KeyRing::get()
+{
+    static const AesSchedule schedule = loadSchedule();
+    return schedule;
+}
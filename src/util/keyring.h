@@ -0,0 +1,38 @@
+#ifndef KEYRING_H
+#define KEYRING_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "crypto/aesni.h"
+#include "crypto/aestable.h"
+
+// A key with its schedules expanded for every backend
+struct AesSchedule
+{
+    AesSchedule() = default;
+    explicit AesSchedule(const QByteArray &key);
+
+    bool isValid() const { return key.size() >= 32; }
+
+    QByteArray key; // the portable backend expands the raw key itself
+    aestable_context table;
+    aesni_context ni; // only filled when the cpu supports AES-NI
+};
+
+// Process-wide AES key, loaded from disk once on first use and read-only
+// afterwards, so any thread can use it without locking.
+class KeyRing
+{
+public:
+    // only has an effect before the key is first used, returns false otherwise
+    static bool setKeyPath(QString path);
+    static QString getKeyPath();
+
+    static const AesSchedule &get(); // invalid if the key file can't be read
+
+private:
+    KeyRing() = delete;
+};
+
+#endif // KEYRING_H
@@ -0,0 +1,231 @@
+#include "streamextractor.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "decompresspool.h"
+#include "keyring.h"
+#include "util.h"
+#include "crypto/lzx.h"
+#include "crypto/zlib.h"
+
+StreamExtractor::StreamExtractor(const char *in, int inSize, Codec codec)
+    : m_in(in)
+    , m_inSize(inSize)
+    , m_codec(codec)
+    , m_buffer(nullptr)
+    , m_decrypted(0)
+    , m_released(0)
+    , m_aborted(false)
+{
+}
+
+int StreamExtractor::extract(char *out, int outSize)
+{
+    if (!KeyRing::get().isValid())
+        return EXTRACT_NOKEY;
+
+    m_ring.fill(0, RING_SIZE + MAX_FRAME + READ_AHEAD);
+    m_buffer = m_ring.data();
+
+    m_decrypted = 0;
+    m_released  = 0;
+    m_aborted   = false;
+
+    std::thread decryptor(&StreamExtractor::decryptLoop, this);
+
+    int res = (m_codec == CODEC_LZX) ? extractLzx(out, outSize) : extractZlib(out, outSize);
+
+    // stop the decryptor in case decompression finished or failed early
+    abort();
+    decryptor.join();
+
+    return res;
+}
+
+void StreamExtractor::decryptLoop()
+{
+    for (int pos = 0; pos < m_inSize; pos += CHUNK_SIZE)
+    {
+        int len = std::min(CHUNK_SIZE, m_inSize - pos);
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            // don't overwrite data the decompressor hasn't released yet
+            m_cond.wait(lock, [&]{ return m_aborted || pos + len - m_released <= RING_SIZE; });
+
+            if (m_aborted)
+                return;
+        }
+
+        char *dst = m_buffer + (pos % RING_SIZE);
+
+        // a trailing partial block is left as is, same as Util::decrypt
+        if (!Util::decrypt(m_in + pos, dst, len))
+            memcpy(dst, m_in + pos, len);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_decrypted = pos + len;
+        }
+
+        m_cond.notify_all();
+    }
+}
+
+int StreamExtractor::waitDecrypted(int end)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_cond.wait(lock, [&]{ return m_decrypted >= end; });
+
+    return m_decrypted;
+}
+
+const unsigned char *StreamExtractor::acquire(int begin, int end)
+{
+    // wait for a few extra bytes, so the bit reader never peeks at data still being decrypted
+    int needed = std::min(end + READ_AHEAD, m_inSize);
+
+    waitDecrypted(needed);
+
+    int ringPos = begin % RING_SIZE;
+    int length  = needed - begin;
+
+    // frame wraps around the end of the ring, copy the wrapped part behind it
+    if (ringPos + length > RING_SIZE)
+    {
+        memcpy(m_buffer + RING_SIZE, m_buffer, ringPos + length - RING_SIZE);
+    }
+
+    return (const unsigned char *)m_buffer + ringPos;
+}
+
+void StreamExtractor::release(int end)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_released = end;
+    }
+
+    m_cond.notify_all();
+}
+
+void StreamExtractor::abort()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_aborted = true;
+    }
+
+    m_cond.notify_all();
+}
+
+int StreamExtractor::extractLzx(char *out, int outSize)
+{
+    LzxContext context;
+
+    if (!context.isValid())
+        return DECR_NOMEMORY;
+
+    struct LZXstate *lzx_state = context.get();
+
+    int offset = 8; // skip lzx header
+    int outputSize = 0;
+    int res = DECR_OK;
+
+    while (outputSize != outSize)
+    {
+        if (offset + 2 > m_inSize)
+        {
+            res = DECR_DATAFORMAT;
+            break;
+        }
+
+        const unsigned char *header = acquire(offset, std::min(offset + 5, m_inSize));
+
+        int frameOutSize;
+        int frameInSize;
+
+        if (header[0] == 0xff)
+        {
+            if (offset + 5 > m_inSize)
+            {
+                res = DECR_DATAFORMAT;
+                break;
+            }
+
+            frameOutSize = (header[1] << 8) | header[2];
+            frameInSize  = (header[3] << 8) | header[4];
+
+            offset += 5;
+        }
+        else
+        {
+            frameOutSize = 0x8000;
+            frameInSize  = (header[0] << 8) | header[1];
+
+            if (frameInSize == 0)
+                break;
+
+            offset += 2;
+        }
+
+        if (offset + frameInSize > m_inSize || outputSize + frameOutSize > outSize)
+        {
+            res = DECR_DATAFORMAT;
+            break;
+        }
+
+        const unsigned char *frame = acquire(offset, offset + frameInSize);
+
+        res = ::lzxDecompress(lzx_state, (unsigned char *)frame, (unsigned char *)out + outputSize, frameInSize, frameOutSize);
+
+        if (res != DECR_OK)
+            break;
+
+        offset += frameInSize;
+        outputSize += frameOutSize;
+
+        release(offset);
+    }
+
+    return res;
+}
+
+int StreamExtractor::extractZlib(char *out, int outSize)
+{
+    InflateContext context;
+
+    if (!context.isValid())
+        return Z_MEM_ERROR;
+
+    z_stream *infstream = context.get();
+
+    infstream->avail_out = (uInt)outSize;
+    infstream->next_out  = (Bytef *)out;
+
+    int res = Z_OK;
+    int offset = 0;
+
+    // inflate takes input in pieces, so feed it whatever has been decrypted so far
+    while (res == Z_OK && infstream->avail_out > 0 && offset < m_inSize)
+    {
+        int available = waitDecrypted(offset + 1) - offset;
+        int ringPos = offset % RING_SIZE;
+
+        infstream->next_in  = (Bytef *)m_buffer + ringPos;
+        infstream->avail_in = (uInt)std::min(available, RING_SIZE - ringPos);
+
+        uInt fed = infstream->avail_in;
+
+        res = inflate(infstream, Z_NO_FLUSH);
+
+        offset += fed - infstream->avail_in;
+
+        release(offset);
+    }
+
+    return (res == Z_STREAM_END || res == Z_OK) ? Z_OK : res;
+}
@@ -0,0 +1,63 @@
+#ifndef STREAMEXTRACTOR_H
+#define STREAMEXTRACTOR_H
+
+#include <condition_variable>
+#include <mutex>
+
+#include <QByteArray>
+
+// Decrypts and decompresses an RSC payload in one pass. A worker thread
+// decrypts into a small ring buffer while the calling thread decompresses
+// each LZX frame (or zlib chunk) straight into the output buffer.
+class StreamExtractor
+{
+public:
+    enum Codec
+    {
+        CODEC_LZX,
+        CODEC_ZLIB
+    };
+
+    enum Error
+    {
+        EXTRACT_OK    = 0,
+        EXTRACT_NOKEY = -100
+    };
+
+    StreamExtractor(const char *in, int inSize, Codec codec);
+
+    // returns 0 on success, otherwise an EXTRACT_*, DECR_* or zlib error code
+    int extract(char *out, int outSize);
+
+private:
+    static constexpr int CHUNK_SIZE = 0x4000;
+    static constexpr int RING_SIZE  = 0x40000;
+    static constexpr int MAX_FRAME  = 0x10000 + 5; // largest frame, header included
+    static constexpr int READ_AHEAD = 16;          // the lzx bit reader peeks past the frame end
+
+    void decryptLoop();
+
+    // blocks until payload bytes [begin, end) are decrypted, returns them contiguously
+    const unsigned char *acquire(int begin, int end);
+    int  waitDecrypted(int end);
+    void release(int end);
+    void abort();
+
+    int extractLzx(char *out, int outSize);
+    int extractZlib(char *out, int outSize);
+
+    const char *m_in;
+    int m_inSize;
+    Codec m_codec;
+
+    QByteArray m_ring; // RING_SIZE bytes of ring, followed by room to unwrap one frame
+    char *m_buffer;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    int m_decrypted; // payload bytes available in the ring
+    int m_released;  // payload bytes the decompressor is done with
+    bool m_aborted;
+};
+
+#endif // STREAMEXTRACTOR_H
@@ -0,0 +1,172 @@
+#include "textbuffer.h"
+
+// two digits per byte, so hex is one table load per byte
+struct HexTable
+{
+    char upper[256][2];
+    char lower[256][2];
+
+    constexpr HexTable() : upper(), lower()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            upper[i][0] = "0123456789ABCDEF"[i >> 4];
+            upper[i][1] = "0123456789ABCDEF"[i & 15];
+            lower[i][0] = "0123456789abcdef"[i >> 4];
+            lower[i][1] = "0123456789abcdef"[i & 15];
+        }
+    }
+};
+
+static constexpr HexTable s_hex;
+
+TextBuffer &TextBuffer::scratch()
+{
+    thread_local TextBuffer buffer;
+
+    buffer.clear();
+    return buffer;
+}
+
+void TextBuffer::appendDecimal(int value)
+{
+    char digits[16];
+    char *end = digits + sizeof(digits);
+    char *first = end;
+
+    unsigned int magnitude = (value < 0) ? 0u - (unsigned int)value : (unsigned int)value;
+
+    do
+    {
+        *--first = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (value < 0)
+        *--first = '-';
+
+    append(first, (int)(end - first));
+}
+
+void TextBuffer::appendHex(unsigned int value, int digits, bool upper)
+{
+    const char *table = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+    int count = 1;
+
+    while (count < 8 && (value >> (count * 4)) != 0)
+    {
+        count++;
+    }
+
+    count = std::max(count, digits);
+
+    char *out = grow(count);
+
+    for (int i = count - 1; i >= 0; i--, value >>= 4)
+    {
+        out[i] = table[value & 15];
+    }
+}
+
+void TextBuffer::appendHexBytes(const unsigned char *bytes, int count, bool upper)
+{
+    const char (*table)[2] = upper ? s_hex.upper : s_hex.lower;
+
+    char *out = grow(count * 2);
+
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(out + i * 2, table[bytes[i]], 2);
+    }
+}
+
+void TextBuffer::leftJustify(int start, int width)
+{
+    int length = m_size - start;
+
+    // a character takes at most three bytes of utf-8 per utf-16 unit
+    if (length >= width * 3)
+        return;
+
+    for (int i = start; i < m_size; i++)
+    {
+        if ((unsigned char)m_data[i] >= 0x80)
+        {
+            length = QString::fromUtf8(m_data.data() + start, m_size - start).size();
+            break;
+        }
+    }
+
+    if (length < width)
+        memset(grow(width - length), ' ', width - length);
+}
+
+void TextBuffer::appendJsonString(const char *text, int length)
+{
+    append('"');
+
+    for (int i = 0; i < length; i++)
+    {
+        unsigned char c = text[i];
+
+        if (c == '"' || c == '\\')
+        {
+            append('\\');
+            append((char)c);
+        }
+        else if (c == '\n')
+        {
+            append("\\n", 2);
+        }
+        else if (c == '\t')
+        {
+            append("\\t", 2);
+        }
+        else if (c < 0x20)
+        {
+            append("\\u00", 4);
+            appendHexBytes(&c, 1, false);
+        }
+        else
+        {
+            append((char)c);
+        }
+    }
+
+    append('"');
+}
+
+void TextBuffer::appendCsvField(const char *text, int length)
+{
+    bool quote = false;
+
+    for (int i = 0; i < length && !quote; i++)
+    {
+        quote = (text[i] == ',' || text[i] == '"' || text[i] == '\n' || text[i] == '\r');
+    }
+
+    if (!quote)
+    {
+        append(text, length);
+        return;
+    }
+
+    append('"');
+
+    for (int i = 0; i < length; i++)
+    {
+        if (text[i] == '"')
+            append('"');
+
+        append(text[i]);
+    }
+
+    append('"');
+}
+
+void TextBuffer::flush(QTextStream &stream)
+{
+    stream << toString();
+    clear();
+}
@@ -0,0 +1,63 @@
+#ifndef TEXTBUFFER_H
+#define TEXTBUFFER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Growable utf-8 buffer that rows of text are written straight into, so a
+// listing is formatted without a string per field. Keeps its memory across
+// clear(), so one buffer serves a whole export.
+class TextBuffer
+{
+public:
+    explicit TextBuffer(int capacity = 256) : m_data(capacity), m_size(0) {}
+
+    // a cleared buffer owned by the calling thread, for formatting a single value
+    static TextBuffer &scratch();
+
+    const char *data() const { return m_data.data(); }
+    int size() const         { return m_size;        }
+    void clear()             { m_size = 0;           }
+
+    void append(char c)                       { *grow(1) = c;                          }
+    void append(const char *text, int length) { memcpy(grow(length), text, length);    }
+    void append(const char *text)             { append(text, (int)strlen(text));       }
+    void append(const QByteArray &text)       { append(text.constData(), text.size()); }
+
+    void appendDecimal(int value);
+    void appendHex(unsigned int value, int digits, bool upper = true); // zero padded to at least digits
+    void appendHexBytes(const unsigned char *bytes, int count, bool upper = true);
+
+    // pads what was written since start with spaces to width characters, as QString::leftJustified does
+    void leftJustify(int start, int width);
+
+    void appendJsonString(const char *text, int length); // quoted, with quotes, backslashes and controls escaped
+    void appendCsvField(const char *text, int length);   // quoted only when it has a separator, quote or line break
+
+    QString toString() const { return QString::fromUtf8(data(), size()); }
+
+    // hands the text to the stream and clears the buffer, only call it between rows
+    void flush(QTextStream &stream);
+
+private:
+    char *grow(int count)
+    {
+        if (m_size + count > (int)m_data.size())
+            m_data.resize(std::max(m_data.size() * 2, (size_t)(m_size + count)));
+
+        char *end = m_data.data() + m_size;
+        m_size += count;
+
+        return end;
+    }
+
+    std::vector<char> m_data;
+    int m_size;
+};
+
+#endif // TEXTBUFFER_H
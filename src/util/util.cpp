@@ -1,192 +1,534 @@
 #include "util.h"
 
 #include <QFile>
-#include <QMessageBox>
 #include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "decompresspool.h"
+#include "keyring.h"
 
 #include "crypto/aes256.h"
 #include "crypto/lzx.h"
-#include "crypto/xcompress.h"
+#include "crypto/lzxref.h"
 #include "crypto/zlib.h"
 
 #define CHUNK 16384
+#define AES_PASSES 16 // rdr runs every block through the cipher 16 times
+
+#define AES_SHARD_SIZE 0x40000 // smallest range worth its own thread
+
+#define ZLIB_CHUNK_SIZE 0x20000 // plaintext deflated independently by one thread
+#define ZLIB_DICT_SIZE  0x8000  // each chunk is primed with the 32 KB before it
+#define INFLATE_STEP    0x10000 // output produced between progress reports
+
+static std::atomic<int> s_aesBackend(aesni_supported() ? AesBackend::AES_NI : AesBackend::AES_TTABLE);
+static std::atomic<int> s_aesThreads(0);
+
+// splits the blocks of an ecb buffer over threads, kernel(data, blocks) runs once per range
+template <typename Kernel>
+static void aesShard(uint8_t *data, uint32_t blocks, Kernel kernel)
+{
+    int count = s_aesThreads.load();
+
+    uint32_t threads = count > 0 ? count : QThread::idealThreadCount();
+    threads = std::min(threads, (blocks * 16) / AES_SHARD_SIZE);
+
+    if (threads <= 1)
+    {
+        kernel(data, blocks);
+        return;
+    }
+
+    uint32_t perThread = (blocks + threads - 1) / threads;
+    std::vector<std::thread> workers;
+
+    for (uint32_t first = perThread; first < blocks; first += perThread)
+    {
+        workers.emplace_back(kernel, data + first * 16, std::min(perThread, blocks - first));
+    }
+
+    kernel(data, perThread);
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+QString Util::errorToString(ErrorCode error)
+{
+    switch (error)
+    {
+        case ERR_NONE:              return "No error.";
+        case ERR_OPEN_FAILED:       return "Error: Unable to open script.";
+        case ERR_INVALID_SCRIPT:    return "Error: Invalid script.";
+        case ERR_NO_HEADER:         return "Error: Unable to find script header.";
+        case ERR_NO_KEY:            return QString("Error: Unable to retrieve AES key. Make sure '%1' exists.").arg(KeyRing::getKeyPath());
+        case ERR_DECOMPRESS_FAILED: return "Error: Decompression failed.";
+        case ERR_COMPRESS_FAILED:   return "Error: Compression failed.";
+        case ERR_NATIVES_FAILED:    return "Error: Failed to read natives. Only hashes will be available.";
+        case ERR_WRITE_FAILED:      return "Error: Unable to write to output file.";
+        case ERR_INVALID_ARGUMENTS: return "Error: Invalid arguments.";
+        case ERR_SELFTEST_FAILED:   return "Error: Self test failed.";
+        case ERR_STACK_UNBALANCED:  return "Error: The compiled code doesn't keep the stack balanced.";
+    }
+
+    return QString("Error: Unknown error (%1).").arg(error);
+}
 
 QByteArray Util::getAESKey()
 {
-    QFile key("rdr_key.bin");
+    return KeyRing::get().key;
+}
+
+AesBackend Util::getAesBackend()
+{
+    return (AesBackend)s_aesBackend.load();
+}
+
+bool Util::setAesBackend(AesBackend backend)
+{
+    if (!isAesBackendSupported(backend))
+        return false;
+
+    s_aesBackend = backend;
 
-    if (!key.open(QIODevice::ReadOnly))
+    return true;
+}
+
+bool Util::isAesBackendSupported(AesBackend backend)
+{
+    switch (backend)
     {
-        QMessageBox::critical(nullptr, "Error", "Error: Unable to retrieve AES key. Make sure 'key.bin' exists in the root directory.");
-        return QByteArray();
+        case AES_PORTABLE: return true;
+        case AES_TTABLE:   return true;
+        case AES_NI:       return aesni_supported() != 0;
     }
 
-    return key.readAll();
+    return false;
 }
 
-QByteArray Util::decrypt(QByteArray in)
+int Util::getAesThreadCount()
 {
-    QByteArray result(in);
+    return s_aesThreads;
+}
 
-    if (result.size() == 0)
-        return QByteArray();
+void Util::setAesThreadCount(int count)
+{
+    s_aesThreads = count;
+}
 
-    uint32_t inputCount = result.size() & -16;
-    if (inputCount > 0)
+QString Util::aesBackendToString(AesBackend backend)
+{
+    switch (backend)
     {
+        case AES_PORTABLE: return "portable";
+        case AES_TTABLE:   return "ttable";
+        case AES_NI:       return "aes-ni";
+    }
+
+    return "unknown";
+}
+
+// runs the 16 pass rdr construction over every whole block of out
+static void aesCrypt(const AesSchedule &schedule, bool decrypt, uint8_t *out, uint32_t blocks)
+{
+    if (Util::getAesBackend() == AesBackend::AES_NI)
+    {
+        aesShard(out, blocks, [&](uint8_t *data, uint32_t count)
+        {
+            if (decrypt)
+                aesni_decrypt_ecb(&schedule.ni, data, count, AES_PASSES);
+            else
+                aesni_encrypt_ecb(&schedule.ni, data, count, AES_PASSES);
+        });
+
+        return;
+    }
+
+    if (Util::getAesBackend() == AesBackend::AES_TTABLE)
+    {
+        aesShard(out, blocks, [&](uint8_t *data, uint32_t count)
+        {
+            if (decrypt)
+                aestable_decrypt_ecb(&schedule.table, data, count, AES_PASSES);
+            else
+                aestable_encrypt_ecb(&schedule.table, data, count, AES_PASSES);
+        });
+
+        return;
+    }
+
+    aesShard(out, blocks, [&](uint8_t *data, uint32_t count)
+    {
+        // the context is modified while running, so each thread needs its own
         aes256_context ctx;
-        aes256_init(&ctx, const_cast<uint8_t*>((uint8_t*)Util::getAESKey().data()));
+        aes256_init(&ctx, (uint8_t*)schedule.key.constData());
 
-        for (uint32_t i = 0; i < inputCount; i += 16)
+        for (uint32_t i = 0; i < count * 16; i += 16)
         {
-            for (uint32_t b = 0; b < 16; b++)
-                aes256_decrypt_ecb(&ctx, (uint8_t*)result.data() + i);
+            for (uint32_t b = 0; b < AES_PASSES; b++)
+            {
+                if (decrypt)
+                    aes256_decrypt_ecb(&ctx, data + i);
+                else
+                    aes256_encrypt_ecb(&ctx, data + i);
+            }
         }
 
         aes256_done(&ctx);
-        return result;
-    }
+    });
+}
 
-    return QByteArray();
+static bool aesCrypt(const AesSchedule &schedule, bool decrypt, const char *in, char *out, int size)
+{
+    uint32_t inputCount = size & -16;
+
+    if (inputCount == 0 || !schedule.isValid())
+        return false;
+
+    if (in != out)
+        memcpy(out, in, size);
+
+    aesCrypt(schedule, decrypt, (uint8_t*)out, inputCount / 16);
+
+    return true;
 }
 
-QByteArray Util::encrypt(QByteArray in)
+QByteArray Util::decrypt(QByteArray in)
 {
     QByteArray result(in);
 
-    if (in.size() == 0)
+    if (result.size() == 0)
         return QByteArray();
 
-    uint32_t inputCount = in.size() & -16;
+    uint32_t inputCount = result.size() & -16;
     if (inputCount > 0)
     {
-        aes256_context ctx;
-        aes256_init(&ctx, const_cast<uint8_t*>((uint8_t*)Util::getAESKey().data()));
-
-        for (uint32_t i = 0; i < inputCount; i += 16)
-        {
-            for (uint32_t b = 0; b < 16; b++)
-                aes256_encrypt_ecb(&ctx, (uint8_t*)result.data() + i);
-        }
-
-        aes256_done(&ctx);
+        decrypt(in.constData(), result.data(), inputCount);
         return result;
     }
 
     return QByteArray();
 }
 
+bool Util::decrypt(const char *in, char *out, int size)
+{
+    return aesCrypt(KeyRing::get(), true, in, out, size);
+}
 
-QByteArray Util::lzxDecompress(QByteArray in, int outSize)
+bool Util::decrypt(const char *in, char *out, int size, const QByteArray &key)
 {
-    QByteArray result;
-    result.resize(outSize);
+    return aesCrypt(AesSchedule(key), true, in, out, size);
+}
 
-    struct LZXstate *lzx_state = lzxInit(17);
+QByteArray Util::encrypt(QByteArray in)
+{
+    QByteArray result(in);
 
-    int outputSize = 0;
+    if (in.size() == 0)
+        return QByteArray();
+
+    if (!aesCrypt(KeyRing::get(), false, in.constData(), result.data(), in.size()))
+        return QByteArray();
+
+    return result;
+}
+
+bool Util::encrypt(const char *in, char *out, int size, const QByteArray &key)
+{
+    return aesCrypt(AesSchedule(key), false, in, out, size);
+}
 
+QByteArray Util::lzxDecompress(QByteArray in, int outSize, int *result)
+{
+    QByteArray out;
+    out.resize(outSize);
+
+    int res = lzxDecompress(in.constData(), in.size(), out.data(), outSize);
+
+    if (result != nullptr)
+        *result = res;
+
+    return out;
+}
+
+// splits the framed stream and hands each frame to decode(in, out, inLen, outLen)
+template<typename Decode>
+static int lzxDecompressFrames(const char *in, int inSize, char *out, int outSize, Decode decode)
+{
+    const unsigned char *src = (const unsigned char *)in;
+
+    int outputSize = 0;
     int offset = 0;
+    int res = DECR_OK;
 
-    while (outputSize != result.size())
+    while (outputSize != outSize)
     {
         int tmpoutputSize = 0;
         int tmpinputSize = 0;
 
-        if (*(unsigned char *)(in.data() + offset) == 0xff)
+        if (offset + 2 > inSize)
+        {
+            res = DECR_DATAFORMAT;
+            break;
+        }
+
+        if (src[offset] == 0xff)
         {
-            tmpoutputSize  = *(unsigned char *)(in.data() + offset + 1) << 8;
-            tmpoutputSize |= *(unsigned char *)(in.data() + offset + 2);
-            tmpinputSize   = *(unsigned char *)(in.data() + offset + 3) << 8;
-            tmpinputSize  |= *(unsigned char *)(in.data() + offset + 4);
+            if (offset + 5 > inSize)
+            {
+                res = DECR_DATAFORMAT;
+                break;
+            }
+
+            tmpoutputSize  = src[offset + 1] << 8;
+            tmpoutputSize |= src[offset + 2];
+            tmpinputSize   = src[offset + 3] << 8;
+            tmpinputSize  |= src[offset + 4];
 
             offset += 5;
         }
         else
         {
             tmpoutputSize = 0x8000;
-            tmpinputSize = (*(unsigned char *)(in.data() + offset) << 8) | *(unsigned char *)(in.data() + offset + 1);
+            tmpinputSize = (src[offset] << 8) | src[offset + 1];
             if (tmpinputSize == 0)
                 break;
             offset += 2;
         }
 
-        int res = ::lzxDecompress(lzx_state, (unsigned char*)in.data() + offset, (unsigned char*)result.data() + outputSize, tmpinputSize, tmpoutputSize);
-
-        if (res != 0)
+        if (offset + tmpinputSize > inSize || outputSize + tmpoutputSize > outSize)
         {
-            QMessageBox::critical(0, "Error", QString("Error: LZX decompression failed! (Error code: %1)").arg(res));
+            res = DECR_DATAFORMAT;
             break;
         }
 
+        res = decode((unsigned char*)src + offset, (unsigned char*)out + outputSize, tmpinputSize, tmpoutputSize);
+
+        if (res != DECR_OK)
+            break;
+
         offset += tmpinputSize;
         outputSize += tmpoutputSize;
     }
 
-    lzxTeardown(lzx_state);
+    return res;
+}
 
-    return result;
+int Util::lzxDecompress(const char *in, int inSize, char *out, int outSize)
+{
+    LzxContext context;
+
+    if (!context.isValid())
+        return DECR_NOMEMORY;
+
+    struct LZXstate *lzx_state = context.get();
+
+    return lzxDecompressFrames(in, inSize, out, outSize, [lzx_state](unsigned char *inPos, unsigned char *outPos, int inLen, int outLen)
+    {
+        return ::lzxDecompress(lzx_state, inPos, outPos, inLen, outLen);
+    });
 }
 
-QByteArray Util::lzxCompress(QByteArray in)
+int Util::lzxDecompressReference(const char *in, int inSize, char *out, int outSize)
 {
-    QByteArray compressedData;
-    xCompress compression;
-    int compressedLen = 0;
+    struct LZXrefstate *lzx_state = lzxRefInit(17);
 
-    compressedData.resize(in.size() + 8);
+    if (lzx_state == nullptr)
+        return DECR_NOMEMORY;
 
-    compression.xCompressInit();
-    compression.Compress(reinterpret_cast<unsigned char*>(in.data()), in.size(), (uint8_t*)compressedData.data() + 8, (int32_t*)&compressedLen);
+    int res = lzxDecompressFrames(in, inSize, out, outSize, [lzx_state](unsigned char *inPos, unsigned char *outPos, int inLen, int outLen)
+    {
+        return lzxRefDecompress(lzx_state, inPos, outPos, inLen, outLen);
+    });
+
+    lzxRefTeardown(lzx_state);
 
-    compressedData.remove(0, 4);
+    return res;
+}
 
-    QDataStream str(&compressedData, QIODevice::WriteOnly);
-    str << compressedLen;
+QByteArray Util::lzxCompress(QByteArray in, int level)
+{
+    QByteArray out;
+    out.resize(lzxCompressBound(in.size()) + 8);
 
-    compressedData.prepend("\x0F\xF5\x12\xF1"); // lzx header?
+    unsigned char *dst = (unsigned char*)out.data();
+
+    int compressedLen = ::lzxCompress((const unsigned char*)in.constData(), in.size(), dst + 8, out.size() - 8, 17, level);
+
+    if (compressedLen < 0)
+        return QByteArray();
 
-    compressedLen += 8;
+    // 0x0FF512F1 magic, then the big endian size of the framed stream
+    dst[0] = 0x0F;
+    dst[1] = 0xF5;
+    dst[2] = 0x12;
+    dst[3] = 0xF1;
+    dst[4] = (unsigned char)(compressedLen >> 24);
+    dst[5] = (unsigned char)(compressedLen >> 16);
+    dst[6] = (unsigned char)(compressedLen >> 8);
+    dst[7] = (unsigned char)compressedLen;
 
-    compressedData.resize(compressedLen);
+    out.resize(compressedLen + 8);
 
-    return compressedData;
+    return out;
 }
 
-QByteArray Util::zlibDecompress(QByteArray in, int outSize)
+QByteArray Util::zlibDecompress(QByteArray in, int outSize, int *result)
 {
-    QByteArray result;
-    result.resize(outSize);
+    QByteArray out;
+    out.resize(outSize);
+
+    int res = zlibDecompress(in.constData(), in.size(), out.data(), outSize);
+
+    if (result != nullptr)
+        *result = res;
 
-    z_stream infstream;
+    return out;
+}
 
-    infstream.zalloc = Z_NULL;
-    infstream.zfree  = Z_NULL;
-    infstream.opaque = Z_NULL;
+int Util::zlibDecompress(const char *in, int inSize, char *out, int outSize, const std::function<void(int, int)> &progress)
+{
+    InflateContext context;
 
-    infstream.avail_in  = (uInt)in.size();
-    infstream.next_in   = (Bytef *)in.data();
-    infstream.avail_out = (uInt)outSize;
-    infstream.next_out  = (Bytef *)result.data();
+    if (!context.isValid())
+        return Z_MEM_ERROR;
 
-    inflateInit(&infstream);
-    inflate(&infstream, Z_NO_FLUSH);
-    inflateEnd(&infstream);
+    z_stream *infstream = context.get();
 
-    return result;
+    infstream->avail_in = (uInt)inSize;
+    infstream->next_in  = (Bytef *)in;
+    infstream->next_out = (Bytef *)out;
+
+    int res = Z_OK;
+    int done = 0;
+
+    // hand out the output a step at a time so progress can be reported in between
+    while (res == Z_OK && done < outSize)
+    {
+        infstream->avail_out = (uInt)std::min(INFLATE_STEP, outSize - done);
+
+        res = inflate(infstream, Z_NO_FLUSH);
+
+        done = (int)((char *)infstream->next_out - out);
+
+        if (progress)
+            progress(done, outSize);
+    }
+
+    // the payload is padded for aes, so the stream may end before the input does
+    if (res == Z_STREAM_END || (res == Z_OK && done == outSize))
+        return Z_OK;
+
+    return (res == Z_OK) ? Z_BUF_ERROR : res;
 }
 
-QByteArray Util::zlibCompress(QByteArray in)
+// deflates one chunk as raw deflate, ending on a byte boundary unless it is the last
+static bool deflateChunk(const Bytef *in, int size, int dictSize, bool last, int level, std::vector<Bytef> &out)
 {
-    QByteArray result;
+    z_stream strm;
+
+    strm.zalloc = Z_NULL;
+    strm.zfree  = Z_NULL;
+    strm.opaque = Z_NULL;
+
+    if (deflateInit2(&strm, level, Z_DEFLATED, -MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
 
-    uLongf destLength = compressBound(in.size());
+    if (dictSize > 0)
+        deflateSetDictionary(&strm, in - dictSize, dictSize);
 
-    result.resize(destLength);
+    // room for the empty stored block a sync flush ends with
+    out.resize(deflateBound(&strm, size) + 16);
 
-    compress2((Bytef *) result.data(), &destLength, (Bytef *)in.data(), in.size(), Z_BEST_COMPRESSION);
+    strm.next_in   = (Bytef *)in;
+    strm.avail_in  = (uInt)size;
+    strm.next_out  = out.data();
+    strm.avail_out = (uInt)out.size();
 
-    result.resize(destLength);
+    int res = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+
+    bool ok = last ? (res == Z_STREAM_END) : (res == Z_OK && strm.avail_in == 0 && strm.avail_out > 0);
+
+    out.resize(strm.total_out);
+    deflateEnd(&strm);
+
+    return ok;
+}
+
+QByteArray Util::zlibCompress(QByteArray in, int level)
+{
+    const Bytef *data = (const Bytef *)in.constData();
+    int size = in.size();
+    int chunks = std::max(1, (size + ZLIB_CHUNK_SIZE - 1) / ZLIB_CHUNK_SIZE);
+
+    // a single chunk or stored blocks gain nothing from threads
+    if (chunks == 1 || level == 0)
+    {
+        uLongf destLength = compressBound(size);
+        QByteArray result(destLength, Qt::Uninitialized);
+
+        if (compress2((Bytef *)result.data(), &destLength, data, size, level) != Z_OK)
+            return QByteArray();
+
+        result.resize(destLength);
+
+        return result;
+    }
+
+    std::vector<std::vector<Bytef>> deflated(chunks);
+    std::vector<uLong> checksums(chunks);
+    std::atomic<bool> failed(false);
+
+    // like pigz, chunks only share the dictionary, so any thread can take the next one
+    parallelFor(chunks, 0, [&](int chunk)
+    {
+        int offset = chunk * ZLIB_CHUNK_SIZE;
+        int length = std::min(ZLIB_CHUNK_SIZE, size - offset);
+
+        checksums[chunk] = adler32(adler32(0, Z_NULL, 0), data + offset, (uInt)length);
+
+        if (!deflateChunk(data + offset, length, std::min(offset, ZLIB_DICT_SIZE), chunk == chunks - 1, level, deflated[chunk]))
+            failed = true;
+    });
+
+    if (failed)
+        return QByteArray();
+
+    // zlib header for a 32 KB window, with the level hint deflate itself would write
+    int levelFlag = (level < 0 || level == 6) ? 2 : (level < 2) ? 0 : (level < 6) ? 1 : 3;
+    unsigned int header = (0x78 << 8) | (levelFlag << 6);
+
+    header += 31 - header % 31;
+
+    uLong checksum = checksums[0];
+
+    for (int chunk = 1; chunk < chunks; chunk++)
+    {
+        int length = std::min(ZLIB_CHUNK_SIZE, size - chunk * ZLIB_CHUNK_SIZE);
+        checksum = adler32_combine(checksum, checksums[chunk], length);
+    }
+
+    QByteArray result;
+
+    result.append((char)(header >> 8));
+    result.append((char)header);
+
+    for (const std::vector<Bytef> &chunk : deflated)
+    {
+        result.append((const char *)chunk.data(), (int)chunk.size());
+    }
+
+    result.append((char)(checksum >> 24));
+    result.append((char)(checksum >> 16));
+    result.append((char)(checksum >> 8));
+    result.append((char)checksum);
 
     return result;
 }
@@ -258,7 +600,7 @@ unsigned int Util::hash(std::string str, bool lowercase)
     return value;
 }
 
-QMap<unsigned int, QString> Util::getNatives()
+QMap<unsigned int, QString> Util::getNatives(ErrorCode *error)
 {
     QMap<unsigned int, QString> nativeMap;
 
@@ -279,9 +621,9 @@ QMap<unsigned int, QString> Util::getNatives()
 
         natives.close();
     }
-    else
+    else if (error != nullptr)
     {
-        QMessageBox::critical(0, "Error", "Error: Failed to read natives. Only hashes will be available.");
+        *error = ERR_NATIVES_FAILED;
     }
 
     QFile customNatives(":/res/rage/custom-natives.txt");
@@ -302,9 +644,9 @@ QMap<unsigned int, QString> Util::getNatives()
 
         customNatives.close();
     }
-    else
+    else if (error != nullptr)
     {
-        QMessageBox::critical(0, "Error", "Error: Failed to read custom natives. Only hashes will be available.");
+        *error = ERR_NATIVES_FAILED;
     }
 
     return nativeMap;
@@ -321,3 +663,32 @@ QString Util::getNative(unsigned int key, QMap<unsigned int, QString> natives)
         return QString("UNK_0x%1").arg(key, 0, 16);
     }
 }
+
+void Util::parallelFor(int count, int threads, const std::function<void(int)> &task)
+{
+    std::atomic<int> next(0);
+
+    // items are handed out one at a time, so a slow one doesn't hold up a whole range
+    auto worker = [&]()
+    {
+        for (int i = next++; i < count; i = next++)
+        {
+            task(i);
+        }
+    };
+
+    threads = std::min(count, threads > 0 ? threads : QThread::idealThreadCount());
+    std::vector<std::thread> workers;
+
+    for (int i = 1; i < threads; i++)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+}
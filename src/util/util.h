@@ -4,23 +4,75 @@
 #include <QByteArray>
 #include <QMap>
 
+#include <functional>
+
+#include "crypto/lzxcomp.h"
+
+enum ErrorCode
+{
+    ERR_NONE,
+    ERR_OPEN_FAILED,
+    ERR_INVALID_SCRIPT,
+    ERR_NO_HEADER,
+    ERR_NO_KEY,
+    ERR_DECOMPRESS_FAILED,
+    ERR_COMPRESS_FAILED,
+    ERR_NATIVES_FAILED,
+    ERR_WRITE_FAILED,
+    ERR_INVALID_ARGUMENTS,
+    ERR_SELFTEST_FAILED,
+    ERR_STACK_UNBALANCED
+};
+
+enum AesBackend
+{
+    AES_PORTABLE, // vendored byte-oriented aes256
+    AES_TTABLE,   // 32-bit lookup tables, fastest without AES-NI
+    AES_NI
+};
+
 class Util
 {
 public:
-    static QByteArray getAESKey();
+    static QString errorToString(ErrorCode error);
+
+    static QByteArray getAESKey(); // from the KeyRing, empty if the key file can't be read
+
+    // defaults to the fastest backend the cpu supports
+    static AesBackend getAesBackend();
+    static bool setAesBackend(AesBackend backend); // false if unsupported
+    static bool isAesBackendSupported(AesBackend backend);
+    static int getAesThreadCount();
+    static void setAesThreadCount(int count); // large buffers are split over this many threads, 0 uses the core count
+    static QString aesBackendToString(AesBackend backend);
 
     static QByteArray decrypt(QByteArray in);
     static QByteArray encrypt(QByteArray in);
 
-    static QByteArray lzxDecompress(QByteArray in, int outSize);
-    static QByteArray lzxCompress(QByteArray in);
+    // decrypts size bytes from in to out, in may be read-only (e.g. a file mapping)
+    static bool decrypt(const char *in, char *out, int size);
+
+    // with a key other than the KeyRing's, which is expanded on every call
+    static bool decrypt(const char *in, char *out, int size, const QByteArray &key);
+    static bool encrypt(const char *in, char *out, int size, const QByteArray &key);
 
-    static QByteArray zlibDecompress(QByteArray in, int outSize);
-    static QByteArray zlibCompress(QByteArray in);
+    static QByteArray lzxDecompress(QByteArray in, int outSize, int *result = nullptr);
+    static QByteArray lzxCompress(QByteArray in, int level = LZX_LEVEL_DEFAULT); // LZX_LEVEL_STORE writes uncompressed blocks, empty on failure
+
+    // decompress straight into a caller-owned buffer, returns 0 on success
+    static int lzxDecompress(const char *in, int inSize, char *out, int outSize);
+    static int lzxDecompressReference(const char *in, int inSize, char *out, int outSize); // the decoder lzx.c replaced, for the bench
+    static int zlibDecompress(const char *in, int inSize, char *out, int outSize, const std::function<void(int, int)> &progress = nullptr); // progress(done, total) as output is written
+
+    static QByteArray zlibDecompress(QByteArray in, int outSize, int *result = nullptr);
+    static QByteArray zlibCompress(QByteArray in, int level = LZX_LEVEL_DEFAULT); // deflates chunks in parallel into one stream, 0 stores, empty on failure
     static std::string zlibErrorCodeToStr(int32_t errorcode);
 
+    // runs task(0) to task(count - 1) on up to threads threads, the caller's included, 0 uses the core count
+    static void parallelFor(int count, int threads, const std::function<void(int)> &task);
+
     static unsigned int hash(std::string str, bool lowercase = true);
-    static QMap<unsigned int, QString> getNatives(); // generates map of known native names
+    static QMap<unsigned int, QString> getNatives(ErrorCode *error = nullptr); // generates map of known native names
     static QString getNative(unsigned int key, QMap<unsigned int, QString> natives); // returns native name
 };
 
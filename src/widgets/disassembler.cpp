@@ -6,6 +6,7 @@
 #include <QTextStream>
 
 #include "../rage/compiler.h"
+#include "../rage/decompiler.h"
 #include "../rage/opcodes/enter.h"
 #include "../rage/opcodes/helper.h"
 #include "../util/util.h"
@@ -17,13 +18,30 @@ Disassembler::Disassembler(QString file, bool debug, QWidget *parent)
     , m_ui(new Ui::Disassembler)
     , m_script(file, debug)
     , m_file(file)
+    , m_pseudoCode(nullptr)
     , m_debug(debug)
 {
     m_ui->setupUi(this);
 
+    if (!m_script.isValid())
+    {
+        QApplication::restoreOverrideCursor();
+        QMessageBox::critical(this, "Error", Util::errorToString(m_script.getError()));
+        return;
+    }
+
     m_ui->funcTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
 
-    m_nativeMap = Util::getNatives();
+    ErrorCode nativeError = ErrorCode::ERR_NONE;
+
+    m_nativeMap = Util::getNatives(&nativeError);
+
+    if (nativeError != ErrorCode::ERR_NONE)
+    {
+        QMessageBox::warning(this, "Warning", Util::errorToString(nativeError));
+    }
+
+    m_disassembly.reset(new Disassembly(m_script.getView(), m_nativeMap));
 
     m_disasm = new OpcodeTable(0, 4, m_ui->tabWidget);
     m_ui->tabWidget->addTab(m_disasm, "Disassembly");
@@ -32,8 +50,7 @@ Disassembler::Disassembler(QString file, bool debug, QWidget *parent)
     createStringsTab();
     createNativeTab();
     createScriptDataTab();
-
-    m_disasm->setOpcodes(m_script.getOpcodes());
+    createPseudoCodeTab();
 
     connect(m_ui->actionExportDisassembly_2, SIGNAL(triggered()), this, SLOT(exportDisassembly()));
     connect(m_ui->actionExportRawData_2,     SIGNAL(triggered()), this, SLOT(exportRawData()));
@@ -59,42 +76,32 @@ Disassembler::~Disassembler()
 
 void Disassembler::exportDisassembly()
 {
-    QString filePath = QFileDialog::getSaveFileName(this, "Export disassembly", m_file.split("\\").last() + ".txt", "Text (*.txt)");
+    QString filter;
+    QString filePath = QFileDialog::getSaveFileName(this, "Export disassembly", m_file.split("\\").last() + ".txt",
+                                                    "Text (*.txt);;JSON lines (*.jsonl);;CSV (*.csv)", &filter);
 
     if (filePath.isEmpty())
     {
         return;
     }
 
+    ListingFormat format = ListingFormat::LISTING_TEXT;
+
+    if (filter.startsWith("JSON"))
+        format = ListingFormat::LISTING_JSONL;
+    else if (filter.startsWith("CSV"))
+        format = ListingFormat::LISTING_CSV;
+
     QFile file(filePath);
 
-    if (!file.open(QIODevice::WriteOnly))
+    // streamed from the script rather than the table, so it doesn't need the rows in memory twice,
+    // with the operands of the opcodes so edits made in the table are kept
+    if (!file.open(QIODevice::WriteOnly) || !m_disassembly->write(&file, format, &m_script.getOpcodes()))
     {
         QMessageBox::critical(this, "Error", "Error: unable to write to file. Make sure the file isn't open elsewhere.");
         return;
     }
 
-    QString str;
-
-    for (int row = 0; row < m_disasm->rowCount(); row++)
-    {
-        for (int col = 0; col < m_disasm->columnCount(); col++)
-        {
-            QTableWidgetItem *item = m_disasm->item(row, col);
-
-            if (item != nullptr)
-            {
-                str += m_disasm->item(row, col)->text().leftJustified(15);
-            }
-        }
-
-        str += "\n";
-    }
-
-    QTextStream stream(&file);
-
-    stream << str;
-
     file.close();
 
     QMessageBox::information(this, "Exported", "Successfully exported to " + filePath);
@@ -138,6 +145,13 @@ void Disassembler::open()
         QApplication::setOverrideCursor(Qt::WaitCursor);
 
         Disassembler *dsm = new Disassembler(file, m_debug);
+
+        if (!dsm->isValid())
+        {
+            delete dsm;
+            return;
+        }
+
         dsm->show();
 
         close();
@@ -145,66 +159,54 @@ void Disassembler::open()
 }
 
 void Disassembler::compilePS3()
-{    
-    Compiler compiler(m_script);
+{
+    compileResource(ScriptType::TYPE_PS3, "Convert to .csc", "Script (*.csc)");
+}
 
-    QString outDir = QFileDialog::getSaveFileName(this, "Convert to .csc", QString(), "Script (*.csc)");
+void Disassembler::compileX360()
+{
+    compileResource(ScriptType::TYPE_X360, "Convert to .xsc", "Script (*.xsc)");
+}
 
-    if (outDir.isEmpty())
-        return;
+void Disassembler::compileResource(ScriptType type, QString title, QString filter)
+{
+    Compiler compiler(m_script);
 
-    QByteArray script = Util::encrypt(Util::lzxCompress(compiler.compile()));
+    if (m_ui->actionFastCompile->isChecked())
+        compiler.setCompressionLevel(LZX_LEVEL_STORE);
 
-    QByteArray header;
-    QDataStream stream(&header, QIODevice::WriteOnly);
+    if (m_ui->actionSkipStackCheck->isChecked())
+        compiler.setStackCheck(false);
 
-    stream << 0x86435352; // csc header
-    stream << m_script.getResourceHeader().version;
-    stream << m_script.getResourceHeader().flags1;
-    stream << m_script.getResourceHeader().flags2;
+    QString outDir = QFileDialog::getSaveFileName(this, title, QString(), filter);
 
-    script.prepend(header);
+    if (outDir.isEmpty())
+        return;
 
-    QFile out(outDir);
+    ErrorCode error;
+    QByteArray script = compiler.compileResource(type, &error);
 
-    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    if (error == ErrorCode::ERR_STACK_UNBALANCED)
     {
-        QMessageBox::critical(this, "Error", "Error: Unable to write to output file.");
+        QStringList issues = compiler.getStackIssues();
+
+        QMessageBox::critical(this, "Error", Util::errorToString(error) + "\n\n" + issues.mid(0, 10).join("\n")
+                                             + (issues.size() > 10 ? QString("\n... %1 more").arg(issues.size() - 10) : QString())
+                                             + "\n\nCompile > Skip stack check writes it regardless.");
         return;
     }
 
-    out.write(script);
-    out.close();
-
-    QMessageBox::information(this, "Compiled script", QString("Succesfully compiled script to %1.").arg(outDir));
-}
-
-void Disassembler::compileX360()
-{    
-    Compiler compiler(m_script);
-
-    QString outDir = QFileDialog::getSaveFileName(this, "Convert to .xsc", QString(), "Script (*.xsc)");
-
-    if (outDir.isEmpty())
+    if (error != ErrorCode::ERR_NONE)
+    {
+        QMessageBox::critical(this, "Error", Util::errorToString(error));
         return;
-
-    QByteArray script = Util::encrypt(Util::lzxCompress(compiler.compile()));
-
-    QByteArray header;
-    QDataStream stream(&header, QIODevice::WriteOnly);
-
-    stream << 0x85435352; // xsc header
-    stream << m_script.getResourceHeader().version;
-    stream << m_script.getResourceHeader().flags1;
-    stream << m_script.getResourceHeader().flags2;
-
-    script.prepend(header);
+    }
 
     QFile out(outDir);
 
     if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
     {
-        QMessageBox::critical(this, "Error", "Error: Unable to write to output file.");
+        QMessageBox::critical(this, "Error", Util::errorToString(ErrorCode::ERR_WRITE_FAILED));
         return;
     }
 
@@ -238,6 +240,42 @@ void Disassembler::createScriptDataTab()
     scriptData->append(getScriptHeaderData());
 }
 
+void Disassembler::createPseudoCodeTab()
+{
+    m_pseudoCode = new QTextEdit(this);
+
+    m_pseudoCode->setFont(QFont("Roboto Mono", 10));
+    m_pseudoCode->setReadOnly(true);
+    m_pseudoCode->setLineWrapMode(QTextEdit::NoWrap);
+
+    m_ui->tabWidget->addTab(m_pseudoCode, "Pseudo-C");
+
+    // decompiling a big script takes a while, so only once the tab is opened
+    connect(m_ui->tabWidget, &QTabWidget::currentChanged, this, [this](int index)
+    {
+        if (m_ui->tabWidget->widget(index) == m_pseudoCode && m_pseudoCode->document()->isEmpty())
+            fillPseudoCode();
+    });
+}
+
+void Disassembler::fillPseudoCode()
+{
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    Decompiler decompiler(m_script.getView(), m_nativeMap);
+    decompiler.run();
+
+    QString text;
+    QTextStream stream(&text);
+
+    decompiler.write(stream);
+    stream.flush();
+
+    m_pseudoCode->setPlainText(text);
+
+    QApplication::restoreOverrideCursor();
+}
+
 void Disassembler::createNativeTab()
 {
     QTableWidget *natives = new QTableWidget(this);
@@ -301,15 +339,17 @@ QString Disassembler::getScriptHeaderData()
 
 QTableWidget *Disassembler::createStringsTab()
 {
-    QTableWidget *stringTable = new QTableWidget(m_script.getStrings().size(), 2, this);
+    const std::vector<std::shared_ptr<IOpcode>> &strings = m_script.getStrings();
+
+    QTableWidget *stringTable = new QTableWidget(strings.size(), 2, this);
 
     stringTable->setHorizontalHeaderLabels({"Location", "String"});
     stringTable->verticalHeader()->setVisible(false);
     stringTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeMode::Stretch);
 
-    for (unsigned int i = 0; i < m_script.getStrings().size(); i++)
+    for (unsigned int i = 0; i < strings.size(); i++)
     {
-        auto op = m_script.getStrings()[i];
+        auto op = strings[i];
 
         stringTable->setItem(i, 0, new QTableWidgetItem(op->getFormattedLocation()));
         stringTable->setItem(i, 1, new QTableWidgetItem(op->getFormattedData()));
@@ -322,30 +362,53 @@ QTableWidget *Disassembler::createStringsTab()
 
 void Disassembler::fillDisassembly()
 {
-    int invalidCalls = 0;
+    const QVector<std::shared_ptr<IOpcode>> &opcodes = m_script.getOpcodes();
+    QVector<std::shared_ptr<IOpcode>> rowOps; // opcode shown on each row, null for spacers and labels
+
+    const std::vector<Label> &labels = m_script.getInstructions().getLabelIndex();
+    auto label = labels.begin();
+
     bool firstFunc = true;
 
-    for (auto op : m_script.getOpcodes())
+    for (int i = 0; i < opcodes.size(); i++)
     {
+        auto op = opcodes[i];
         int index = m_disasm->rowCount();
 
-        if (op->getOp() == EOpcodes::_SPACER)
+        if (op->getOp() == EOpcodes::OP_ENTER)
         {
             // don't put spacer in front of first function
             if (firstFunc)
             {
                 firstFunc = false;
-                continue;
             }
+            else
+            {
+                m_disasm->insertRow(index);
+                rowOps.append(nullptr);
+
+                index++;
+            }
+        }
+
+        if (label != labels.end() && label->index == i)
+        {
+            m_disasm->setRowCount(index + 1);
 
-            m_disasm->insertRow(index);
-            continue;
+            QTableWidgetItem *jump = new QTableWidgetItem(QString(":sub_%1").arg(label->number));
+            jump->setForeground(QColor(255, 0, 0));
+
+            m_disasm->setItem(index, 1, jump);
+            rowOps.append(nullptr);
+
+            index++;
+            ++label;
         }
 
         QTableWidgetItem *address = new QTableWidgetItem(op->getFormattedLocation());
         QTableWidgetItem *bytes   = new QTableWidgetItem(op->getFormattedBytes());
         QTableWidgetItem *opcode  = new QTableWidgetItem(op->getName());
-        QTableWidgetItem *data    = new QTableWidgetItem(op->getFormattedData());
+        QTableWidgetItem *data    = new QTableWidgetItem(m_disassembly->getData(op));
 
         QColor funcCol(0, 12, 140);
         QFont funcFont("Roboto Mono Bold", 10);
@@ -354,25 +417,14 @@ void Disassembler::fillDisassembly()
         bytes->setForeground(QColor(120, 120, 120));
 
         m_disasm->setRowCount(index + 1);
+        rowOps.append(op);
 
         if (op->getOp() == EOpcodes::OP_NATIVE)
         {
-            int native   = ((op->getData()[0] << 2) & 0x300) | op->getData()[1];
-            int argCount = (op->getData()[0] & 0x3e) >> 1;
-            bool hasRets = (op->getData()[0] & 1) == 1 ? true : false;
-
-            data->setText(QString("%1 (%2 args, ret %3)").arg(Util::getNative(m_script.getNatives()[native], m_nativeMap))
-                                                         .arg(argCount)
-                                                         .arg(hasRets));
-
             data->setFont(funcFont);
         }
         else if (op->getOp() == EOpcodes::OP_ENTER)
         {
-            std::shared_ptr<Op_Enter> enter = std::dynamic_pointer_cast<Op_Enter>(op);
-
-            data->setText(enter->getFuncName());
-
             address->setFont(funcFont);
             bytes->setFont(funcFont);
             opcode->setFont(funcFont);
@@ -393,48 +445,13 @@ void Disassembler::fillDisassembly()
         }
         else if (op->getOp() >= EOpcodes::OP_CALL2 && op->getOp() <= EOpcodes::OP_CALL2HF)
         {
-            QDataStream str(op->getData());
-
-            unsigned short funcLoc;
-            str >> funcLoc;
-
-            int callOffset = (funcLoc | (op->getOp() - 0x52) << 0x10);
-
-            callOffset += m_script.getPageOffsets()[m_script.getPageByLocation(callOffset)];
-
-            if (m_script.getFuncs().count(callOffset) == 0)
-            {
-                data->setText(QString("??? (%1)").arg(callOffset, 5, 16));
-                invalidCalls++;
-            }
-            else
-            {
-                data->setText(m_script.getFuncs().at(callOffset)->getFuncName());
-
-                m_script.getFuncs().at(callOffset)->addReference(op);
-            }
-
             data->setFont(funcFont);
             data->setForeground(funcCol);
         }
         else if (op->getOp() >= EOpcodes::OP_JMP && op->getOp() <= EOpcodes::OP_JMPGT)
         {
-            int jumpPos = op->getData()[1] + op->getLocation() + 3;
-
-            data->setText("@" + m_script.getJumps().at(jumpPos)->getSub());
             data->setForeground(QColor(255, 0, 0));
         }
-        else if (op->getOp() == EOpcodes::_SUB)
-        {
-            m_disasm->setRowCount(index + 1);
-
-            QTableWidgetItem *jump = new QTableWidgetItem(QString(":" + std::dynamic_pointer_cast<Op_HSub>(op)->getSub()));
-            jump->setForeground(QColor(255, 0, 0));
-
-            m_disasm->setItem(index, 1, jump);
-
-            continue;
-        }
 
         m_disasm->setItem(index, 0, address);
         m_disasm->setItem(index, 1, bytes);
@@ -442,9 +459,11 @@ void Disassembler::fillDisassembly()
         m_disasm->setItem(index, 3, data);
     }
 
-    if (invalidCalls > 0)
+    m_disasm->setOpcodes(rowOps);
+
+    if (m_disassembly->getInvalidCalls() > 0)
     {
-        QMessageBox::warning(this, "Warning", QString("Warning: %1 invalid calls found.").arg(invalidCalls));
+        QMessageBox::warning(this, "Warning", QString("Warning: %1 invalid calls found.").arg(m_disassembly->getInvalidCalls()));
     }
 
     m_ui->funcTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeMode::ResizeToContents);
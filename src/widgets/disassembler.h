@@ -7,6 +7,7 @@
 #include <memory>
 
 #include "opcodetable.h"
+#include "../rage/disassembly.h"
 #include "../rage/iopcode.h"
 #include "../rage/script.h"
 
@@ -22,6 +23,8 @@ public:
     explicit Disassembler(QString file, bool debug, QWidget *parent = nullptr);
     ~Disassembler();
 
+    bool isValid() { return m_script.isValid(); }
+
 public slots:
     void exportDisassembly();
     void exportRawData();
@@ -38,18 +41,23 @@ private:
     QTableWidget *createStringsTab();
 
     void createNativeTab();
+    void createPseudoCodeTab(); // empty until first shown
+    void fillPseudoCode();
 
     QString getResourceHeaderData();
     QString getScriptHeaderData();
 
     void compile(ScriptType type);
+    void compileResource(ScriptType type, QString title, QString filter);
 
     QMap<unsigned int, QString> m_nativeMap;
 
     Ui::Disassembler *m_ui;
     Script m_script;
+    std::unique_ptr<Disassembly> m_disassembly;
     QString m_file;
     OpcodeTable *m_disasm;
+    QTextEdit *m_pseudoCode;
     bool m_debug;
 };
 
@@ -3,9 +3,7 @@
 
 #include <QMessageBox>
 
-#include "../rage/opcodefactory.h"
-
-#include <QDebug>
+#include "../rage/opcodedesc.h"
 
 EditDialog::EditDialog(std::shared_ptr<IOpcode> op, QWidget *parent) :
     QDialog(parent),
@@ -20,13 +18,9 @@ EditDialog::EditDialog(std::shared_ptr<IOpcode> op, QWidget *parent) :
     m_ui->opcode->setFont(QFont("Roboto Mono", 10));
     m_ui->data->setFont(QFont("Roboto Mono", 10));
 
-    for (int i = 0; i <= 155; i++)
+    for (int i = 0; i < OPCODE_COUNT; i++)
     {
-        QString opName = OpcodeFactory::Create((EOpcodes)i)->getName();
-
-        m_ui->opcode->addItem(opName);
-
-        qDebug() << "added" << opName << "@" << i << "op:" << op->getOp();
+        m_ui->opcode->addItem(opcodeDesc(i).name);
     }
 
     m_ui->opcode->setCurrentIndex(op->getOp());
@@ -8,6 +8,7 @@
 #include "disassembler.h"
 
 #include "../rage/opcodefactory.h"
+#include "../util/keyring.h"
 #include "../util/util.h"
 
 LaunchScreen::LaunchScreen(QWidget *parent) :
@@ -16,8 +17,9 @@ LaunchScreen::LaunchScreen(QWidget *parent) :
 {
     m_ui->setupUi(this);
 
-    if (Util::getAESKey() == QByteArray())
+    if (!KeyRing::get().isValid())
     {
+        QMessageBox::critical(this, "Error", Util::errorToString(ErrorCode::ERR_NO_KEY));
         m_ui->btnOpenFile->setEnabled(false);
     }
 
@@ -42,6 +44,13 @@ void LaunchScreen::openFilePressed()
         QApplication::setOverrideCursor(Qt::WaitCursor);
 
         Disassembler *dsm = new Disassembler(file, m_ui->cbDebug->isChecked());
+
+        if (!dsm->isValid())
+        {
+            delete dsm;
+            return;
+        }
+
         dsm->show();
 
         close();
@@ -50,23 +50,26 @@ void OpcodeTable::displayContextMenu(const QPoint &point)
     if (selected == nullptr)
         return;
 
-    QMenu *menu = new QMenu(this);
+    auto op = m_ops.value(selected->row());
 
-    auto op = m_ops.at(selected->row() + 1);
+    if (op == nullptr)
+        return;
+
+    QMenu menu(this);
 
     int dialogResult = 0;
 
     if (op->getDeleted())
     {
-        menu->addAction("Undelete", [this, selected, op]{ op->setDeleted(false); setRowColor(selected->row(), QColor(255, 255, 255)); });
+        menu.addAction("Undelete", [this, selected, op]{ op->setDeleted(false); setRowColor(selected->row(), QColor(255, 255, 255)); });
     }
     else
     {
-        menu->addAction("Edit", [this, op, &dialogResult]{ dialogResult = openEditDialog(op); });
-        menu->addAction("Delete", [this, selected, op]{ op->setDeleted(true); setRowColor(selected->row(), QColor(255, 0, 0)); });
+        menu.addAction("Edit", [this, op, &dialogResult]{ dialogResult = openEditDialog(op); });
+        menu.addAction("Delete", [this, selected, op]{ op->setDeleted(true); setRowColor(selected->row(), QColor(255, 0, 0)); });
     }
 
-    menu->exec(horizontalHeader()->viewport()->mapToGlobal(QPoint(point.x(), point.y() + verticalHeader()->sectionSize(0))));
+    menu.exec(horizontalHeader()->viewport()->mapToGlobal(QPoint(point.x(), point.y() + verticalHeader()->sectionSize(0))));
 
     if (dialogResult == QDialog::Accepted)
     {
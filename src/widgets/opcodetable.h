@@ -11,7 +11,7 @@ class OpcodeTable : public QTableWidget
 public:
     OpcodeTable(int rows, int columns, QWidget *parent);
 
-    void setOpcodes(const QVector<std::shared_ptr<IOpcode>> &ops) { m_ops = ops; }
+    void setOpcodes(const QVector<std::shared_ptr<IOpcode>> &ops) { m_ops = ops; } // one per row, null where a row has no opcode
     void setRowColor(int row, QColor col);
 
 public slots:
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# Generates the constexpr opcode descriptor table from res/rage/opcodes.json.
+# usage: gen_opcodes.py opcodes.json opcodes_gen.h
+
+import json
+import sys
+
+OPERANDS = {
+    "none":   "OPERAND_NONE",
+    "imm8":   "OPERAND_IMM8",
+    "imm16":  "OPERAND_IMM16",
+    "imm24":  "OPERAND_IMM24",
+    "imm32":  "OPERAND_IMM32",
+    "float":  "OPERAND_FLOAT",
+    "bytes":  "OPERAND_BYTES",
+    "native": "OPERAND_NATIVE",
+    "enter":  "OPERAND_ENTER",
+    "ret":    "OPERAND_RET",
+    "call":   "OPERAND_CALL",
+    "jump":   "OPERAND_JUMP",
+    "switch": "OPERAND_SWITCH",
+    "string": "OPERAND_STRING",
+}
+
+FLAGS = {
+    "branch":     "OPF_BRANCH",
+    "call":       "OPF_CALL",
+    "push":       "OPF_PUSH",
+    "terminator": "OPF_TERMINATOR",
+    "static":     "OPF_STATIC",
+    "global":     "OPF_GLOBAL",
+    "return":     "OPF_RETURN",
+}
+
+VARIABLE = {"enter", "switch", "string"}
+
+
+def fail(index, message):
+    sys.exit("opcodes.json: opcode %d: %s" % (index, message))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_opcodes.py opcodes.json opcodes_gen.h")
+
+    with open(sys.argv[1], encoding="utf-8") as f:
+        opcodes = json.load(f)["opcodes"]
+
+    names = set()
+    rows = []
+
+    for i, op in enumerate(opcodes):
+        name, size, operand, flags = op["name"], op["size"], op["operand"], op["flags"]
+        pops, pushes = op["pops"], op["pushes"]
+
+        if name in names:
+            fail(i, "duplicate name '%s'" % name)
+        if operand not in OPERANDS:
+            fail(i, "unknown operand '%s'" % operand)
+        if (size == 0) != (operand in VARIABLE):
+            fail(i, "size %d does not match operand '%s'" % (size, operand))
+        if (size == 1) != (operand == "none"):
+            fail(i, "size %d does not match operand '%s'" % (size, operand))
+        for flag in flags:
+            if flag not in FLAGS:
+                fail(i, "unknown flag '%s'" % flag)
+        if pops < -1 or pushes < -1 or (pops == -1) != (pushes == -1):
+            fail(i, "stack effect %d, %d is invalid" % (pops, pushes))
+        if "return" in flags and pushes > 0:
+            fail(i, "returns can't push")
+
+        names.add(name)
+
+        bits = " | ".join(FLAGS[flag] for flag in flags) or "0"
+        rows.append('    { %d, %s, "%s", %s, %d, %d }' % (size, OPERANDS[operand], name, bits, pops, pushes))
+
+    with open(sys.argv[2], "w", encoding="utf-8", newline="\n") as f:
+        f.write("// Generated from res/rage/opcodes.json by tools/gen_opcodes.py, do not edit\n\n")
+        f.write("constexpr OpcodeDesc s_opcodeDescs[] =\n{\n")
+        f.write(",\n".join(rows))
+        f.write("\n};\n")
+
+
+if __name__ == "__main__":
+    main()